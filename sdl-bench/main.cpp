@@ -0,0 +1,744 @@
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+#include "Animation.h"
+#include "CommandBuffer.h"
+#include "FrameCapture.h"
+#include "ImageCodec.h"
+#include "JobSystem.h"
+#include "Log.h"
+#include "RenderStats.h"
+#include "RendererCaps.h"
+#include "SDLHandles.h"
+#include "SpatialGrid.h"
+#include "SpriteBatch.h"
+#include "SpriteStore.h"
+#include "TextureCache.h"
+#include "TextureResidency.h"
+#include "TileRasterizer.h"
+
+const auto SCREEN_WIDTH = 640;
+const auto SCREEN_HEIGHT = 480;
+
+const auto WARMUP_FRAMES = 30;
+const auto DEFAULT_FRAMES = 600;
+
+/** Struct: Scene
+ *
+ *  Description:
+ *  One scripted benchmark case: how many sprites to draw each frame, how many distinct textures they
+ *  are spread across, and how big each sprite is. Sprite size is what controls overdraw: the
+ *  reported overdraw is the total sprite area divided by the screen area.
+ *
+ *  Scenes with a world scale above 1 spread their sprites over a world that many screens wide and
+ *  tall, and pan the camera across it; each frame only the sprites a SpatialGrid finds inside the
+ *  camera are drawn.
+ *
+ *  Moving scenes keep their sprites in a SpriteStore instead, step them once per frame and bounce
+ *  them off the edges of the world, so the measurement includes the update and sort as well.
+ *  Animated scenes also play a looping clip on every sprite, cut from quarters of its texture.
+ *
+ *  Lazy scenes load their textures from QOI files through a TextureResidency whose budget only
+ *  fits a quarter of them, so as the camera pans, textures that went out of view are evicted and
+ *  ones coming into view are reloaded; the cost of that churn is part of the frame time.
+ *
+ */
+
+struct Scene {
+	const char *name;
+	int sprites;
+	int textures;
+	int spriteSize;
+	int worldScale;
+	bool moving;
+	bool animated;
+	bool lazy;
+};
+
+const Scene SCENES[] = {
+	{ "sprites-1k-tex1",            1000,  1,  32, 1, false, false, false },
+	{ "sprites-10k-tex1",          10000,  1,  16, 1, false, false, false },
+	{ "sprites-10k-tex16",         10000, 16,  16, 1, false, false, false },
+	{ "sprites-50k-tex4",          50000,  4,   8, 1, false, false, false },
+	{ "overdraw-8x-tex1",             32,  1, 310, 1, false, false, false },
+	{ "overdraw-8x-tex8",             32,  8, 310, 1, false, false, false },
+	{ "interleaved-1k-tex64",       1000, 64,  32, 1, false, false, false },
+	{ "culled-50k-world8x",        50000,  4,  16, 8, false, false, false },
+	{ "moving-50k-tex4",           50000,  4,   8, 1, true, false, false },
+	{ "moving-culled-50k-world8x", 50000,  4,  16, 8, true, false, false },
+	{ "animated-50k-tex4",         50000,  4,  16, 1, true, true, false },
+	{ "lazy-culled-50k-tex256",    50000, 256, 32, 8, false, false, true }
+};
+
+// Simulation step of moving scenes, and their sprites' top speed in pixels per second
+const auto SIMULATION_STEP = 1.0f / 60.0f;
+const auto MAX_SPRITE_SPEED = 120;
+
+// Sprites per job when moving scenes update in parallel, and animations per job in animated ones
+const auto SPRITE_JOB_GRAIN = std::size_t { 4096 };
+const auto ANIMATION_JOB_GRAIN = std::size_t { 8192 };
+
+// Playback rate of animated scenes' clips
+const auto ANIMATION_FPS = 12.0f;
+
+// Cell size of the grid used by culled scenes
+const auto CULLING_CELL_SIZE = 64;
+
+// Lazy scenes' residency budget, as a fraction of all their textures together
+const auto LAZY_BUDGET_DIVISOR = std::size_t { 4 };
+
+struct SceneResult {
+	double fps;
+	double p50;
+	double p99;
+	double drawCallsPerFrame;
+	double textureSwitchesPerFrame;
+	double spritesPerFrame;
+	double uploadsPerFrame;
+	double verticesPerFrame;
+	double uploadBytesPerFrame;
+
+	// Every counter's highest value over the measured frames, for setting the scene's budget from
+	FrameStats worst;
+	std::size_t framesOverBudget;
+};
+
+/** Function: createSceneSurface
+ *
+ *  Description:
+ *  Benchmarks shouldn't depend on which assets happen to be on disk, so every image is generated:
+ *  a solid color per index with a one pixel border. Lazy scenes write these out as QOI files for
+ *  TextureResidency to load on demand; the others upload them with createSceneTexture().
+ *
+ */
+
+SurfacePtr createSceneSurface(int index, int size) {
+	SurfacePtr surface(SDL_CreateRGBSurfaceWithFormat(0, size, size, 32, SDL_PIXELFORMAT_ARGB8888));
+
+	if (!surface) {
+		LogSDLError(std::cerr, "CreateRGBSurfaceWithFormat");
+		return nullptr;
+	}
+
+	const auto hue = static_cast<Uint32>(index * 2654435761u);
+
+	SDL_FillRect(surface.get(), NULL, 0xFF000000);
+
+	const SDL_Rect inner { 1, 1, size - 2, size - 2 };
+	SDL_FillRect(surface.get(), &inner, 0xFF000000 | (hue & 0x00FFFFFF) | 0x00404040);
+
+	return surface;
+}
+
+/** Function: createSceneTexture
+ *
+ *  Description:
+ *  The generated image for index, uploaded through SDL_CreateTextureFromSurface exactly like a
+ *  loaded BMP would be.
+ *
+ */
+
+TexturePtr createSceneTexture(SDL_Renderer *renderer, int index, int size) {
+	auto surface = createSceneSurface(index, size);
+
+	if (!surface) {
+		return nullptr;
+	}
+
+	TexturePtr texture(SDL_CreateTextureFromSurface(renderer, surface.get()));
+
+	if (!texture) {
+		LogSDLError(std::cerr, "CreateTextureFromSurface");
+	}
+
+	return texture;
+}
+
+double percentile(std::vector<double> samples, double fraction) {
+	if (samples.empty()) {
+		return 0.0;
+	}
+
+	const auto index = static_cast<std::size_t>(fraction * (samples.size() - 1) + 0.5);
+
+	std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+	return samples[index];
+}
+
+bool runScene(SDL_Renderer *renderer, JobSystem& jobs, bool cpuRaster, const Scene& scene, int frames, SceneResult& result) {
+	/** The scene's textures go through the same TextureCache the game uses, so the benchmark
+	 *  exercises the same handles and bookkeeping. Each texture is generated at the sprite size
+	 *  so sampling costs scale with overdraw the same way real sprites would.
+	 */
+
+	TextureCache cache(renderer, std::size_t { 512 } * 1024 * 1024);
+	std::vector<TextureHandle> textures;
+
+	/** Lazy scenes write their textures out as QOI files instead, in the temporary directory, and
+	 *  only declare them; they're loaded (synchronously, so the cost lands in the frame that needs
+	 *  them) the first time a sprite using them comes into view.
+	 */
+
+	const auto textureBytes = static_cast<std::size_t>(scene.spriteSize) * scene.spriteSize * 4;
+	TextureResidency residency(cache, nullptr, textureBytes * scene.textures / LAZY_BUDGET_DIVISOR);
+	std::vector<LazyTextureHandle> lazyTextures;
+	std::vector<std::string> lazyFiles;
+
+	// Written files go, however the scene ends
+	struct FileCleanup {
+		std::vector<std::string>& files;
+
+		~FileCleanup() {
+			for (const auto& file : files) {
+				std::remove(file.c_str());
+			}
+		}
+	} cleanup { lazyFiles };
+
+	for (auto i = 0; scene.lazy && (i < scene.textures); ++i) {
+		const auto *temporary = SDL_getenv("TEMP") ? SDL_getenv("TEMP") : (SDL_getenv("TMPDIR") ? SDL_getenv("TMPDIR") : ".");
+		const auto path = std::string(temporary) + "/sdl-bench-" + scene.name + "-" + std::to_string(i) + ".qoi";
+
+		auto surface = createSceneSurface(i, scene.spriteSize);
+
+		if (!surface || !writeQOI(path, surface.get())) {
+			LogSDLError(std::cerr, "writeQOI");
+			return false;
+		}
+
+		lazyFiles.push_back(path);
+		lazyTextures.push_back(residency.declare(path));
+	}
+
+	for (auto i = 0; !scene.lazy && (i < scene.textures); ++i) {
+		auto texture = createSceneTexture(renderer, i, scene.spriteSize);
+
+		if (!texture) {
+			return false;
+		}
+
+		textures.push_back(cache.insert(std::string(scene.name) + "/" + std::to_string(i), std::move(texture)));
+	}
+
+	// Deterministic layout so runs are comparable; textures are assigned round robin
+	const auto worldWidth = SCREEN_WIDTH * scene.worldScale;
+	const auto worldHeight = SCREEN_HEIGHT * scene.worldScale;
+
+	std::vector<SDL_Point> positions(scene.sprites);
+	Uint32 seed = 12345;
+
+	for (auto& position : positions) {
+		seed = seed * 1664525u + 1013904223u;
+		position.x = static_cast<int>((seed >> 8) % (worldWidth - scene.spriteSize / 2 + 1));
+
+		seed = seed * 1664525u + 1013904223u;
+		position.y = static_cast<int>((seed >> 8) % (worldHeight - scene.spriteSize / 2 + 1));
+	}
+
+	// Lazy scenes give each region of the world its own texture, so a view only needs the few regions it covers
+	std::vector<int> lazyTextureOf(scene.lazy ? positions.size() : 0);
+	const auto regionsAcross = static_cast<int>(std::sqrt(static_cast<double>(scene.textures)));
+
+	for (std::size_t i = 0; i < lazyTextureOf.size(); ++i) {
+		const auto column = positions[i].x * regionsAcross / worldWidth;
+		const auto row = positions[i].y * regionsAcross / worldHeight;
+
+		lazyTextureOf[i] = std::min(row * regionsAcross + column, scene.textures - 1);
+	}
+
+	const auto culled = (scene.worldScale > 1);
+	SpatialGrid grid(CULLING_CELL_SIZE);
+	std::vector<SpatialId> visible;
+
+	SpriteStore store;
+	const SDL_Rect world { 0, 0, worldWidth, worldHeight };
+
+	AnimationLibrary animations(1.0 / SIMULATION_STEP);
+	AnimationPlayer animationPlayer(animations);
+
+	if (scene.moving) {
+		for (std::size_t i = 0; i < positions.size(); ++i) {
+			const auto& texture = *textures[i % scene.textures];
+			const AtlasRegion region { texture.texture.get(), SDL_Rect { 0, 0, texture.width, texture.height } };
+
+			const auto id = store.create(region, static_cast<float>(positions[i].x), static_cast<float>(positions[i].y));
+
+			seed = seed * 1664525u + 1013904223u;
+			const auto speedX = static_cast<int>((seed >> 8) % (2 * MAX_SPRITE_SPEED + 1)) - MAX_SPRITE_SPEED;
+
+			seed = seed * 1664525u + 1013904223u;
+			const auto speedY = static_cast<int>((seed >> 8) % (2 * MAX_SPRITE_SPEED + 1)) - MAX_SPRITE_SPEED;
+
+			store.setVelocity(id, static_cast<float>(speedX), static_cast<float>(speedY));
+
+			if (scene.animated) {
+				const auto clip = static_cast<ClipId>(i % scene.textures);
+
+				if (clip == animations.clipCount()) {
+					animations.addClip(std::to_string(clip), AnimationLibrary::sliceSheet(region, texture.width / 2, texture.height / 2), ANIMATION_FPS);
+				}
+
+				// Sprites start at different points of the clip, so their frames don't all change on the same step
+				animationPlayer.play(id, clip, static_cast<Uint32>(i));
+			}
+		}
+
+		animationPlayer.prepare(store);
+
+		if (culled) {
+			store.syncGrid(grid);
+		}
+	} else if (culled) {
+		for (SpatialId i = 0; i < positions.size(); ++i) {
+			grid.insert(i, SDL_Rect { positions[i].x, positions[i].y, scene.spriteSize, scene.spriteSize });
+		}
+	}
+
+	SpriteBatch spriteBatch(renderer);
+
+	// Its copies of the textures are the scene's own, so it goes with the scene
+	StreamingTexturePool streamingPool(renderer, 0);
+	std::unique_ptr<TileRasterizer> rasterizer;
+	auto rasterizedUploads = residency.stats().uploads;
+
+	if (cpuRaster) {
+		rasterizer.reset(new TileRasterizer(streamingPool, &jobs, SCREEN_WIDTH, SCREEN_HEIGHT));
+	}
+
+	std::vector<double> frameTimes;
+	frameTimes.reserve(frames);
+
+	const auto frequency = static_cast<double>(SDL_GetPerformanceFrequency());
+	double drawCalls = 0.0;
+	double textureSwitches = 0.0;
+	double spritesDrawn = 0.0;
+	double verticesSubmitted = 0.0;
+	double bytesUploaded = 0.0;
+	auto uploadsBefore = residency.stats().uploads;
+	auto& renderStats = RenderStats::instance();
+
+	for (auto frame = -WARMUP_FRAMES; frame < frames; ++frame) {
+		const auto start = SDL_GetPerformanceCounter();
+
+		SDL_RenderClear(renderer);
+		spriteBatch.begin();
+
+		// A small per-frame shift keeps the renderer from seeing identical frames
+		const auto shift = frame & 7;
+
+		// The camera sweeps diagonally across the world, a few pixels per frame
+		const auto pan = (frame + WARMUP_FRAMES) * 4;
+		const SDL_Rect camera = culled
+			? SDL_Rect { pan % (worldWidth - SCREEN_WIDTH), pan % (worldHeight - SCREEN_HEIGHT), SCREEN_WIDTH, SCREEN_HEIGHT }
+			: SDL_Rect { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+
+		if (scene.moving) {
+			jobs.parallelFor(store.size(), SPRITE_JOB_GRAIN, [&](std::size_t first, std::size_t last) {
+				store.beginStep(first, last);
+				store.integrate(SIMULATION_STEP, first, last);
+				store.bounce(world, first, last);
+			});
+
+			jobs.parallelFor(animationPlayer.size(), ANIMATION_JOB_GRAIN, [&](std::size_t first, std::size_t last) {
+				animationPlayer.step(store, first, last);
+			});
+
+			if (culled) {
+				store.syncGrid(grid);
+
+				visible.clear();
+				grid.query(camera, visible);
+
+				store.submit(spriteBatch, camera, 1.0f, visible);
+			} else {
+				store.submit(spriteBatch, camera, 1.0f);
+			}
+		} else if (culled) {
+			visible.clear();
+			grid.query(camera, visible);
+
+			for (const auto i : visible) {
+				const auto *texture = scene.lazy ? residency.use(*lazyTextures[lazyTextureOf[i]]) : textures[i % scene.textures].get();
+
+				if (texture) {
+					spriteBatch.draw(*texture, positions[i].x - camera.x, positions[i].y - camera.y);
+				}
+			}
+		} else {
+			for (auto i = 0; i < scene.sprites; ++i) {
+				const auto& texture = *textures[i % scene.textures];
+				spriteBatch.draw(texture, positions[i].x + shift, positions[i].y);
+			}
+		}
+
+		if (rasterizer) {
+			// A new upload may have taken the place of a texture that was evicted
+			if (residency.stats().uploads != rasterizedUploads) {
+				rasterizer->forgetTextures();
+				rasterizedUploads = residency.stats().uploads;
+			}
+
+			spriteBatch.flush(*rasterizer);
+			rasterizer->flush();
+		} else {
+			spriteBatch.flush();
+		}
+
+		SDL_RenderPresent(renderer);
+		renderStats.endFrame();
+
+		residency.endFrame();
+
+		if (frame >= 0) {
+			frameTimes.push_back((SDL_GetPerformanceCounter() - start) * 1000.0 / frequency);
+
+			drawCalls += spriteBatch.stats().drawCalls;
+			textureSwitches += spriteBatch.stats().textureSwitches;
+			spritesDrawn += spriteBatch.stats().sprites;
+
+			const auto frameStats = renderStats.latest();
+			verticesSubmitted += frameStats.vertices;
+			bytesUploaded += frameStats.uploadBytes;
+		} else {
+			// Loading everything the first view needs belongs to the warmup, not the measurement
+			uploadsBefore = residency.stats().uploads;
+			renderStats.reset();
+		}
+	}
+
+	double total = 0.0;
+
+	for (auto time : frameTimes) {
+		total += time;
+	}
+
+	result.fps = (total > 0.0) ? frames * 1000.0 / total : 0.0;
+	result.p50 = percentile(frameTimes, 0.50);
+	result.p99 = percentile(frameTimes, 0.99);
+	result.drawCallsPerFrame = drawCalls / frames;
+	result.textureSwitchesPerFrame = textureSwitches / frames;
+	result.spritesPerFrame = spritesDrawn / frames;
+	result.uploadsPerFrame = static_cast<double>(residency.stats().uploads - uploadsBefore) / frames;
+	result.verticesPerFrame = verticesSubmitted / frames;
+	result.uploadBytesPerFrame = bytesUploaded / frames;
+	result.worst = renderStats.worst();
+	result.framesOverBudget = renderStats.framesOverBudget();
+
+	return true;
+}
+
+struct ReplayResult {
+	double fps;
+	double p50;
+	double p99;
+	double capturedP50;
+	double capturedP99;
+	std::size_t slowestFrame;
+	double slowestMilliseconds;
+	std::size_t capturedSlowestFrame;
+	double capturedSlowestMilliseconds;
+};
+
+/** Function: replayCapture
+ *
+ *  Description:
+ *  Replays a capture written by sdl-test --capture, frame by frame, through the same CommandBuffer
+ *  the game records into, and times executing each frame's buffer, present included. That's what
+ *  the capture timed as well, so the two sets of numbers compare directly, and the frame that was
+ *  slowest when captured can be checked for being slow here too. The first frames are played once
+ *  beforehand as warmup.
+ *
+ */
+
+bool replayCapture(SDL_Renderer *renderer, TileRasterizer *rasterizer, const CaptureReplay& capture, ReplayResult& result) {
+	if (capture.frameCount() == 0) {
+		std::cerr << "CaptureReplay error: the capture has no frames\n";
+		return false;
+	}
+
+	std::vector<TexturePtr> placeholders;
+
+	if (!capture.createTextures(renderer, placeholders)) {
+		return false;
+	}
+
+	CommandBuffer commands;
+
+	std::vector<double> frameTimes;
+	std::vector<double> capturedTimes;
+	frameTimes.reserve(capture.frameCount());
+	capturedTimes.reserve(capture.frameCount());
+
+	const auto frequency = static_cast<double>(SDL_GetPerformanceFrequency());
+	const auto warmup = std::min(static_cast<std::size_t>(WARMUP_FRAMES), capture.frameCount());
+
+	for (std::size_t frame = 0; frame < warmup + capture.frameCount(); ++frame) {
+		const auto index = (frame < warmup) ? frame : frame - warmup;
+
+		commands.reset();
+		capture.replay(index, placeholders, commands);
+
+		const auto start = SDL_GetPerformanceCounter();
+		commands.execute(renderer, rasterizer);
+		const auto elapsed = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+
+		if (frame >= warmup) {
+			frameTimes.push_back(elapsed);
+			capturedTimes.push_back(capture.capturedMilliseconds(index));
+		}
+	}
+
+	double total = 0.0;
+
+	for (auto time : frameTimes) {
+		total += time;
+	}
+
+	const auto slowest = std::max_element(frameTimes.begin(), frameTimes.end()) - frameTimes.begin();
+	const auto capturedSlowest = std::max_element(capturedTimes.begin(), capturedTimes.end()) - capturedTimes.begin();
+
+	result.fps = (total > 0.0) ? frameTimes.size() * 1000.0 / total : 0.0;
+	result.p50 = percentile(frameTimes, 0.50);
+	result.p99 = percentile(frameTimes, 0.99);
+	result.capturedP50 = percentile(capturedTimes, 0.50);
+	result.capturedP99 = percentile(capturedTimes, 0.99);
+	result.slowestFrame = static_cast<std::size_t>(slowest);
+	result.slowestMilliseconds = frameTimes[slowest];
+	result.capturedSlowestFrame = static_cast<std::size_t>(capturedSlowest);
+	result.capturedSlowestMilliseconds = capturedTimes[capturedSlowest];
+
+	return true;
+}
+
+std::string jsonEscape(const std::string& text) {
+	std::string escaped;
+
+	for (const auto c : text) {
+		if ((c == '"') || (c == '\\')) {
+			escaped += '\\';
+		}
+
+		escaped += c;
+	}
+
+	return escaped;
+}
+
+bool hasArgument(int argc, char *argv[], const std::string& flag) {
+	return std::find(argv + 1, argv + argc, flag) != argv + argc;
+}
+
+std::string argumentValue(int argc, char *argv[], const std::string& prefix) {
+	for (auto i = 1; i < argc; ++i) {
+		const std::string argument = argv[i];
+
+		if (argument.compare(0, prefix.size(), prefix) == 0) {
+			return argument.substr(prefix.size());
+		}
+	}
+
+	return std::string();
+}
+
+int main(int argc, char *argv[])
+{
+	/** Benchmark options
+	 *
+	 *  Description:
+	 *  --renderer=software (default) renders into an offscreen surface with SDL's software renderer,
+	 *  which needs no display at all. --renderer=accelerated uses a hidden window with the hardware
+	 *  driver the game itself would pick, and --renderer=<driver> (opengl, direct3d11, ...) uses a
+	 *  hidden window with that driver, so backends can be compared on the same machine.
+	 *
+	 *  --frames=N sets how many frames each scene measures, --scene=name runs only the scenes whose
+	 *  name contains the filter, and --output=file writes the results there instead of stdout (a
+	 *  file that can't be opened is an error). --jobs=N sets how many worker threads moving scenes
+	 *  update their sprites on (default: one per spare core, 0 for the main thread only). Results
+	 *  are one JSON object per line, one line per scene.
+	 *
+	 *  --cpu-raster draws the sprites with the TileRasterizer, on the worker threads, rather than
+	 *  through the renderer; it's meant for the software renderer, which the game falls back to when
+	 *  there's no hardware one.
+	 *
+	 *  --frame-budget=<list> (draws=N,switches=N,vertices=N,upload=bytes) counts, for every scene,
+	 *  the measured frames that went over any of the limits given; each scene's line also has the
+	 *  most any one frame used of each, whatever the budget, to set budgets from.
+	 *
+	 *  --replay=file replays a capture written by sdl-test --capture=file instead of running the
+	 *  scenes, at the size it was captured at, and writes a single line with its timings.
+	 *
+	 */
+
+	const auto rendererName = argumentValue(argc, argv, "--renderer=");
+	const auto accelerated = !rendererName.empty() && (rendererName != "software");
+	const auto sceneFilter = argumentValue(argc, argv, "--scene=");
+	const auto outputPath = argumentValue(argc, argv, "--output=");
+	const auto framesArgument = argumentValue(argc, argv, "--frames=");
+	const auto frames = framesArgument.empty() ? DEFAULT_FRAMES : std::max(std::atoi(framesArgument.c_str()), 1);
+	const auto jobsArgument = argumentValue(argc, argv, "--jobs=");
+	const auto replayPath = argumentValue(argc, argv, "--replay=");
+	const auto cpuRaster = hasArgument(argc, argv, "--cpu-raster");
+	const auto budgetArgument = argumentValue(argc, argv, "--frame-budget=");
+
+	if (!budgetArgument.empty()) {
+		FrameBudget budget;
+
+		if (!parseFrameBudget(budgetArgument, budget)) {
+			std::cerr << "FrameBudget error: could not read " << budgetArgument << '\n';
+			return EXIT_FAILURE;
+		}
+
+		RenderStats::instance().setBudget(budget);
+	}
+
+	std::unique_ptr<CaptureReplay> capture;
+
+	if (!replayPath.empty()) {
+		capture = CaptureReplay::open(replayPath);
+
+		if (!capture) {
+			return EXIT_FAILURE;
+		}
+	}
+
+	const auto width = capture ? capture->width() : SCREEN_WIDTH;
+	const auto height = capture ? capture->height() : SCREEN_HEIGHT;
+
+	SDLContext sdl(accelerated ? SDL_INIT_VIDEO : 0);
+
+	if (!sdl) {
+		LogSDLError(std::cerr, "SDL_Init");
+		return EXIT_FAILURE;
+	}
+
+	WindowPtr window;
+	SurfacePtr target;
+	RendererPtr rendererHandle;
+
+	if (accelerated) {
+		window.reset(SDL_CreateWindow("sdl-bench", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, width, height, SDL_WINDOW_HIDDEN));
+
+		if (window) {
+			const auto driverIndex = chooseRenderDriver(renderDrivers(), (rendererName == "accelerated") ? std::string() : rendererName);
+			rendererHandle.reset(SDL_CreateRenderer(window.get(), driverIndex, SDL_RENDERER_ACCELERATED));
+		}
+	} else {
+		target.reset(SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888));
+
+		if (target) {
+			rendererHandle.reset(SDL_CreateSoftwareRenderer(target.get()));
+		}
+	}
+
+	if (!rendererHandle) {
+		LogSDLError(std::cerr, "CreateRenderer");
+		return EXIT_FAILURE;
+	}
+
+	SDL_Renderer *renderer = rendererHandle.get();
+
+	// Results name the driver that actually ran, which matters more than what was asked for
+	RendererCaps capabilities;
+	probeRenderer(renderer, capabilities);
+
+	JobSystem jobs(jobsArgument.empty() ? JobSystem::defaultWorkerCount() : static_cast<unsigned>(std::max(std::atoi(jobsArgument.c_str()), 0)));
+
+	std::ofstream outputFile;
+
+	if (!outputPath.empty()) {
+		outputFile.open(outputPath);
+
+		if (!outputFile) {
+			std::cerr << "Could not open " << outputPath << " for writing\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	std::ostream& output = outputFile.is_open() ? outputFile : std::cout;
+	auto exitCode = EXIT_SUCCESS;
+
+	if (capture) {
+		ReplayResult result;
+
+		StreamingTexturePool streamingPool(renderer, 0);
+		std::unique_ptr<TileRasterizer> rasterizer;
+
+		if (cpuRaster) {
+			rasterizer.reset(new TileRasterizer(streamingPool, &jobs, width, height));
+		}
+
+		if (!replayCapture(renderer, rasterizer.get(), *capture, result)) {
+			return EXIT_FAILURE;
+		}
+
+		output << "{\"replay\":\"" << jsonEscape(replayPath) << "\""
+			<< ",\"renderer\":\"" << capabilities.name << "\""
+			<< ",\"cpu_raster\":" << (cpuRaster ? "true" : "false")
+			<< ",\"frames\":" << capture->frameCount()
+			<< ",\"textures\":" << capture->textureCount()
+			<< ",\"fps\":" << result.fps
+			<< ",\"p50_ms\":" << result.p50
+			<< ",\"p99_ms\":" << result.p99
+			<< ",\"captured_p50_ms\":" << result.capturedP50
+			<< ",\"captured_p99_ms\":" << result.capturedP99
+			<< ",\"slowest_frame\":" << result.slowestFrame
+			<< ",\"slowest_ms\":" << result.slowestMilliseconds
+			<< ",\"captured_slowest_frame\":" << result.capturedSlowestFrame
+			<< ",\"captured_slowest_ms\":" << result.capturedSlowestMilliseconds
+			<< "}" << std::endl;
+
+		return exitCode;
+	}
+
+	for (const auto& scene : SCENES) {
+		if (!sceneFilter.empty() && (std::string(scene.name).find(sceneFilter) == std::string::npos)) {
+			continue;
+		}
+
+		SceneResult result;
+
+		if (!runScene(renderer, jobs, cpuRaster, scene, frames, result)) {
+			exitCode = EXIT_FAILURE;
+			break;
+		}
+
+		const auto worldArea = static_cast<double>(SCREEN_WIDTH) * SCREEN_HEIGHT * scene.worldScale * scene.worldScale;
+		const auto overdraw = static_cast<double>(scene.sprites) * scene.spriteSize * scene.spriteSize / worldArea;
+
+		output << "{\"scene\":\"" << scene.name << "\""
+			<< ",\"renderer\":\"" << capabilities.name << "\""
+			<< ",\"cpu_raster\":" << (cpuRaster ? "true" : "false")
+			<< ",\"frames\":" << frames
+			<< ",\"workers\":" << jobs.workerCount()
+			<< ",\"sprites\":" << scene.sprites
+			<< ",\"textures\":" << scene.textures
+			<< ",\"overdraw\":" << overdraw
+			<< ",\"fps\":" << result.fps
+			<< ",\"p50_ms\":" << result.p50
+			<< ",\"p99_ms\":" << result.p99
+			<< ",\"draw_calls_per_frame\":" << result.drawCallsPerFrame
+			<< ",\"texture_switches_per_frame\":" << result.textureSwitchesPerFrame
+			<< ",\"sprites_per_frame\":" << result.spritesPerFrame
+			<< ",\"uploads_per_frame\":" << result.uploadsPerFrame
+			<< ",\"vertices_per_frame\":" << result.verticesPerFrame
+			<< ",\"upload_bytes_per_frame\":" << result.uploadBytesPerFrame
+			<< ",\"worst_draw_calls\":" << result.worst.drawCalls
+			<< ",\"worst_texture_switches\":" << result.worst.textureSwitches
+			<< ",\"worst_vertices\":" << result.worst.vertices
+			<< ",\"worst_upload_bytes\":" << result.worst.uploadBytes
+			<< ",\"frames_over_budget\":" << result.framesOverBudget
+			<< "}" << std::endl;
+	}
+
+	return exitCode;
+}
@@ -0,0 +1,199 @@
+#include "Animation.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Profiler.h"
+
+const std::size_t AnimationPlayer::INVALID_ENTRY;
+const Uint32 AnimationPlayer::NO_FRAME;
+
+AnimationLibrary::AnimationLibrary(double tickHz)
+	: tickHz(std::max(tickHz, 1.0)) {
+}
+
+ClipId AnimationLibrary::addClip(const std::string& name, const std::vector<AnimationFrame>& clipFrames, bool loop) {
+	if (clipFrames.empty()) {
+		return INVALID_CLIP;
+	}
+
+	const auto firstFrame = static_cast<Uint32>(frames.size());
+	auto totalSeconds = 0.0;
+
+	for (const auto& clipFrame : clipFrames) {
+		frames.push_back(clipFrame.region);
+		totalSeconds += std::max(clipFrame.duration, 0.0f);
+	}
+
+	const auto length = std::max(static_cast<Uint32>(std::lround(totalSeconds * tickHz)), Uint32 { 1 });
+
+	Clip clip;
+	clip.offset = frameTable.size();
+	clip.length = length;
+	clip.loop = loop;
+
+	// Sample the middle of each tick, so rounding doesn't favour either neighbouring frame
+	std::size_t current = 0;
+	auto frameEnds = static_cast<double>(clipFrames[0].duration);
+
+	for (Uint32 tick = 0; tick < length; ++tick) {
+		const auto time = (tick + 0.5) / tickHz;
+
+		while ((time >= frameEnds) && (current + 1 < clipFrames.size())) {
+			++current;
+			frameEnds += clipFrames[current].duration;
+		}
+
+		frameTable.push_back(firstFrame + static_cast<Uint32>(current));
+	}
+
+	const auto id = static_cast<ClipId>(clips.size());
+	clips.push_back(clip);
+	names[name] = id;
+
+	return id;
+}
+
+ClipId AnimationLibrary::addClip(const std::string& name, const std::vector<AtlasRegion>& regions, float framesPerSecond, bool loop) {
+	std::vector<AnimationFrame> clipFrames(regions.size());
+
+	for (std::size_t i = 0; i < regions.size(); ++i) {
+		clipFrames[i].region = regions[i];
+		clipFrames[i].duration = 1.0f / std::max(framesPerSecond, 0.001f);
+	}
+
+	return addClip(name, clipFrames, loop);
+}
+
+ClipId AnimationLibrary::find(const std::string& name) const {
+	const auto found = names.find(name);
+
+	return (found != names.end()) ? found->second : INVALID_CLIP;
+}
+
+std::vector<AtlasRegion> AnimationLibrary::sliceSheet(const AtlasRegion& sheet, int frameWidth, int frameHeight, int count) {
+	std::vector<AtlasRegion> cells;
+
+	if ((frameWidth <= 0) || (frameHeight <= 0)) {
+		return cells;
+	}
+
+	const auto columns = sheet.rect.w / frameWidth;
+	const auto rows = sheet.rect.h / frameHeight;
+	const auto total = (count > 0) ? std::min(count, columns * rows) : columns * rows;
+
+	cells.reserve(static_cast<std::size_t>(std::max(total, 0)));
+
+	for (auto i = 0; i < total; ++i) {
+		AtlasRegion cell;
+		cell.texture = sheet.texture;
+		cell.rect = SDL_Rect { sheet.rect.x + (i % columns) * frameWidth, sheet.rect.y + (i / columns) * frameHeight, frameWidth, frameHeight };
+
+		cells.push_back(cell);
+	}
+
+	return cells;
+}
+
+AnimationPlayer::AnimationPlayer(const AnimationLibrary& library)
+	: library(library) {
+}
+
+void AnimationPlayer::play(SpriteId sprite, ClipId clip, Uint32 startTick) {
+	if (clip >= library.clipCount()) {
+		return;
+	}
+
+	if (sprite >= entries.size()) {
+		entries.resize(sprite + 1, INVALID_ENTRY);
+	}
+
+	if (entries[sprite] == INVALID_ENTRY) {
+		entries[sprite] = sprites.size();
+
+		sprites.push_back(sprite);
+		clips.push_back(clip);
+		ticks.push_back(0);
+		shown.push_back(NO_FRAME);
+	}
+
+	const auto entry = entries[sprite];
+	const auto length = library.length(clip);
+
+	clips[entry] = clip;
+	ticks[entry] = library.loops(clip) ? startTick % length : std::min(startTick, length - 1);
+	shown[entry] = NO_FRAME;
+}
+
+void AnimationPlayer::stop(SpriteId sprite) {
+	if (!playing(sprite)) {
+		return;
+	}
+
+	// Move the last entry into the hole, so the arrays stay dense
+	const auto entry = entries[sprite];
+	const auto last = sprites.size() - 1;
+
+	sprites[entry] = sprites[last];
+	clips[entry] = clips[last];
+	ticks[entry] = ticks[last];
+	shown[entry] = shown[last];
+
+	entries[sprites[entry]] = entry;
+	entries[sprite] = INVALID_ENTRY;
+
+	sprites.pop_back();
+	clips.pop_back();
+	ticks.pop_back();
+	shown.pop_back();
+}
+
+void AnimationPlayer::clear() {
+	sprites.clear();
+	clips.clear();
+	ticks.clear();
+	shown.clear();
+	entries.clear();
+}
+
+bool AnimationPlayer::finished(SpriteId sprite) const {
+	if (!playing(sprite)) {
+		return true;
+	}
+
+	const auto entry = entries[sprite];
+
+	return !library.loops(clips[entry]) && (ticks[entry] + 1 >= library.length(clips[entry]));
+}
+
+void AnimationPlayer::prepare(SpriteStore& store) {
+	// The store can have been cleared since last time, so every slot is looked up again
+	slots.resize(library.frameCount());
+
+	for (std::size_t i = 0; i < slots.size(); ++i) {
+		slots[i] = store.textureSlot(library.frame(static_cast<Uint32>(i)).texture);
+	}
+}
+
+void AnimationPlayer::step(SpriteStore& store) {
+	step(store, 0, size());
+}
+
+void AnimationPlayer::step(SpriteStore& store, std::size_t first, std::size_t last) {
+	PROFILE_SCOPE("AnimationPlayer::step");
+
+	for (auto i = first; i < last; ++i) {
+		const auto clip = clips[i];
+		const auto length = library.length(clip);
+		const auto frame = library.table(clip)[ticks[i]];
+
+		// Frames added since the last prepare() have no slot yet, so they wait until the next one
+		if ((frame != shown[i]) && (frame < slots.size()) && store.alive(sprites[i])) {
+			shown[i] = frame;
+			store.setSource(sprites[i], library.frame(frame).rect, slots[frame]);
+		}
+
+		const auto next = ticks[i] + 1;
+		ticks[i] = (next < length) ? next : (library.loops(clip) ? 0 : length - 1);
+	}
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+#include "SpriteStore.h"
+#include "TextureAtlas.h"
+
+using ClipId = Uint32;
+
+const auto INVALID_CLIP = ClipId { 0xFFFFFFFF };
+
+struct AnimationFrame {
+	AtlasRegion region;
+
+	// How long the frame shows for, in seconds
+	float duration = 0.1f;
+};
+
+/** Class: AnimationLibrary
+ *
+ *  Description:
+ *  Every animation clip the program knows about. A clip is a sequence of frames, each a region of
+ *  an atlas (usually cut from a sprite sheet with sliceSheet()) shown for its own duration. Clips
+ *  are sampled at a fixed tick rate, normally the simulation rate: adding a clip works out which
+ *  frame is showing at each tick of it and stores that as a table, so playing an animation comes
+ *  down to indexing the table with a tick count, with no time arithmetic at all. Frames shorter
+ *  than a tick may never be shown.
+ *
+ *  Frames are numbered across the whole library, and every table holds library frame numbers.
+ *
+ */
+
+class AnimationLibrary {
+public:
+	explicit AnimationLibrary(double tickHz);
+	AnimationLibrary(const AnimationLibrary&) = delete;
+	AnimationLibrary& operator=(const AnimationLibrary&) = delete;
+
+	// Adding a name that already exists replaces it for find(); clips already playing are unaffected
+	ClipId addClip(const std::string& name, const std::vector<AnimationFrame>& frames, bool loop = true);
+	ClipId addClip(const std::string& name, const std::vector<AtlasRegion>& frames, float framesPerSecond, bool loop = true);
+
+	ClipId find(const std::string& name) const;
+
+	// Cuts a sheet into frameWidth x frameHeight cells, left to right then top to bottom; count 0 takes every whole cell
+	static std::vector<AtlasRegion> sliceSheet(const AtlasRegion& sheet, int frameWidth, int frameHeight, int count = 0);
+
+	std::size_t clipCount() const { return clips.size(); }
+	std::size_t frameCount() const { return frames.size(); }
+	const AtlasRegion& frame(Uint32 index) const { return frames[index]; }
+
+	// Length of a clip in ticks, and the library frame showing at each of them
+	Uint32 length(ClipId clip) const { return clips[clip].length; }
+	bool loops(ClipId clip) const { return clips[clip].loop; }
+	const Uint32* table(ClipId clip) const { return frameTable.data() + clips[clip].offset; }
+
+private:
+	struct Clip {
+		std::size_t offset;
+		Uint32 length;
+		bool loop;
+	};
+
+	double tickHz;
+	std::vector<Clip> clips;
+	std::vector<AtlasRegion> frames;
+	std::vector<Uint32> frameTable;
+	std::unordered_map<std::string, ClipId> names;
+};
+
+/** Class: AnimationPlayer
+ *
+ *  Description:
+ *  Plays clips on sprites in a SpriteStore. What's playing is kept in parallel arrays like the
+ *  store's own (sprite, clip, tick, frame shown), and step() advances all of them by one tick in a
+ *  single pass: each one is a table lookup, and only sprites whose frame actually changed are
+ *  written back to the store. Looping clips wrap; others hold their last frame.
+ *
+ *  The range version of step() is there to split the work across threads. Before stepping in
+ *  parallel, prepare() has to be called on the thread that owns the store, after any clips were
+ *  added or the store cleared, so every frame's texture already has a slot in the store.
+ *
+ */
+
+class AnimationPlayer {
+public:
+	explicit AnimationPlayer(const AnimationLibrary& library);
+	AnimationPlayer(const AnimationPlayer&) = delete;
+	AnimationPlayer& operator=(const AnimationPlayer&) = delete;
+
+	// Starts a clip on a sprite from the given tick, replacing whatever it was playing
+	void play(SpriteId sprite, ClipId clip, Uint32 startTick = 0);
+	void stop(SpriteId sprite);
+	void clear();
+
+	bool playing(SpriteId sprite) const { return (sprite < entries.size()) && (entries[sprite] != INVALID_ENTRY); }
+
+	// True once a clip that doesn't loop has reached its last frame
+	bool finished(SpriteId sprite) const;
+
+	// How many sprites are playing something
+	std::size_t size() const { return sprites.size(); }
+
+	void prepare(SpriteStore& store);
+
+	void step(SpriteStore& store);
+	void step(SpriteStore& store, std::size_t first, std::size_t last);
+
+private:
+	static const std::size_t INVALID_ENTRY = static_cast<std::size_t>(-1);
+	static const Uint32 NO_FRAME = 0xFFFFFFFF;
+
+	const AnimationLibrary& library;
+
+	// Per playing sprite, all indexed the same way
+	std::vector<SpriteId> sprites;
+	std::vector<ClipId> clips;
+	std::vector<Uint32> ticks;
+	std::vector<Uint32> shown;
+
+	// SpriteId -> entry
+	std::vector<std::size_t> entries;
+
+	// Per library frame, its texture's slot in the store
+	std::vector<Uint16> slots;
+};
@@ -0,0 +1,53 @@
+#include "AssetPaths.h"
+
+#include <iostream>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+#include "FileWatcher.h"
+
+std::string findAssetRoot(const std::string& configured, const std::string& probe) {
+	// Asked for by name, so loading something else instead would only hide the mistake
+	if (!configured.empty()) {
+		if (fileStamp(assetPath(configured, probe)).exists()) {
+			return configured;
+		}
+
+		std::cerr << "Asset directory " << configured << " error: " << probe << " not found there\n";
+		return std::string();
+	}
+
+	std::vector<std::string> candidates;
+
+	if (const char *environment = SDL_getenv("SDLTEST_ASSETS")) {
+		candidates.push_back(environment);
+	}
+
+	if (char *basePath = SDL_GetBasePath()) {
+		const std::string base = basePath;
+		SDL_free(basePath);
+
+		candidates.push_back(base + "img");
+		candidates.push_back(base + "../sdl-test/img");
+		candidates.push_back(base + "../../sdl-test/img");
+	}
+
+	candidates.push_back("img");
+
+	for (const auto& candidate : candidates) {
+		if (fileStamp(assetPath(candidate, probe)).exists()) {
+			return candidate;
+		}
+	}
+
+	return std::string("img");
+}
+
+std::string assetPath(const std::string& root, const std::string& name) {
+	if (root.empty() || (root.back() == '/') || (root.back() == '\\')) {
+		return root + name;
+	}
+
+	return root + '/' + name;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+
+/** Function: findAssetRoot
+ *
+ *  Description:
+ *  Works out which directory the images live in. A directory given on the command line
+ *  (--assets=<dir>) is the only one considered: if the probe file isn't in it, the error is
+ *  logged and an empty string returned. Otherwise the first of these that contains the probe file
+ *  wins:
+ *
+ *    1. the SDLTEST_ASSETS environment variable
+ *    2. img/ next to the executable
+ *    3. sdl-test/img/ one level up from the executable, where a Win32 Visual Studio build puts it
+ *    4. sdl-test/img/ two levels up, for x64 builds, which go one directory deeper
+ *    5. img/ in the working directory
+ *
+ *  If none of them has it, img/ is returned anyway, so the loads that follow fail with an error
+ *  that names the path.
+ *
+ */
+
+std::string findAssetRoot(const std::string& configured, const std::string& probe);
+
+/** Function: assetPath
+ *
+ *  Description:
+ *  Joins an asset root and a file name, adding a separator between them if the root doesn't
+ *  already end with one.
+ *
+ */
+
+std::string assetPath(const std::string& root, const std::string& name);
@@ -0,0 +1,353 @@
+#include "AsyncLoader.h"
+
+#include <algorithm>
+
+#include "ImageCodec.h"
+#include "Log.h"
+#include "PixelKernels.h"
+#include "Profiler.h"
+#include "RenderStats.h"
+
+void AsyncTexture::decode() {
+	PROFILE_SCOPE("AsyncTexture::decode");
+
+	surface = loadImage(path);
+
+	// Converting here keeps the format conversion off the render thread; the upload is a plain copy
+	if (surface && (surface->format->format != SDL_PIXELFORMAT_ARGB8888)) {
+		surface = convertToARGB8888(surface.get());
+	}
+
+	if (surface) {
+		finish(LoadState::Decoded);
+	} else {
+		fail(SDL_GetError());
+	}
+}
+
+void AsyncTexture::upload(TextureCache& cache) {
+	PROFILE_SCOPE("AsyncTexture::upload");
+
+	TexturePtr texture;
+
+	if (packed) {
+		texture = pack->createTexture(cache.renderer(), *packed);
+	} else {
+		Uint32 key = 0;
+
+		// The pool's textures know nothing of color keys, which SDL_CreateTextureFromSurface turns into alpha
+		if (staging && (SDL_GetColorKey(surface.get(), &key) != 0)) {
+			auto staged = staging->acquire(surface->w, surface->h, surface->format->format);
+
+			// Locking counts the upload
+			if (staged && staged.update(surface->pixels, surface->pitch)) {
+				texture = staged.detach();
+			}
+		}
+
+		if (!texture) {
+			texture.reset(SDL_CreateTextureFromSurface(cache.renderer(), surface.get()));
+
+			if (texture) {
+				RenderStats::instance().countUpload(surface.get());
+			}
+		}
+
+		surface.reset();
+	}
+
+	if (!texture) {
+		fail(SDL_GetError());
+		return;
+	}
+
+	handle = cache.insert(path, std::move(texture));
+	finish(LoadState::Ready);
+}
+
+void AsyncAtlas::decode() {
+	PROFILE_SCOPE("AsyncAtlas::decode");
+
+	for (const auto& path : paths) {
+		const auto name = packEntryName(path);
+		SurfacePtr image;
+
+		// A packed image can be wrapped in place instead of decoded; the builder copies it into a page
+		for (const auto *pack : packs) {
+			const auto *entry = pack->find(name);
+
+			if (entry) {
+				image.reset(SDL_CreateRGBSurfaceWithFormatFrom(const_cast<void*>(pack->pixels(*entry)),
+					static_cast<int>(entry->width), static_cast<int>(entry->height), 32,
+					static_cast<int>(entry->pitch), pack->pixelFormat()));
+				break;
+			}
+		}
+
+		if (!image) {
+			image = loadImage(path);
+		}
+
+		if (!image) {
+			fail(SDL_GetError());
+			return;
+		}
+
+		if (!builder.add(name, std::move(image))) {
+			fail(SDL_GetError());
+			return;
+		}
+	}
+
+	if (!builder.pack()) {
+		fail("could not pack atlas");
+		return;
+	}
+
+	finish(LoadState::Decoded);
+}
+
+void AsyncAtlas::upload(TextureCache& cache) {
+	PROFILE_SCOPE("AsyncAtlas::upload");
+
+	result = TextureAtlas::create(cache.renderer(), builder);
+
+	// The pages live on the GPU now; the CPU copies aren't needed anymore
+	builder.clear();
+
+	if (!result) {
+		fail(SDL_GetError());
+		return;
+	}
+
+	finish(LoadState::Ready);
+}
+
+void AsyncReload::decode() {
+	PROFILE_SCOPE("AsyncReload::decode");
+
+	// The file that changed, not a .qoi converted from an older version of it
+	surface = loadImageFile(path);
+
+	if (surface && (surface->format->format != SDL_PIXELFORMAT_ARGB8888)) {
+		surface = convertToARGB8888(surface.get());
+	}
+
+	if (surface) {
+		finish(LoadState::Decoded);
+	} else {
+		fail(SDL_GetError());
+	}
+}
+
+void AsyncReload::upload(TextureCache& cache) {
+	PROFILE_SCOPE("AsyncReload::upload");
+
+	const auto updated = atlas ? atlas->result->update(packEntryName(path), surface.get()) : cache.reload(path, surface.get());
+
+	surface.reset();
+
+	if (!updated) {
+		fail(SDL_GetError());
+		return;
+	}
+
+	finish(LoadState::Ready);
+}
+
+AsyncLoader::AsyncLoader(TextureCache& cache, unsigned workerCount, StreamingTexturePool *stagingPool)
+	: cache(cache), staging(stagingPool) {
+	workerCount = std::max(workerCount, 1u);
+
+	for (unsigned i = 0; i < workerCount; ++i) {
+		workers.emplace_back(&AsyncLoader::workerMain, this);
+	}
+}
+
+AsyncLoader::~AsyncLoader() {
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+
+	queueSignal.notify_all();
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+unsigned AsyncLoader::defaultWorkerCount() {
+	// Leave one core for the render thread
+	return static_cast<unsigned>(std::max(SDL_GetCPUCount() - 1, 1));
+}
+
+void AsyncLoader::mount(const TexturePack& pack) {
+	packs.push_back(&pack);
+}
+
+AsyncTextureHandle AsyncLoader::request(const std::string& path) {
+	auto request = std::make_shared<AsyncTexture>(path);
+
+	auto cached = cache.find(path);
+
+	if (cached) {
+		request->handle = cached;
+		request->finish(LoadState::Ready);
+		return request;
+	}
+
+	auto inProgress = inFlight.find(path);
+
+	if (inProgress != inFlight.end()) {
+		return inProgress->second;
+	}
+
+	inFlight.emplace(path, request);
+	request->staging = staging;
+
+	const auto name = packEntryName(path);
+
+	for (const auto *pack : packs) {
+		const auto *entry = pack->find(name);
+
+		if (entry) {
+			request->pack = pack;
+			request->packed = entry;
+			request->finish(LoadState::Decoded);
+
+			std::lock_guard<std::mutex> lock(queueMutex);
+			uploadQueue.push_back(request);
+
+			return request;
+		}
+	}
+
+	enqueueDecode(request);
+	return request;
+}
+
+AsyncAtlasHandle AsyncLoader::requestAtlas(const std::vector<std::string>& paths, int pageSize) {
+	auto request = std::make_shared<AsyncAtlas>(paths, pageSize);
+
+	if (paths.empty()) {
+		request->fail("atlas requested with no images");
+		return request;
+	}
+
+	request->packs = packs;
+	atlases.push_back(request);
+
+	enqueueDecode(request);
+	return request;
+}
+
+std::vector<AsyncReloadHandle> AsyncLoader::reload(const std::string& path) {
+	std::vector<AsyncReloadHandle> reloads;
+
+	if (cache.contains(path)) {
+		reloads.push_back(std::make_shared<AsyncReload>(path, nullptr));
+	}
+
+	// Forget atlases nobody holds anymore while looking for the ones built from this file
+	atlases.erase(std::remove_if(atlases.begin(), atlases.end(), [](const std::weak_ptr<AsyncAtlas>& atlas) { return atlas.expired(); }), atlases.end());
+
+	for (const auto& weakAtlas : atlases) {
+		auto atlas = weakAtlas.lock();
+
+		if (atlas->isReady() && (std::find(atlas->paths.begin(), atlas->paths.end(), path) != atlas->paths.end())) {
+			reloads.push_back(std::make_shared<AsyncReload>(path, atlas));
+		}
+	}
+
+	for (const auto& reload : reloads) {
+		enqueueDecode(reload);
+	}
+
+	return reloads;
+}
+
+void AsyncLoader::enqueueDecode(RequestHandle request) {
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		decodeQueue.push_back(std::move(request));
+	}
+
+	queueSignal.notify_one();
+}
+
+std::size_t AsyncLoader::pumpUploads(double budgetMilliseconds) {
+	PROFILE_SCOPE("AsyncLoader::pumpUploads");
+
+	const auto frequency = static_cast<double>(SDL_GetPerformanceFrequency());
+	const auto start = SDL_GetPerformanceCounter();
+
+	std::size_t uploaded = 0;
+
+	for (;;) {
+		RequestHandle next;
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+
+			if (uploadQueue.empty()) {
+				break;
+			}
+
+			next = std::move(uploadQueue.front());
+			uploadQueue.pop_front();
+		}
+
+		auto tracked = inFlight.find(next->name());
+
+		if ((tracked != inFlight.end()) && (tracked->second == next)) {
+			inFlight.erase(tracked);
+		}
+
+		if (next->state() == LoadState::Decoded) {
+			next->upload(cache);
+		}
+
+		if (next->isFailed()) {
+			std::cerr << "AsyncLoader " << next->name() << " error: " << next->error() << '\n';
+		} else {
+			++uploadsFinished;
+		}
+
+		++uploaded;
+
+		// Always make some progress, then stop once this frame's slice is used up
+		const auto elapsed = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+
+		if (elapsed >= budgetMilliseconds) {
+			break;
+		}
+	}
+
+	return uploaded;
+}
+
+void AsyncLoader::workerMain() {
+	for (;;) {
+		RequestHandle next;
+
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueSignal.wait(lock, [this] { return stopping || !decodeQueue.empty(); });
+
+			if (stopping) {
+				return;
+			}
+
+			next = std::move(decodeQueue.front());
+			decodeQueue.pop_front();
+		}
+
+		next->decode();
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			uploadQueue.push_back(std::move(next));
+		}
+	}
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+#include "StreamingTexture.h"
+#include "TextureAtlas.h"
+#include "TextureCache.h"
+#include "TexturePack.h"
+
+enum class LoadState {
+	Pending,
+	Decoded,
+	Ready,
+	Failed
+};
+
+/** Class: AsyncRequest
+ *
+ *  Description:
+ *  Something the loader is working on. The game polls it once per frame; it becomes ready once the
+ *  decoded data has been uploaded on the render thread. A failed request keeps the error message
+ *  that caused it. Each kind of request decides what decoding (on a worker) and uploading (on the
+ *  render thread) mean for it.
+ *
+ */
+
+class AsyncRequest {
+public:
+	AsyncRequest() = default;
+	AsyncRequest(const AsyncRequest&) = delete;
+	AsyncRequest& operator=(const AsyncRequest&) = delete;
+	virtual ~AsyncRequest() = default;
+
+	LoadState state() const { return loadState.load(std::memory_order_acquire); }
+	bool isReady() const { return state() == LoadState::Ready; }
+	bool isFailed() const { return state() == LoadState::Failed; }
+	bool isDone() const { return isReady() || isFailed(); }
+
+	// Only valid once the request has failed
+	const std::string& error() const { return errorMessage; }
+
+protected:
+	friend class AsyncLoader;
+
+	virtual void decode() = 0;
+	virtual void upload(TextureCache& cache) = 0;
+	virtual const std::string& name() const = 0;
+
+	void finish(LoadState outcome) { loadState.store(outcome, std::memory_order_release); }
+	void fail(const std::string& message) { errorMessage = message; finish(LoadState::Failed); }
+
+	std::vector<const TexturePack*> packs;
+
+private:
+	std::atomic<LoadState> loadState { LoadState::Pending };
+	std::string errorMessage;
+};
+
+/** Class: AsyncTexture
+ *
+ *  Description:
+ *  A single image, loaded into the texture cache. Once ready, texture() returns its cache handle.
+ *
+ */
+
+class AsyncTexture : public AsyncRequest {
+public:
+	explicit AsyncTexture(const std::string& path) : path(path) {}
+
+	// Only valid once the request is ready
+	const TextureHandle& texture() const { return handle; }
+
+	const std::string path;
+
+protected:
+	void decode() override;
+	void upload(TextureCache& cache) override;
+	const std::string& name() const override { return path; }
+
+private:
+	friend class AsyncLoader;
+
+	SurfacePtr surface;
+	const TexturePack *pack = nullptr;
+	const TexturePackEntry *packed = nullptr;
+	StreamingTexturePool *staging = nullptr;
+	TextureHandle handle;
+};
+
+/** Class: AsyncAtlas
+ *
+ *  Description:
+ *  A group of images packed into one atlas. Decoding and packing both happen on a worker; only
+ *  the finished pages are uploaded on the render thread. Regions are looked up by the image's file
+ *  name without directories.
+ *
+ */
+
+class AsyncAtlas : public AsyncRequest {
+public:
+	AsyncAtlas(const std::vector<std::string>& paths, int pageSize) : paths(paths), builder(pageSize) {}
+
+	// Only valid once the request is ready
+	const TextureAtlas& atlas() const { return *result; }
+
+	const std::vector<std::string> paths;
+
+protected:
+	void decode() override;
+	void upload(TextureCache& cache) override;
+	const std::string& name() const override { return paths.front(); }
+
+private:
+	friend class AsyncReload;
+
+	AtlasBuilder builder;
+	std::unique_ptr<TextureAtlas> result;
+};
+
+using AsyncTextureHandle = std::shared_ptr<AsyncTexture>;
+using AsyncAtlasHandle = std::shared_ptr<AsyncAtlas>;
+
+/** Class: AsyncReload
+ *
+ *  Description:
+ *  A changed image being decoded again and written over the copy that's already loaded, either a
+ *  texture in the cache or an image packed into an atlas. The reload keeps the atlas it's writing
+ *  into alive until it's done.
+ *
+ */
+
+class AsyncReload : public AsyncRequest {
+public:
+	AsyncReload(const std::string& path, AsyncAtlasHandle atlas) : path(path), atlas(std::move(atlas)) {}
+
+	const std::string path;
+
+protected:
+	void decode() override;
+	void upload(TextureCache& cache) override;
+	const std::string& name() const override { return path; }
+
+private:
+	AsyncAtlasHandle atlas;
+	SurfacePtr surface;
+};
+
+using AsyncReloadHandle = std::shared_ptr<AsyncReload>;
+
+/** Class: AsyncLoader
+ *
+ *  Description:
+ *  Moves file I/O and image decoding off the render thread. Requests are handed to a pool of
+ *  worker threads that each read and decode into an SDL_Surface; the render thread then calls
+ *  pumpUploads() once per frame to turn decoded surfaces into textures, stopping as soon as the
+ *  frame's upload budget is used up. Uploaded textures go into the texture cache, so a path that
+ *  is already cached (or already in flight) is never decoded twice.
+ *
+ *  Images found in a mounted texture pack skip the workers entirely: they are already in the
+ *  renderer's format, so the render thread uploads them directly from the pack's mapping. Packed
+ *  images that go into an atlas are still copied into its pages, on a worker, like any other.
+ *
+ *  Given a StreamingTexturePool, decoded images are copied into a texture from the pool instead of
+ *  one SDL_CreateTextureFromSurface makes, so an idle texture of the right size is reused rather
+ *  than created; the cache then owns it. The pool has to outlive the loader.
+ *
+ *  reload() is for when an image changes on disk. It decodes the file again (never from a pack,
+ *  which is what's out of date) and writes it over every loaded copy: the cached texture, and the
+ *  image's region in any atlas that was built from it. Handles and regions already handed out
+ *  keep working and show the new pixels. uploadCount() goes up with every finished upload, so
+ *  anything that caches what was drawn from loaded textures can tell when to redraw.
+ *
+ *  Everything except the workers' decoding runs on the thread that owns the renderer.
+ *
+ */
+
+class AsyncLoader {
+public:
+	AsyncLoader(TextureCache& cache, unsigned workerCount, StreamingTexturePool *stagingPool = nullptr);
+	AsyncLoader(const AsyncLoader&) = delete;
+	AsyncLoader& operator=(const AsyncLoader&) = delete;
+	~AsyncLoader();
+
+	void mount(const TexturePack& pack);
+
+	AsyncTextureHandle request(const std::string& path);
+	AsyncAtlasHandle requestAtlas(const std::vector<std::string>& paths, int pageSize);
+
+	// Returns the reloads queued for the file, one per loaded copy (so none if it isn't loaded)
+	std::vector<AsyncReloadHandle> reload(const std::string& path);
+
+	std::size_t pumpUploads(double budgetMilliseconds);
+
+	std::size_t pending() const { return inFlight.size(); }
+	std::size_t uploadCount() const { return uploadsFinished; }
+
+	static unsigned defaultWorkerCount();
+
+private:
+	using RequestHandle = std::shared_ptr<AsyncRequest>;
+
+	void enqueueDecode(RequestHandle request);
+	void workerMain();
+
+	TextureCache& cache;
+	StreamingTexturePool *staging;
+	std::vector<const TexturePack*> packs;
+	std::unordered_map<std::string, AsyncTextureHandle> inFlight;
+	std::vector<std::weak_ptr<AsyncAtlas>> atlases;
+	std::size_t uploadsFinished = 0;
+
+	std::vector<std::thread> workers;
+	std::mutex queueMutex;
+	std::condition_variable queueSignal;
+	std::deque<RequestHandle> decodeQueue;
+	std::deque<RequestHandle> uploadQueue;
+	bool stopping = false;
+};
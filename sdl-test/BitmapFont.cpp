@@ -0,0 +1,294 @@
+#include "BitmapFont.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "Log.h"
+#include "Profiler.h"
+#include "RenderStats.h"
+#include "SpriteBatch.h"
+
+namespace {
+	const char FIRST_CHARACTER = ' ';
+	const char LAST_CHARACTER = '~';
+	const std::size_t GLYPH_COUNT = LAST_CHARACTER - FIRST_CHARACTER + 1;
+
+	// The atlas has 16 glyphs to a row, each in a cell a pixel larger than the glyph on two sides
+	const int ATLAS_COLUMNS = 16;
+	const int ATLAS_ROWS_PER_COLOR = static_cast<int>((GLYPH_COUNT + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS);
+	const int CELL_WIDTH = FONT_GLYPH_WIDTH + 1;
+	const int CELL_HEIGHT = FONT_GLYPH_HEIGHT + 1;
+
+	// How often endFrame() looks for stale runs, and how long a run may go undrawn before it goes
+	const Uint64 RUN_SWEEP_FRAMES = 60;
+	const Uint64 RUN_LIFETIME_FRAMES = 300;
+
+	// One byte per column, left to right, with the top row in the lowest bit
+	const Uint8 GLYPH_COLUMNS[GLYPH_COUNT][FONT_GLYPH_WIDTH] = {
+		{ 0x00, 0x00, 0x00, 0x00, 0x00 }, // ' '
+		{ 0x00, 0x00, 0x5F, 0x00, 0x00 }, // !
+		{ 0x00, 0x07, 0x00, 0x07, 0x00 }, // "
+		{ 0x14, 0x7F, 0x14, 0x7F, 0x14 }, // #
+		{ 0x24, 0x2A, 0x7F, 0x2A, 0x12 }, // $
+		{ 0x23, 0x13, 0x08, 0x64, 0x62 }, // %
+		{ 0x36, 0x49, 0x55, 0x22, 0x50 }, // &
+		{ 0x00, 0x05, 0x03, 0x00, 0x00 }, // '
+		{ 0x00, 0x1C, 0x22, 0x41, 0x00 }, // (
+		{ 0x00, 0x41, 0x22, 0x1C, 0x00 }, // )
+		{ 0x14, 0x08, 0x3E, 0x08, 0x14 }, // *
+		{ 0x08, 0x08, 0x3E, 0x08, 0x08 }, // +
+		{ 0x00, 0x50, 0x30, 0x00, 0x00 }, // ,
+		{ 0x08, 0x08, 0x08, 0x08, 0x08 }, // -
+		{ 0x00, 0x60, 0x60, 0x00, 0x00 }, // .
+		{ 0x20, 0x10, 0x08, 0x04, 0x02 }, // /
+		{ 0x3E, 0x51, 0x49, 0x45, 0x3E }, // 0
+		{ 0x00, 0x42, 0x7F, 0x40, 0x00 }, // 1
+		{ 0x42, 0x61, 0x51, 0x49, 0x46 }, // 2
+		{ 0x21, 0x41, 0x45, 0x4B, 0x31 }, // 3
+		{ 0x18, 0x14, 0x12, 0x7F, 0x10 }, // 4
+		{ 0x27, 0x45, 0x45, 0x45, 0x39 }, // 5
+		{ 0x3C, 0x4A, 0x49, 0x49, 0x30 }, // 6
+		{ 0x01, 0x71, 0x09, 0x05, 0x03 }, // 7
+		{ 0x36, 0x49, 0x49, 0x49, 0x36 }, // 8
+		{ 0x06, 0x49, 0x49, 0x29, 0x1E }, // 9
+		{ 0x00, 0x36, 0x36, 0x00, 0x00 }, // :
+		{ 0x00, 0x56, 0x36, 0x00, 0x00 }, // ;
+		{ 0x08, 0x14, 0x22, 0x41, 0x00 }, // <
+		{ 0x14, 0x14, 0x14, 0x14, 0x14 }, // =
+		{ 0x00, 0x41, 0x22, 0x14, 0x08 }, // >
+		{ 0x02, 0x01, 0x51, 0x09, 0x06 }, // ?
+		{ 0x32, 0x49, 0x79, 0x41, 0x3E }, // @
+		{ 0x7E, 0x11, 0x11, 0x11, 0x7E }, // A
+		{ 0x7F, 0x49, 0x49, 0x49, 0x36 }, // B
+		{ 0x3E, 0x41, 0x41, 0x41, 0x22 }, // C
+		{ 0x7F, 0x41, 0x41, 0x22, 0x1C }, // D
+		{ 0x7F, 0x49, 0x49, 0x49, 0x41 }, // E
+		{ 0x7F, 0x09, 0x09, 0x09, 0x01 }, // F
+		{ 0x3E, 0x41, 0x49, 0x49, 0x7A }, // G
+		{ 0x7F, 0x08, 0x08, 0x08, 0x7F }, // H
+		{ 0x00, 0x41, 0x7F, 0x41, 0x00 }, // I
+		{ 0x20, 0x40, 0x41, 0x3F, 0x01 }, // J
+		{ 0x7F, 0x08, 0x14, 0x22, 0x41 }, // K
+		{ 0x7F, 0x40, 0x40, 0x40, 0x40 }, // L
+		{ 0x7F, 0x02, 0x0C, 0x02, 0x7F }, // M
+		{ 0x7F, 0x04, 0x08, 0x10, 0x7F }, // N
+		{ 0x3E, 0x41, 0x41, 0x41, 0x3E }, // O
+		{ 0x7F, 0x09, 0x09, 0x09, 0x06 }, // P
+		{ 0x3E, 0x41, 0x51, 0x21, 0x5E }, // Q
+		{ 0x7F, 0x09, 0x19, 0x29, 0x46 }, // R
+		{ 0x46, 0x49, 0x49, 0x49, 0x31 }, // S
+		{ 0x01, 0x01, 0x7F, 0x01, 0x01 }, // T
+		{ 0x3F, 0x40, 0x40, 0x40, 0x3F }, // U
+		{ 0x1F, 0x20, 0x40, 0x20, 0x1F }, // V
+		{ 0x3F, 0x40, 0x38, 0x40, 0x3F }, // W
+		{ 0x63, 0x14, 0x08, 0x14, 0x63 }, // X
+		{ 0x07, 0x08, 0x70, 0x08, 0x07 }, // Y
+		{ 0x61, 0x51, 0x49, 0x45, 0x43 }, // Z
+		{ 0x00, 0x7F, 0x41, 0x41, 0x00 }, // [
+		{ 0x02, 0x04, 0x08, 0x10, 0x20 }, // backslash
+		{ 0x00, 0x41, 0x41, 0x7F, 0x00 }, // ]
+		{ 0x04, 0x02, 0x01, 0x02, 0x04 }, // ^
+		{ 0x40, 0x40, 0x40, 0x40, 0x40 }, // _
+		{ 0x00, 0x01, 0x02, 0x04, 0x00 }, // `
+		{ 0x20, 0x54, 0x54, 0x54, 0x78 }, // a
+		{ 0x7F, 0x48, 0x44, 0x44, 0x38 }, // b
+		{ 0x38, 0x44, 0x44, 0x44, 0x20 }, // c
+		{ 0x38, 0x44, 0x44, 0x48, 0x7F }, // d
+		{ 0x38, 0x54, 0x54, 0x54, 0x18 }, // e
+		{ 0x08, 0x7E, 0x09, 0x01, 0x02 }, // f
+		{ 0x0C, 0x52, 0x52, 0x52, 0x3E }, // g
+		{ 0x7F, 0x08, 0x04, 0x04, 0x78 }, // h
+		{ 0x00, 0x44, 0x7D, 0x40, 0x00 }, // i
+		{ 0x20, 0x40, 0x44, 0x3D, 0x00 }, // j
+		{ 0x7F, 0x10, 0x28, 0x44, 0x00 }, // k
+		{ 0x00, 0x41, 0x7F, 0x40, 0x00 }, // l
+		{ 0x7C, 0x04, 0x18, 0x04, 0x78 }, // m
+		{ 0x7C, 0x08, 0x04, 0x04, 0x78 }, // n
+		{ 0x38, 0x44, 0x44, 0x44, 0x38 }, // o
+		{ 0x7C, 0x14, 0x14, 0x14, 0x08 }, // p
+		{ 0x08, 0x14, 0x14, 0x18, 0x7C }, // q
+		{ 0x7C, 0x08, 0x04, 0x04, 0x08 }, // r
+		{ 0x48, 0x54, 0x54, 0x54, 0x20 }, // s
+		{ 0x04, 0x3F, 0x44, 0x40, 0x20 }, // t
+		{ 0x3C, 0x40, 0x40, 0x20, 0x7C }, // u
+		{ 0x1C, 0x20, 0x40, 0x20, 0x1C }, // v
+		{ 0x3C, 0x40, 0x30, 0x40, 0x3C }, // w
+		{ 0x44, 0x28, 0x10, 0x28, 0x44 }, // x
+		{ 0x0C, 0x50, 0x50, 0x50, 0x3C }, // y
+		{ 0x44, 0x64, 0x54, 0x4C, 0x44 }, // z
+		{ 0x00, 0x08, 0x36, 0x41, 0x00 }, // {
+		{ 0x00, 0x00, 0x7F, 0x00, 0x00 }, // |
+		{ 0x00, 0x41, 0x36, 0x08, 0x00 }, // }
+		{ 0x08, 0x04, 0x08, 0x10, 0x08 }  // ~
+	};
+
+	std::size_t glyphIndex(char character) {
+		if ((character < FIRST_CHARACTER) || (character > LAST_CHARACTER)) {
+			character = '?';
+		}
+
+		return static_cast<std::size_t>(character - FIRST_CHARACTER);
+	}
+}
+
+std::unique_ptr<BitmapFont> BitmapFont::create(SDL_Renderer *renderer, const std::vector<SDL_Color>& palette) {
+	PROFILE_SCOPE("BitmapFont::create");
+
+	if (palette.empty()) {
+		SDL_SetError("a font needs at least one color");
+		return nullptr;
+	}
+
+	const auto width = ATLAS_COLUMNS * CELL_WIDTH;
+	const auto height = ATLAS_ROWS_PER_COLOR * CELL_HEIGHT * static_cast<int>(palette.size());
+
+	// New surfaces start out zeroed, so everything outside the glyphs is transparent
+	SurfacePtr atlas(SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888));
+
+	if (!atlas) {
+		LogSDLError(std::cerr, "CreateRGBSurfaceWithFormat");
+		return nullptr;
+	}
+
+	std::unique_ptr<BitmapFont> font(new BitmapFont());
+	font->colorCount = palette.size();
+	font->glyphs.reserve(GLYPH_COUNT * palette.size());
+
+	for (std::size_t color = 0; color < palette.size(); ++color) {
+		const auto& c = palette[color];
+		const auto pixel = (static_cast<Uint32>(c.a) << 24) | (static_cast<Uint32>(c.r) << 16) | (static_cast<Uint32>(c.g) << 8) | c.b;
+
+		for (std::size_t index = 0; index < GLYPH_COUNT; ++index) {
+			const auto cellX = static_cast<int>(index % ATLAS_COLUMNS) * CELL_WIDTH;
+			const auto cellY = (static_cast<int>(color) * ATLAS_ROWS_PER_COLOR + static_cast<int>(index / ATLAS_COLUMNS)) * CELL_HEIGHT;
+
+			for (auto column = 0; column < FONT_GLYPH_WIDTH; ++column) {
+				const auto bits = GLYPH_COLUMNS[index][column];
+
+				for (auto row = 0; row < FONT_GLYPH_HEIGHT; ++row) {
+					if (bits & (1 << row)) {
+						auto *line = reinterpret_cast<Uint32*>(static_cast<Uint8*>(atlas->pixels) + (cellY + row) * atlas->pitch);
+						line[cellX + column] = pixel;
+					}
+				}
+			}
+
+			AtlasRegion region;
+			region.rect = SDL_Rect { cellX, cellY, FONT_GLYPH_WIDTH, FONT_GLYPH_HEIGHT };
+			font->glyphs.push_back(region);
+		}
+	}
+
+	font->texture.reset(SDL_CreateTextureFromSurface(renderer, atlas.get()));
+
+	if (!font->texture) {
+		LogSDLError(std::cerr, "CreateTextureFromSurface");
+		return nullptr;
+	}
+
+	RenderStats::instance().countUpload(atlas.get());
+
+	SDL_SetTextureBlendMode(font->texture.get(), SDL_BLENDMODE_BLEND);
+
+	for (auto& region : font->glyphs) {
+		region.texture = font->texture.get();
+	}
+
+	return font;
+}
+
+const AtlasRegion& BitmapFont::glyph(char character, std::size_t color) const {
+	return glyphs[std::min(color, colorCount - 1) * GLYPH_COUNT + glyphIndex(character)];
+}
+
+TextRenderer::TextRenderer(const BitmapFont& font) : font(font), runs(font.colors()) {
+}
+
+template <typename Emit>
+void TextRenderer::layout(const char *text, std::size_t color, Emit emitGlyph, int& width, int& height) const {
+	auto penX = 0;
+	auto penY = 0;
+
+	width = 0;
+	height = (*text != '\0') ? FONT_GLYPH_HEIGHT : 0;
+
+	for (const auto *c = text; *c != '\0'; ++c) {
+		if (*c == '\n') {
+			penX = 0;
+			penY += FONT_LINE_HEIGHT;
+			height = penY + FONT_GLYPH_HEIGHT;
+			continue;
+		}
+
+		// Spaces only move the pen; there's nothing to draw
+		if (*c != ' ') {
+			emitGlyph(Glyph { &font.glyph(*c, color), penX, penY });
+		}
+
+		width = std::max(width, penX + FONT_GLYPH_WIDTH);
+		penX += FONT_ADVANCE;
+	}
+}
+
+SDL_Rect TextRenderer::draw(SpriteBatch& batch, const std::string& text, int x, int y, std::size_t color, int scale, int layer) {
+	color = std::min(color, runs.size() - 1);
+
+	auto& cache = runs[color];
+	auto found = cache.find(text);
+
+	if (found == cache.end()) {
+		Run run;
+		layout(text.c_str(), color, [&](const Glyph& glyph) { run.glyphs.push_back(glyph); }, run.width, run.height);
+
+		found = cache.emplace(text, std::move(run)).first;
+		++frameStats.cacheMisses;
+	} else {
+		++frameStats.cacheHits;
+	}
+
+	auto& run = found->second;
+	run.lastDrawn = frame;
+
+	for (const auto& glyph : run.glyphs) {
+		emit(batch, glyph, x, y, scale, layer);
+	}
+
+	return SDL_Rect { x, y, run.width * scale, run.height * scale };
+}
+
+SDL_Rect TextRenderer::drawUncached(SpriteBatch& batch, const char *text, int x, int y, std::size_t color, int scale, int layer) {
+	auto width = 0;
+	auto height = 0;
+
+	layout(text, color, [&](const Glyph& glyph) { emit(batch, glyph, x, y, scale, layer); }, width, height);
+
+	return SDL_Rect { x, y, width * scale, height * scale };
+}
+
+void TextRenderer::endFrame() {
+	++frame;
+
+	if (frame % RUN_SWEEP_FRAMES == 0) {
+		for (auto& cache : runs) {
+			for (auto run = cache.begin(); run != cache.end();) {
+				run = (run->second.lastDrawn + RUN_LIFETIME_FRAMES < frame) ? cache.erase(run) : std::next(run);
+			}
+		}
+	}
+
+	frameStats.cachedRuns = 0;
+
+	for (const auto& cache : runs) {
+		frameStats.cachedRuns += cache.size();
+	}
+
+	lastStats = frameStats;
+	frameStats = TextStats {};
+}
+
+void TextRenderer::emit(SpriteBatch& batch, const Glyph& glyph, int x, int y, int scale, int layer) {
+	const SDL_Rect destination { x + glyph.x * scale, y + glyph.y * scale, FONT_GLYPH_WIDTH * scale, FONT_GLYPH_HEIGHT * scale };
+
+	batch.draw(*glyph.region, destination, layer);
+	++frameStats.glyphs;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+#include "SDLHandles.h"
+#include "TextureAtlas.h"
+
+class SpriteBatch;
+
+// Glyph size in font pixels, and how far apart characters and lines are
+const auto FONT_GLYPH_WIDTH = 5;
+const auto FONT_GLYPH_HEIGHT = 7;
+const auto FONT_ADVANCE = 6;
+const auto FONT_LINE_HEIGHT = 9;
+
+/** Class: BitmapFont
+ *
+ *  Description:
+ *  A fixed-width 5x7 font covering printable ASCII, built into the program so there's always text
+ *  available without loading anything. create() rasterizes every glyph once into a small atlas
+ *  texture, once per color in the palette it's given, so text of every color comes from the same
+ *  texture and a whole screen of it can go out in a single batched draw call. Characters outside
+ *  printable ASCII are drawn as '?'.
+ *
+ */
+
+class BitmapFont {
+public:
+	static std::unique_ptr<BitmapFont> create(SDL_Renderer *renderer, const std::vector<SDL_Color>& palette);
+
+	BitmapFont(const BitmapFont&) = delete;
+	BitmapFont& operator=(const BitmapFont&) = delete;
+
+	const AtlasRegion& glyph(char character, std::size_t color) const;
+	std::size_t colors() const { return colorCount; }
+
+private:
+	BitmapFont() = default;
+
+	TexturePtr texture;
+	std::vector<AtlasRegion> glyphs;
+	std::size_t colorCount = 0;
+};
+
+struct TextStats {
+	std::size_t glyphs = 0;
+	std::size_t cacheHits = 0;
+	std::size_t cacheMisses = 0;
+	std::size_t cachedRuns = 0;
+};
+
+/** Class: TextRenderer
+ *
+ *  Description:
+ *  Lays text out in a BitmapFont and queues one sprite per visible glyph on a batch. Strings drawn
+ *  with draw() are cached as runs (the glyphs and their offsets, already laid out), so labels and
+ *  other text that stays the same between frames only pay for lookup; runs that haven't been drawn
+ *  for a while are dropped by endFrame(). Text that changes every frame, like counters, should use
+ *  drawUncached() so it doesn't fill the cache with strings that never come back.
+ *
+ *  Both return the rectangle the text covers. '\n' starts a new line. The font must outlive the
+ *  TextRenderer.
+ *
+ */
+
+class TextRenderer {
+public:
+	explicit TextRenderer(const BitmapFont& font);
+	TextRenderer(const TextRenderer&) = delete;
+	TextRenderer& operator=(const TextRenderer&) = delete;
+
+	SDL_Rect draw(SpriteBatch& batch, const std::string& text, int x, int y, std::size_t color = 0, int scale = 1, int layer = 0);
+	SDL_Rect drawUncached(SpriteBatch& batch, const char *text, int x, int y, std::size_t color = 0, int scale = 1, int layer = 0);
+
+	void endFrame();
+
+	// Counts for the frame before the last endFrame()
+	const TextStats& stats() const { return lastStats; }
+
+private:
+	struct Glyph {
+		const AtlasRegion *region;
+		int x;
+		int y;
+	};
+
+	struct Run {
+		std::vector<Glyph> glyphs;
+		int width = 0;
+		int height = 0;
+		Uint64 lastDrawn = 0;
+	};
+
+	template <typename Emit>
+	void layout(const char *text, std::size_t color, Emit emit, int& width, int& height) const;
+
+	void emit(SpriteBatch& batch, const Glyph& glyph, int x, int y, int scale, int layer);
+
+	const BitmapFont& font;
+	std::vector<std::unordered_map<std::string, Run>> runs;
+	Uint64 frame = 0;
+	TextStats frameStats;
+	TextStats lastStats;
+};
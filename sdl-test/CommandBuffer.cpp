@@ -0,0 +1,174 @@
+#include "CommandBuffer.h"
+
+#include "Profiler.h"
+#include "RenderStats.h"
+#include "TileRasterizer.h"
+
+CommandBuffer::CommandBuffer() {
+	attachToArena(commands, frameArena, 0);
+	attachToArena(callbacks, frameArena, 0);
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	attachToArena(vertices, frameArena, 0);
+#endif
+}
+
+CommandBuffer::~CommandBuffer() {
+	destroyCallbacks();
+}
+
+void CommandBuffer::destroyCallbacks() {
+	for (const auto& callback : callbacks) {
+		callback.destroy(callback.function);
+	}
+}
+
+void CommandBuffer::reset() {
+	destroyCallbacks();
+
+	// Start the next frame with room for as much as this one used
+	const auto commandCount = detachFromArena(commands);
+	const auto callbackCount = detachFromArena(callbacks);
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	const auto vertexCount = detachFromArena(vertices);
+#endif
+
+	frameArena.reset();
+
+	attachToArena(commands, frameArena, commandCount);
+	attachToArena(callbacks, frameArena, callbackCount);
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	attachToArena(vertices, frameArena, vertexCount);
+#endif
+}
+
+RenderCommand& CommandBuffer::append(RenderCommandType type) {
+	commands.push_back(RenderCommand { type, false, false, SDL_Color {}, nullptr, SDL_Rect {}, SDL_Rect {}, 0, 0 });
+	return commands.back();
+}
+
+void CommandBuffer::setDrawColor(Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+	append(RenderCommandType::SetDrawColor).color = SDL_Color { r, g, b, a };
+}
+
+void CommandBuffer::clear() {
+	append(RenderCommandType::Clear);
+}
+
+void CommandBuffer::copy(SDL_Texture *texture, const SDL_Rect *source, const SDL_Rect *destination) {
+	auto& command = append(RenderCommandType::Copy);
+
+	command.texture = texture;
+	command.hasSource = (source != nullptr);
+	command.hasDestination = (destination != nullptr);
+
+	if (source) {
+		command.source = *source;
+	}
+
+	if (destination) {
+		command.destination = *destination;
+	}
+}
+
+void CommandBuffer::present() {
+	append(RenderCommandType::Present);
+}
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+
+void CommandBuffer::drawQuads(SDL_Texture *texture, const SDL_Vertex *quadVertices, std::size_t vertexCount) {
+	auto& command = append(RenderCommandType::Geometry);
+
+	command.texture = texture;
+	command.first = vertices.size();
+	command.count = vertexCount;
+
+	vertices.insert(vertices.end(), quadVertices, quadVertices + vertexCount);
+}
+
+#endif
+
+bool CommandBuffer::rasterize(TileRasterizer& rasterizer, const RenderCommand& command) {
+	switch (command.type) {
+		case RenderCommandType::Copy:
+			return rasterizer.copy(command.texture, command.hasSource ? &command.source : NULL, command.hasDestination ? &command.destination : NULL);
+
+		case RenderCommandType::Geometry:
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+			return rasterizer.drawQuads(command.texture, vertices.data() + command.first, command.count);
+#else
+			return false;
+#endif
+
+		default:
+			// Anything else has to happen after the sprites queued before it are on the target
+			rasterizer.flush();
+			return false;
+	}
+}
+
+void CommandBuffer::execute(SDL_Renderer *renderer, TileRasterizer *rasterizer) {
+	PROFILE_SCOPE("CommandBuffer::execute");
+
+	auto& stats = RenderStats::instance();
+
+	for (const auto& command : commands) {
+		if (rasterizer && rasterize(*rasterizer, command)) {
+			continue;
+		}
+
+		switch (command.type) {
+			case RenderCommandType::SetDrawColor:
+				SDL_SetRenderDrawColor(renderer, command.color.r, command.color.g, command.color.b, command.color.a);
+				break;
+
+			case RenderCommandType::Clear:
+				SDL_RenderClear(renderer);
+				break;
+
+			case RenderCommandType::Copy:
+				SDL_RenderCopy(renderer, command.texture, command.hasSource ? &command.source : NULL, command.hasDestination ? &command.destination : NULL);
+				stats.countDraw(command.texture, 4);
+				break;
+
+			case RenderCommandType::Geometry:
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+				{
+					const auto quads = command.count / 4;
+
+					// Same index pattern for every quad, so it only ever grows
+					for (auto quad = quadIndices.size() / 6; quad < quads; ++quad) {
+						const auto base = static_cast<int>(quad * 4);
+						const int pattern[] = { base, base + 1, base + 2, base + 2, base + 3, base };
+
+						quadIndices.insert(quadIndices.end(), pattern, pattern + 6);
+					}
+
+					SDL_RenderGeometry(renderer, command.texture, vertices.data() + command.first, static_cast<int>(command.count),
+						quadIndices.data(), static_cast<int>(quads * 6));
+					stats.countDraw(command.texture, command.count);
+				}
+#endif
+				break;
+
+			case RenderCommandType::Call:
+				callbacks[command.first].invoke(callbacks[command.first].function, renderer);
+				break;
+
+			case RenderCommandType::Present:
+				{
+					PROFILE_SCOPE("SDL_RenderPresent");
+					SDL_RenderPresent(renderer);
+				}
+				break;
+		}
+	}
+
+	// Sprites queued at the very end still have to reach the target
+	if (rasterizer) {
+		rasterizer->flush();
+	}
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+#include "FrameArena.h"
+
+class TileRasterizer;
+
+enum class RenderCommandType : Uint8 {
+	SetDrawColor,
+	Clear,
+	Copy,
+	Geometry,
+	Call,
+	Present
+};
+
+/** Struct: RenderCommand
+ *
+ *  Description:
+ *  One recorded renderer call. Only the fields its type uses mean anything: Copy uses the texture
+ *  and rectangles, Geometry the texture and a range of the buffer's vertices, SetDrawColor the
+ *  color, and Call an index into the buffer's callbacks.
+ *
+ */
+
+struct RenderCommand {
+	RenderCommandType type;
+	bool hasSource;
+	bool hasDestination;
+	SDL_Color color;
+	SDL_Texture *texture;
+	SDL_Rect source;
+	SDL_Rect destination;
+	std::size_t first;
+	std::size_t count;
+};
+
+/** Class: CommandBuffer
+ *
+ *  Description:
+ *  A list of renderer calls recorded on one thread to be executed later, in the same order, on
+ *  whichever thread owns the renderer. Recording never touches the renderer, so the simulation
+ *  can record frame N + 1 while the render thread is still executing frame N.
+ *
+ *  Anything that isn't a plain draw (uploading textures, redrawing a render target, drawing an
+ *  overlay) is recorded as a callback, which is run with the renderer at that point in the list.
+ *  Callbacks are any callable taking the renderer; they're moved into the buffer and destroyed when
+ *  it's reset.
+ *
+ *  Textures referenced by recorded commands have to survive until the buffer is executed.
+ *  Commands, vertices and callbacks all live in the buffer's own frame arena, which reset() clears
+ *  in one go, so once the arena has grown to the size of a typical frame, recording allocates
+ *  nothing at all.
+ *
+ */
+
+class CommandBuffer {
+public:
+	CommandBuffer();
+	CommandBuffer(const CommandBuffer&) = delete;
+	CommandBuffer& operator=(const CommandBuffer&) = delete;
+	~CommandBuffer();
+
+	// Drops everything recorded so far, keeping the memory for the next frame
+	void reset();
+
+	void setDrawColor(Uint8 r, Uint8 g, Uint8 b, Uint8 a);
+	void clear();
+	void copy(SDL_Texture *texture, const SDL_Rect *source, const SDL_Rect *destination);
+	template <typename Function>
+	void call(Function function);
+	void present();
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	// Quads of four vertices each, drawn as two triangles apiece in a single SDL_RenderGeometry
+	void drawQuads(SDL_Texture *texture, const SDL_Vertex *quadVertices, std::size_t vertexCount);
+#endif
+
+	// With a rasterizer, copies and quads are drawn on the CPU (see TileRasterizer) unless it turns them down
+	void execute(SDL_Renderer *renderer, TileRasterizer *rasterizer = nullptr);
+
+	std::size_t size() const { return commands.size(); }
+	bool empty() const { return commands.empty(); }
+
+	// What's been recorded, for looking at a frame without executing it (frame capture, for one)
+	const ArenaVector<RenderCommand>& recorded() const { return commands; }
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	const ArenaVector<SDL_Vertex>& recordedVertices() const { return vertices; }
+#endif
+
+	// Space for anything else that has to live exactly as long as this frame's commands
+	FrameArena& arena() { return frameArena; }
+
+private:
+	// A callable stored in the arena, with what's needed to call and destroy it without its type
+	struct Callback {
+		void *function;
+		void (*invoke)(void *function, SDL_Renderer *renderer);
+		void (*destroy)(void *function);
+	};
+
+	RenderCommand& append(RenderCommandType type);
+	bool rasterize(TileRasterizer& rasterizer, const RenderCommand& command);
+	void destroyCallbacks();
+
+	FrameArena frameArena;
+	ArenaVector<RenderCommand> commands;
+	ArenaVector<Callback> callbacks;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	ArenaVector<SDL_Vertex> vertices;
+
+	// Not per frame: the same pattern serves every frame, so it lives on the heap and only grows
+	std::vector<int> quadIndices;
+#endif
+};
+
+template <typename Function>
+void CommandBuffer::call(Function function) {
+	auto *stored = new (frameArena.allocate(sizeof(Function), alignof(Function))) Function(std::move(function));
+
+	const Callback callback {
+		stored,
+		[](void *f, SDL_Renderer *renderer) { (*static_cast<Function*>(f))(renderer); },
+		[](void *f) { static_cast<Function*>(f)->~Function(); }
+	};
+
+	append(RenderCommandType::Call).first = callbacks.size();
+	callbacks.push_back(callback);
+}
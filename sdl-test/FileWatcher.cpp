@@ -0,0 +1,80 @@
+#include "FileWatcher.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+FileStamp fileStamp(const std::string& path) {
+	FileStamp stamp;
+
+#ifdef _WIN32
+	struct _stat64 status;
+
+	if (_stat64(path.c_str(), &status) == 0) {
+#else
+	struct stat status;
+
+	if (stat(path.c_str(), &status) == 0) {
+#endif
+		stamp.modified = static_cast<long long>(status.st_mtime);
+		stamp.size = static_cast<long long>(status.st_size);
+	}
+
+	return stamp;
+}
+
+FileWatcher::FileWatcher(Uint32 intervalMilliseconds)
+	: interval(std::max(intervalMilliseconds, 1u)), thread(&FileWatcher::watcherMain, this) {
+}
+
+FileWatcher::~FileWatcher() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	wake.notify_all();
+	thread.join();
+}
+
+void FileWatcher::watch(const std::string& path) {
+	const auto stamp = fileStamp(path);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	const auto watched = std::find_if(files.begin(), files.end(), [&](const WatchedFile& file) { return file.path == path; });
+
+	if (watched == files.end()) {
+		files.push_back(WatchedFile { path, stamp, stamp });
+	}
+}
+
+void FileWatcher::takeChanges(std::vector<std::string>& changed) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	changed.insert(changed.end(), changes.begin(), changes.end());
+	changes.clear();
+}
+
+void FileWatcher::watcherMain() {
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (!wake.wait_for(lock, std::chrono::milliseconds(interval), [this]() { return stopping; })) {
+		for (auto& file : files) {
+			const auto current = fileStamp(file.path);
+
+			// Wait for the file to stop changing, and to exist, before anyone reloads it
+			if ((current == file.settling) && (current != file.stamp) && current.exists()) {
+				file.stamp = current;
+
+				if (std::find(changes.begin(), changes.end(), file.path) == changes.end()) {
+					changes.push_back(file.path);
+				}
+			}
+
+			file.settling = current;
+		}
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+/** Struct: FileStamp
+ *
+ *  Description:
+ *  What a file looked like the last time we checked: its modification time and size. Either one
+ *  changing counts as the file having changed. A file that doesn't exist has no stamp.
+ *
+ */
+
+struct FileStamp {
+	long long modified = -1;
+	long long size = -1;
+
+	bool exists() const { return size >= 0; }
+
+	bool operator==(const FileStamp& other) const { return (modified == other.modified) && (size == other.size); }
+	bool operator!=(const FileStamp& other) const { return !(*this == other); }
+};
+
+FileStamp fileStamp(const std::string& path);
+
+/** Class: FileWatcher
+ *
+ *  Description:
+ *  Watches a set of files from a background thread and reports the ones that have changed. It
+ *  polls each file's stamp every interval instead of using the platform's change notifications,
+ *  which keeps it portable and is plenty quick for the handful of files an artist is working on.
+ *
+ *  A file is only reported once its stamp has held still for a whole interval, so a program that
+ *  saves in several writes (or deletes and renames) doesn't get it reloaded half written. Files
+ *  that have gone missing aren't reported until they come back.
+ *
+ *  watch() and takeChanges() may be called from any thread.
+ *
+ */
+
+class FileWatcher {
+public:
+	explicit FileWatcher(Uint32 intervalMilliseconds = 250);
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+	~FileWatcher();
+
+	void watch(const std::string& path);
+
+	// Appends every watched file that changed since the last call
+	void takeChanges(std::vector<std::string>& changed);
+
+private:
+	struct WatchedFile {
+		std::string path;
+		FileStamp stamp;
+		FileStamp settling;
+	};
+
+	void watcherMain();
+
+	const Uint32 interval;
+	std::vector<WatchedFile> files;
+	std::vector<std::string> changes;
+	bool stopping = false;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::thread thread;
+};
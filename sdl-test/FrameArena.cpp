@@ -0,0 +1,61 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+FrameArena::FrameArena(std::size_t initialBytes) {
+	addBlock(std::max(initialBytes, std::size_t { 256 }));
+}
+
+void FrameArena::addBlock(std::size_t bytes) {
+	blocks.push_back(Block { std::unique_ptr<unsigned char[]>(new unsigned char[bytes]), bytes });
+	offset = 0;
+}
+
+std::size_t FrameArena::capacity() const {
+	std::size_t total = 0;
+
+	for (const auto& block : blocks) {
+		total += block.size;
+	}
+
+	return total;
+}
+
+void *FrameArena::allocate(std::size_t bytes, std::size_t alignment) {
+	auto *block = &blocks.back();
+
+	auto address = reinterpret_cast<std::uintptr_t>(block->memory.get()) + offset;
+	auto padding = (alignment - address % alignment) % alignment;
+
+	if (offset + padding + bytes > block->size) {
+		// Out of room this frame; the next reset() folds this into one block
+		addBlock(std::max(block->size * 2, bytes + alignment));
+
+		block = &blocks.back();
+		address = reinterpret_cast<std::uintptr_t>(block->memory.get());
+		padding = (alignment - address % alignment) % alignment;
+	}
+
+	offset += padding;
+
+	auto *memory = block->memory.get() + offset;
+
+	offset += bytes;
+	usedBytes += padding + bytes;
+	peakBytes = std::max(peakBytes, usedBytes);
+
+	return memory;
+}
+
+void FrameArena::reset() {
+	if (blocks.size() > 1) {
+		const auto total = capacity();
+
+		blocks.clear();
+		addBlock(total);
+	}
+
+	offset = 0;
+	usedBytes = 0;
+}
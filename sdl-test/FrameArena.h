@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/** Class: FrameArena
+ *
+ *  Description:
+ *  A bump allocator for data that only lives for one frame. allocate() hands out the next piece of
+ *  a block and reset() takes everything back at once; nothing is freed individually. When a frame
+ *  needs more than the arena has, it chains on another block from the heap, and the next reset()
+ *  replaces the chain with a single block big enough for all of it, so after a few frames the
+ *  arena stops touching the heap at all.
+ *
+ *  Nothing allocated from the arena may be used after reset(), and destructors aren't run, so it's
+ *  meant for trivially destructible data or for owners that destroy their objects before resetting.
+ *
+ *  An arena is used by one thread at a time.
+ *
+ */
+
+class FrameArena {
+public:
+	explicit FrameArena(std::size_t initialBytes = 64 * 1024);
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	void *allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t));
+	void reset();
+
+	// Bytes handed out since the last reset, and the most any frame has used
+	std::size_t used() const { return usedBytes; }
+	std::size_t peak() const { return peakBytes; }
+	std::size_t capacity() const;
+
+private:
+	struct Block {
+		std::unique_ptr<unsigned char[]> memory;
+		std::size_t size;
+	};
+
+	void addBlock(std::size_t bytes);
+
+	std::vector<Block> blocks;
+	std::size_t offset = 0;
+	std::size_t usedBytes = 0;
+	std::size_t peakBytes = 0;
+};
+
+/** Class: ArenaAllocator
+ *
+ *  Description:
+ *  Lets standard containers allocate from a FrameArena. Deallocating is a no-op, since the arena
+ *  takes everything back on reset(); a container using one has to be emptied and given a fresh
+ *  allocator (see ArenaVector) before its arena is reset. A default-constructed allocator has no
+ *  arena and falls back to the heap, so the same container type works either way.
+ *
+ */
+
+template <typename T>
+class ArenaAllocator {
+public:
+	using value_type = T;
+
+	// Assigning a container also hands over its arena
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	ArenaAllocator() noexcept = default;
+	explicit ArenaAllocator(FrameArena *arena) noexcept : arena(arena) {}
+
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.arena) {}
+
+	T *allocate(std::size_t count) {
+		if (arena) {
+			return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+		}
+
+		return static_cast<T*>(::operator new(count * sizeof(T)));
+	}
+
+	void deallocate(T *pointer, std::size_t) noexcept {
+		if (!arena) {
+			::operator delete(pointer);
+		}
+	}
+
+	FrameArena *arena = nullptr;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+	return a.arena == b.arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+	return a.arena != b.arena;
+}
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+/** Functions: detachFromArena, attachToArena
+ *
+ *  Description:
+ *  How an owner resets an arena its vectors live on: detach every vector (which parks it on the
+ *  heap and returns how many elements it held), reset the arena, then attach each vector again
+ *  with room for that many elements, so it doesn't have to grow its way back up every frame.
+ *  Nothing is left pointing into the arena while it resets, including the bookkeeping some debug
+ *  runtimes allocate alongside every container.
+ *
+ */
+
+template <typename T>
+std::size_t detachFromArena(ArenaVector<T>& vector) {
+	const auto size = vector.size();
+	vector = ArenaVector<T>();
+	return size;
+}
+
+template <typename T>
+void attachToArena(ArenaVector<T>& vector, FrameArena& arena, std::size_t capacity) {
+	vector = ArenaVector<T>(ArenaAllocator<T>(&arena));
+	vector.reserve(capacity);
+}
@@ -0,0 +1,369 @@
+#include "FrameCapture.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "Log.h"
+#include "Profiler.h"
+#include "TexturePack.h"
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+static_assert(sizeof(CaptureVertex) == sizeof(SDL_Vertex), "CaptureVertex has to match SDL_Vertex");
+#endif
+
+std::unique_ptr<FrameCapture> FrameCapture::create(const std::string& path, int width, int height) {
+	std::unique_ptr<FrameCapture> capture(new FrameCapture());
+	capture->path = path;
+	capture->file = std::fopen(path.c_str(), "wb");
+
+	if (!capture->file) {
+		std::cerr << "FrameCapture " << path << " error: could not open for writing\n";
+		return nullptr;
+	}
+
+	const CaptureHeader header { CAPTURE_MAGIC, CAPTURE_VERSION, static_cast<Uint32>(width), static_cast<Uint32>(height) };
+
+	if (!capture->write(&header, sizeof(header))) {
+		return nullptr;
+	}
+
+	return capture;
+}
+
+FrameCapture::~FrameCapture() {
+	if (file && (std::fclose(file) != 0)) {
+		std::cerr << "FrameCapture " << path << " error: could not finish writing\n";
+	}
+}
+
+bool FrameCapture::write(const void *data, std::size_t size) {
+	if (!file) {
+		return false;
+	}
+
+	if (std::fwrite(data, 1, size, file) != size) {
+		std::cerr << "FrameCapture " << path << " error: could not write, capture stopped after " << frames << " frames\n";
+
+		std::fclose(file);
+		file = nullptr;
+		return false;
+	}
+
+	return true;
+}
+
+Uint32 FrameCapture::textureId(SDL_Texture *texture) {
+	auto found = textures.find(texture);
+
+	if ((found != textures.end()) && (found->second.checkedFrame == frames)) {
+		return found->second.id;
+	}
+
+	TextureState current {};
+	current.checkedFrame = frames;
+
+	if ((SDL_QueryTexture(texture, &current.format, &current.access, &current.width, &current.height) != 0)
+		|| (SDL_GetTextureBlendMode(texture, &current.blendMode) != 0)) {
+		// Drawing with it would have failed the same way, so replay it as drawing nothing
+		return 0;
+	}
+
+	if (found != textures.end()) {
+		auto& known = found->second;
+		known.checkedFrame = frames;
+
+		if ((known.format == current.format) && (known.access == current.access) && (known.width == current.width)
+			&& (known.height == current.height) && (known.blendMode == current.blendMode)) {
+			return known.id;
+		}
+
+		// Changed, or a new texture where an old one used to be; either way it keeps its id
+		current.id = known.id;
+		known = current;
+	} else {
+		current.id = nextTextureId++;
+		textures.emplace(texture, current);
+	}
+
+	const CaptureTexture record {
+		static_cast<Uint32>(CaptureRecordType::Texture),
+		current.id,
+		current.format,
+		current.access,
+		current.width,
+		current.height,
+		static_cast<Uint32>(current.blendMode),
+		0
+	};
+
+	write(&record, sizeof(record));
+	return current.id;
+}
+
+void FrameCapture::record(const CommandBuffer& commands) {
+	PROFILE_SCOPE("FrameCapture::record");
+
+	pendingCommands.clear();
+	pendingVertices.clear();
+
+	if (!file) {
+		return;
+	}
+
+	for (const auto& command : commands.recorded()) {
+		CaptureCommand captured {};
+
+		captured.type = static_cast<Uint8>(command.type);
+		captured.hasSource = command.hasSource ? 1 : 0;
+		captured.hasDestination = command.hasDestination ? 1 : 0;
+		captured.color = command.color;
+		captured.texture = command.texture ? textureId(command.texture) : 0;
+		captured.source = command.source;
+		captured.destination = command.destination;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+		if (command.type == RenderCommandType::Geometry) {
+			const auto& vertices = commands.recordedVertices();
+
+			captured.first = static_cast<Uint32>(pendingVertices.size());
+			captured.count = static_cast<Uint32>(command.count);
+
+			for (auto i = command.first; i < command.first + command.count; ++i) {
+				const auto& vertex = vertices[i];
+				pendingVertices.push_back(CaptureVertex { vertex.position.x, vertex.position.y, vertex.color, vertex.tex_coord.x, vertex.tex_coord.y });
+			}
+		}
+#endif
+
+		pendingCommands.push_back(captured);
+	}
+}
+
+void FrameCapture::finishFrame(double executeMilliseconds) {
+	const CaptureFrame record {
+		static_cast<Uint32>(CaptureRecordType::Frame),
+		static_cast<Uint32>(pendingCommands.size()),
+		static_cast<Uint32>(pendingVertices.size()),
+		static_cast<Uint32>(executeMilliseconds * 1000.0 + 0.5)
+	};
+
+	const auto written = write(&record, sizeof(record))
+		&& (pendingCommands.empty() || write(pendingCommands.data(), pendingCommands.size() * sizeof(CaptureCommand)))
+		&& (pendingVertices.empty() || write(pendingVertices.data(), pendingVertices.size() * sizeof(CaptureVertex)));
+
+	if (written) {
+		++frames;
+	}
+}
+
+std::unique_ptr<CaptureReplay> CaptureReplay::open(const std::string& path) {
+	const auto file = MappedFile::open(path);
+
+	if (!file) {
+		std::cerr << "CaptureReplay " << path << " error: could not open\n";
+		return nullptr;
+	}
+
+	const auto *data = file->data();
+	const auto size = file->size();
+
+	std::unique_ptr<CaptureReplay> capture(new CaptureReplay());
+
+	if (size < sizeof(CaptureHeader)) {
+		std::cerr << "CaptureReplay " << path << " error: truncated header\n";
+		return nullptr;
+	}
+
+	std::memcpy(&capture->header, data, sizeof(CaptureHeader));
+
+	if ((capture->header.magic != CAPTURE_MAGIC) || (capture->header.version != CAPTURE_VERSION)) {
+		std::cerr << "CaptureReplay " << path << " error: not a version " << CAPTURE_VERSION << " frame capture\n";
+		return nullptr;
+	}
+
+	if ((capture->header.width == 0) || (capture->header.height == 0)) {
+		std::cerr << "CaptureReplay " << path << " error: corrupt header\n";
+		return nullptr;
+	}
+
+	// Which texture record each id refers to at the current point of the file
+	std::unordered_map<Uint32, std::size_t> textureRecords;
+	std::size_t offset = sizeof(CaptureHeader);
+
+	while (offset < size) {
+		Uint32 type = 0;
+
+		if (size - offset < sizeof(type)) {
+			std::cerr << "CaptureReplay " << path << " error: truncated record at " << offset << '\n';
+			return nullptr;
+		}
+
+		std::memcpy(&type, data + offset, sizeof(type));
+
+		if (type == static_cast<Uint32>(CaptureRecordType::Texture)) {
+			CaptureTexture texture;
+
+			if (size - offset < sizeof(texture)) {
+				std::cerr << "CaptureReplay " << path << " error: truncated texture at " << offset << '\n';
+				return nullptr;
+			}
+
+			std::memcpy(&texture, data + offset, sizeof(texture));
+			offset += sizeof(texture);
+
+			if ((texture.id == 0) || (texture.width <= 0) || (texture.height <= 0)) {
+				std::cerr << "CaptureReplay " << path << " error: texture " << texture.id << " is corrupt\n";
+				return nullptr;
+			}
+
+			textureRecords[texture.id] = capture->textures.size();
+			capture->textures.push_back(texture);
+		} else if (type == static_cast<Uint32>(CaptureRecordType::Frame)) {
+			CaptureFrame frame;
+
+			if (size - offset < sizeof(frame)) {
+				std::cerr << "CaptureReplay " << path << " error: truncated frame at " << offset << '\n';
+				return nullptr;
+			}
+
+			std::memcpy(&frame, data + offset, sizeof(frame));
+			offset += sizeof(frame);
+
+			const auto commandBytes = static_cast<Uint64>(frame.commandCount) * sizeof(CaptureCommand);
+			const auto vertexBytes = static_cast<Uint64>(frame.vertexCount) * sizeof(CaptureVertex);
+
+			if (commandBytes + vertexBytes > size - offset) {
+				std::cerr << "CaptureReplay " << path << " error: frame " << capture->frames.size() << " is truncated\n";
+				return nullptr;
+			}
+
+			const auto firstCommand = capture->capturedCommands.size();
+			capture->capturedCommands.resize(firstCommand + frame.commandCount);
+
+			if (frame.commandCount > 0) {
+				std::memcpy(&capture->capturedCommands[firstCommand], data + offset, static_cast<std::size_t>(commandBytes));
+			}
+
+			offset += static_cast<std::size_t>(commandBytes);
+
+			for (auto i = firstCommand; i < capture->capturedCommands.size(); ++i) {
+				auto& command = capture->capturedCommands[i];
+				const auto known = textureRecords.find(command.texture);
+
+				const auto corrupt = (command.type > static_cast<Uint8>(RenderCommandType::Present))
+					|| ((command.texture != 0) && (known == textureRecords.end()))
+					|| ((command.type == static_cast<Uint8>(RenderCommandType::Geometry))
+						&& ((command.count % 4 != 0) || (command.first > frame.vertexCount) || (command.count > frame.vertexCount - command.first)));
+
+				if (corrupt) {
+					std::cerr << "CaptureReplay " << path << " error: frame " << capture->frames.size() << " has a corrupt command\n";
+					return nullptr;
+				}
+
+				if (command.texture != 0) {
+					command.texture = static_cast<Uint32>(known->second + 1);
+				}
+			}
+
+			Frame indexed { firstCommand, frame.commandCount, 0, frame.executeMicroseconds };
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+			indexed.firstVertex = capture->vertices.size();
+			capture->vertices.resize(indexed.firstVertex + frame.vertexCount);
+
+			if (frame.vertexCount > 0) {
+				std::memcpy(&capture->vertices[indexed.firstVertex], data + offset, static_cast<std::size_t>(vertexBytes));
+			}
+#endif
+
+			offset += static_cast<std::size_t>(vertexBytes);
+			capture->frames.push_back(indexed);
+		} else {
+			std::cerr << "CaptureReplay " << path << " error: unknown record at " << offset << '\n';
+			return nullptr;
+		}
+	}
+
+	return capture;
+}
+
+bool CaptureReplay::createTextures(SDL_Renderer *renderer, std::vector<TexturePtr>& placeholders) const {
+	PROFILE_SCOPE("CaptureReplay::createTextures");
+
+	placeholders.clear();
+	std::vector<Uint32> pixels;
+
+	for (std::size_t i = 0; i < textures.size(); ++i) {
+		const auto& texture = textures[i];
+
+		// Whatever format it had, ARGB8888 is the one every renderer can take
+		TexturePtr placeholder(SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, texture.width, texture.height));
+
+		if (!placeholder) {
+			LogSDLError(std::cerr, "CreateTexture");
+			return false;
+		}
+
+		// A solid color per texture with a one pixel border, so replayed frames can be told apart by eye
+		const auto width = static_cast<std::size_t>(texture.width);
+		const auto height = static_cast<std::size_t>(texture.height);
+		const auto fill = 0xFF404040 | (static_cast<Uint32>((i + 1) * 2654435761u) & 0x00FFFFFF);
+
+		pixels.assign(width * height, fill);
+
+		for (std::size_t x = 0; x < width; ++x) {
+			pixels[x] = pixels[(height - 1) * width + x] = 0xFF000000;
+		}
+
+		for (std::size_t y = 0; y < height; ++y) {
+			pixels[y * width] = pixels[y * width + width - 1] = 0xFF000000;
+		}
+
+		if (SDL_UpdateTexture(placeholder.get(), NULL, pixels.data(), static_cast<int>(width * sizeof(Uint32)))) {
+			LogSDLError(std::cerr, "UpdateTexture");
+			return false;
+		}
+
+		SDL_SetTextureBlendMode(placeholder.get(), static_cast<SDL_BlendMode>(texture.blendMode));
+		placeholders.push_back(std::move(placeholder));
+	}
+
+	return true;
+}
+
+void CaptureReplay::replay(std::size_t frame, const std::vector<TexturePtr>& placeholders, CommandBuffer& commands) const {
+	const auto& indexed = frames[frame];
+
+	for (auto i = indexed.firstCommand; i < indexed.firstCommand + indexed.commandCount; ++i) {
+		const auto& command = capturedCommands[i];
+		auto *texture = (command.texture != 0) ? placeholders[command.texture - 1].get() : nullptr;
+
+		switch (static_cast<RenderCommandType>(command.type)) {
+			case RenderCommandType::SetDrawColor:
+				commands.setDrawColor(command.color.r, command.color.g, command.color.b, command.color.a);
+				break;
+
+			case RenderCommandType::Clear:
+				commands.clear();
+				break;
+
+			case RenderCommandType::Copy:
+				commands.copy(texture, command.hasSource ? &command.source : nullptr, command.hasDestination ? &command.destination : nullptr);
+				break;
+
+			case RenderCommandType::Geometry:
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+				commands.drawQuads(texture, vertices.data() + indexed.firstVertex + command.first, command.count);
+#endif
+				break;
+
+			case RenderCommandType::Call:
+				// Whatever it did wasn't captured
+				break;
+
+			case RenderCommandType::Present:
+				commands.present();
+				break;
+		}
+	}
+}
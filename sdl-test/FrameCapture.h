@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+#include "CommandBuffer.h"
+#include "SDLHandles.h"
+
+/** Capture file layout
+ *
+ *  Description:
+ *  A capture is a header followed by a stream of records, each starting with its CaptureRecordType.
+ *  A texture record describes a texture the first time a frame draws with it, and again whenever
+ *  its size, format or blend mode has changed since it was last described. A frame record holds one
+ *  executed command buffer: its commands, then its vertices. Textures are referred to by the id of
+ *  their texture record, 0 meaning no texture. All fields are little-endian.
+ *
+ *  Only what a texture looks like to the renderer is recorded, not its pixels; replay draws with
+ *  placeholders of the same size and blend mode, which cost the renderer about the same to draw.
+ *
+ */
+
+const Uint32 CAPTURE_MAGIC = 0x50414346; // "FCAP"
+const Uint32 CAPTURE_VERSION = 1;
+
+enum class CaptureRecordType : Uint32 {
+	Texture = 1,
+	Frame = 2
+};
+
+struct CaptureHeader {
+	Uint32 magic;
+	Uint32 version;
+	Uint32 width;
+	Uint32 height;
+};
+
+struct CaptureTexture {
+	Uint32 type;
+	Uint32 id;
+	Uint32 format;
+	Sint32 access;
+	Sint32 width;
+	Sint32 height;
+	Uint32 blendMode;
+	Uint32 reserved;
+};
+
+struct CaptureFrame {
+	Uint32 type;
+	Uint32 commandCount;
+	Uint32 vertexCount;
+
+	// How long the render thread took to execute the buffer when it was captured, present included
+	Uint32 executeMicroseconds;
+};
+
+// A RenderCommand with the texture replaced by its id; callbacks are kept only as markers
+struct CaptureCommand {
+	Uint8 type;
+	Uint8 hasSource;
+	Uint8 hasDestination;
+	Uint8 reserved;
+	SDL_Color color;
+	Uint32 texture;
+	Uint32 first;
+	Uint32 count;
+	SDL_Rect source;
+	SDL_Rect destination;
+};
+
+// Laid out exactly like SDL_Vertex, but doesn't need SDL 2.0.18 to be read
+struct CaptureVertex {
+	float x;
+	float y;
+	SDL_Color color;
+	float u;
+	float v;
+};
+
+/** Class: FrameCapture
+ *
+ *  Description:
+ *  Writes every command buffer it's given to a capture file, so a slow frame seen on someone's
+ *  machine can be replayed on another, against any renderer, as often as needed. The render thread
+ *  calls record() just before it executes a buffer, while every texture the buffer draws with is
+ *  still alive, and finishFrame() just after, with how long executing it took.
+ *
+ *  Callbacks can't be written out, so a replay only redraws the commands recorded directly (the
+ *  sprite batches and anything else drawn through the buffer); whatever callbacks drew, including
+ *  switching render targets, is missing from it.
+ *
+ *  Frames are written as they come, to a buffered file, so the cost on the render thread is a copy
+ *  of the frame's commands; the file is complete as soon as the capture is destroyed.
+ *
+ */
+
+class FrameCapture {
+public:
+	static std::unique_ptr<FrameCapture> create(const std::string& path, int width, int height);
+
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+	~FrameCapture();
+
+	void record(const CommandBuffer& commands);
+	void finishFrame(double executeMilliseconds);
+
+	std::size_t frameCount() const { return frames; }
+
+	// False once a write has failed; nothing more is written after that
+	bool ok() const { return file != nullptr; }
+
+private:
+	struct TextureState {
+		Uint32 id;
+		Uint32 format;
+		int access;
+		int width;
+		int height;
+		SDL_BlendMode blendMode;
+
+		// The last frame it was checked for changes, so that's done once per frame at most
+		std::size_t checkedFrame;
+	};
+
+	FrameCapture() = default;
+
+	Uint32 textureId(SDL_Texture *texture);
+	bool write(const void *data, std::size_t size);
+
+	std::string path;
+	std::FILE *file = nullptr;
+	std::size_t frames = 0;
+	Uint32 nextTextureId = 1;
+
+	std::unordered_map<SDL_Texture*, TextureState> textures;
+
+	std::vector<CaptureCommand> pendingCommands;
+	std::vector<CaptureVertex> pendingVertices;
+};
+
+/** Class: CaptureReplay
+ *
+ *  Description:
+ *  A capture file read back for replaying. open() reads the whole file and checks it, resolving
+ *  every texture id to the texture record in force at that point of the capture, so afterwards any
+ *  frame can be replayed in any order and as many times as needed. createTextures() makes the
+ *  placeholders on the renderer to replay on, owned by the caller so they go before the renderer
+ *  does; replay() then records a captured frame drawing with them into a command buffer, which is
+ *  executed just like the original was.
+ *
+ *  Running a capture made with an SDL that has SDL_RenderGeometry on one without it skips its
+ *  geometry draws.
+ *
+ */
+
+class CaptureReplay {
+public:
+	static std::unique_ptr<CaptureReplay> open(const std::string& path);
+
+	CaptureReplay(const CaptureReplay&) = delete;
+	CaptureReplay& operator=(const CaptureReplay&) = delete;
+
+	int width() const { return static_cast<int>(header.width); }
+	int height() const { return static_cast<int>(header.height); }
+	std::size_t frameCount() const { return frames.size(); }
+	std::size_t textureCount() const { return textures.size(); }
+
+	// Milliseconds the frame took to execute when it was captured
+	double capturedMilliseconds(std::size_t frame) const { return frames[frame].executeMicroseconds / 1000.0; }
+
+	bool createTextures(SDL_Renderer *renderer, std::vector<TexturePtr>& placeholders) const;
+	void replay(std::size_t frame, const std::vector<TexturePtr>& placeholders, CommandBuffer& commands) const;
+
+private:
+	struct Frame {
+		std::size_t firstCommand;
+		std::size_t commandCount;
+		std::size_t firstVertex;
+		Uint32 executeMicroseconds;
+	};
+
+	CaptureReplay() = default;
+
+	CaptureHeader header {};
+	std::vector<CaptureTexture> textures;
+	std::vector<Frame> frames;
+
+	// Texture fields here are indices into textures plus one, rather than ids
+	std::vector<CaptureCommand> capturedCommands;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	std::vector<SDL_Vertex> vertices;
+#endif
+};
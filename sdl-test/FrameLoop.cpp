@@ -0,0 +1,115 @@
+#include "FrameLoop.h"
+
+#include <algorithm>
+
+#include "Input.h"
+#include "Profiler.h"
+
+namespace {
+	// A long stall (debugger, window drag) shouldn't turn into seconds of catch-up simulation
+	const auto MAX_FRAME_SECONDS = 0.25;
+}
+
+FrameLoop::FrameLoop(const FrameLoopConfig& config)
+	: config(config),
+	  simulationStep(1.0 / std::max(config.simulationHz, 1.0)),
+	  secondsPerTick(1.0 / SDL_GetPerformanceFrequency()),
+	  framePeriod(static_cast<Uint64>(SDL_GetPerformanceFrequency() / std::max(config.targetFps, 1.0))) {
+}
+
+Uint32 FrameLoop::rendererFlags(const FrameLoopConfig& config) {
+	return (config.mode == PacingMode::VSync) ? SDL_RENDERER_PRESENTVSYNC : 0;
+}
+
+void FrameLoop::beginFrame(const InputSnapshot& input) {
+	targetsLost = input.renderTargetsLost;
+
+	if (input.quitRequested || input.keyPressed(SDL_SCANCODE_ESCAPE)) {
+		quitRequested = true;
+	}
+
+	const auto now = SDL_GetPerformanceCounter();
+
+	if (frameStart != 0) {
+		const auto elapsed = (now - frameStart) * secondsPerTick;
+
+		lastFrameMs = elapsed * 1000.0;
+		accumulator += std::min(elapsed, MAX_FRAME_SECONDS);
+	} else {
+		nextDeadline = now;
+	}
+
+	frameStart = now;
+	stepsThisFrame = 0;
+}
+
+bool FrameLoop::step() {
+	if (accumulator < simulationStep) {
+		return false;
+	}
+
+	if (stepsThisFrame == config.maxStepsPerFrame) {
+		// Too far behind to catch up; drop the backlog rather than spiral
+		accumulator = 0.0;
+		return false;
+	}
+
+	accumulator -= simulationStep;
+	++stepsThisFrame;
+
+	return true;
+}
+
+void FrameLoop::endFrame() {
+	++frames;
+
+	if (config.mode != PacingMode::TargetFps) {
+		return;
+	}
+
+	nextDeadline += framePeriod;
+
+	const auto now = SDL_GetPerformanceCounter();
+
+	// A frame that overran by more than a whole period starts a new schedule instead of rushing the next few
+	if (now > nextDeadline + framePeriod) {
+		nextDeadline = now;
+		return;
+	}
+
+	waitUntil(nextDeadline);
+}
+
+void FrameLoop::waitUntil(Uint64 deadline) const {
+	PROFILE_SCOPE("FrameLoop::wait");
+
+	const auto ticksPerMs = SDL_GetPerformanceFrequency() / 1000.0;
+	const auto spinTicks = static_cast<Uint64>(config.spinMarginMs * ticksPerMs);
+
+	for (;;) {
+		const auto now = SDL_GetPerformanceCounter();
+
+		if (now >= deadline) {
+			return;
+		}
+
+		const auto remaining = deadline - now;
+
+		if (remaining <= spinTicks) {
+			break;
+		}
+
+		// Sleep in whole milliseconds, always leaving the spin margin for the scheduler to be late
+		const auto sleepMs = static_cast<Uint32>((remaining - spinTicks) / ticksPerMs);
+
+		if (sleepMs == 0) {
+			break;
+		}
+
+		SDL_Delay(sleepMs);
+	}
+
+	while (SDL_GetPerformanceCounter() < deadline) {
+		// Spin for the last stretch; SDL_Delay can't be trusted for sub-millisecond precision
+	}
+}
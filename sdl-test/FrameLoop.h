@@ -0,0 +1,77 @@
+#pragma once
+
+#include <SDL/SDL.h>
+
+struct InputSnapshot;
+
+enum class PacingMode {
+	VSync,
+	Uncapped,
+	TargetFps
+};
+
+struct FrameLoopConfig {
+	PacingMode mode = PacingMode::VSync;
+	double targetFps = 60.0;
+	double simulationHz = 60.0;
+
+	// Never run more than this many simulation steps to catch up in one frame
+	int maxStepsPerFrame = 5;
+
+	// How close to the frame deadline we stop sleeping and start spinning
+	double spinMarginMs = 2.0;
+};
+
+/** Class: FrameLoop
+ *
+ *  Description:
+ *  Drives the main loop. Each frame starts with beginFrame(), which takes the frame's input (for
+ *  quit requests and lost render targets) and measures how much real time has passed; the
+ *  simulation then advances in fixed steps for as long as step() returns true, and rendering uses
+ *  alpha() to interpolate between the last two simulation states. endFrame() waits for the next
+ *  frame deadline when running at a target rate, sleeping in coarse SDL_Delay chunks until it's
+ *  within spinMarginMs, then spinning on the performance counter for the remainder. With vsync the
+ *  wait happens in SDL_RenderPresent instead, and uncapped frames don't wait at all.
+ *
+ */
+
+class FrameLoop {
+public:
+	explicit FrameLoop(const FrameLoopConfig& config);
+
+	bool running() const { return !quitRequested; }
+
+	// True for the frame in which the renderer reported that render target contents were lost
+	bool renderTargetsLost() const { return targetsLost; }
+	void requestQuit() { quitRequested = true; }
+
+	void beginFrame(const InputSnapshot& input);
+	bool step();
+	void endFrame();
+
+	double timestep() const { return simulationStep; }
+	double alpha() const { return accumulator / simulationStep; }
+
+	// Wall-clock duration of the previous complete frame
+	double frameMilliseconds() const { return lastFrameMs; }
+	Uint64 frameCount() const { return frames; }
+
+	static Uint32 rendererFlags(const FrameLoopConfig& config);
+
+private:
+	void waitUntil(Uint64 deadline) const;
+
+	FrameLoopConfig config;
+	double simulationStep;
+	double secondsPerTick;
+	Uint64 framePeriod;
+
+	Uint64 frameStart = 0;
+	Uint64 nextDeadline = 0;
+	double accumulator = 0.0;
+	int stepsThisFrame = 0;
+	double lastFrameMs = 0.0;
+	Uint64 frames = 0;
+	bool quitRequested = false;
+	bool targetsLost = false;
+};
@@ -0,0 +1,352 @@
+#include "ImageCodec.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "Log.h"
+#include "PixelKernels.h"
+#include "Profiler.h"
+#include "TexturePack.h"
+
+namespace {
+	const Uint32 QOI_MAGIC = 0x716F6966; // "qoif"
+	const std::size_t QOI_HEADER_SIZE = 14;
+	const unsigned char QOI_END[] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+	// Anything bigger than this is a corrupt header, not an image we'd want to allocate for
+	const Uint32 QOI_MAX_PIXELS = 400000000;
+
+	// The most pixels one byte of data can encode, as a QOI_OP_RUN
+	const Uint32 QOI_MAX_RUN = 62;
+
+	const unsigned char QOI_OP_INDEX = 0x00;
+	const unsigned char QOI_OP_DIFF = 0x40;
+	const unsigned char QOI_OP_LUMA = 0x80;
+	const unsigned char QOI_OP_RUN = 0xC0;
+	const unsigned char QOI_OP_RGB = 0xFE;
+	const unsigned char QOI_OP_RGBA = 0xFF;
+	const unsigned char QOI_MASK = 0xC0;
+
+	struct Rgba {
+		Uint8 r;
+		Uint8 g;
+		Uint8 b;
+		Uint8 a;
+	};
+
+	inline std::size_t hash(const Rgba& px) {
+		return (px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) % 64;
+	}
+
+	inline bool same(const Rgba& a, const Rgba& b) {
+		return (a.r == b.r) && (a.g == b.g) && (a.b == b.b) && (a.a == b.a);
+	}
+
+	Uint32 readBigEndian(const unsigned char *bytes) {
+		return (static_cast<Uint32>(bytes[0]) << 24) | (static_cast<Uint32>(bytes[1]) << 16) | (static_cast<Uint32>(bytes[2]) << 8) | bytes[3];
+	}
+
+	void writeBigEndian(std::vector<unsigned char>& output, Uint32 value) {
+		output.push_back(static_cast<unsigned char>(value >> 24));
+		output.push_back(static_cast<unsigned char>(value >> 16));
+		output.push_back(static_cast<unsigned char>(value >> 8));
+		output.push_back(static_cast<unsigned char>(value));
+	}
+
+	bool hasExtension(const std::string& path, const char *extension) {
+		const auto length = std::strlen(extension);
+
+		if (path.size() < length) {
+			return false;
+		}
+
+		for (std::size_t i = 0; i < length; ++i) {
+			const auto c = path[path.size() - length + i];
+
+			if (((c >= 'A') && (c <= 'Z') ? c - 'A' + 'a' : c) != extension[i]) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	SurfacePtr loadQOI(const std::string& path) {
+		const auto file = MappedFile::open(path);
+
+		if (!file) {
+			SDL_SetError("could not open %s", path.c_str());
+			return nullptr;
+		}
+
+		return decodeQOI(file->data(), file->size());
+	}
+}
+
+SurfacePtr decodeQOI(const unsigned char *data, std::size_t size) {
+	PROFILE_SCOPE("decodeQOI");
+
+	if ((size < QOI_HEADER_SIZE + sizeof(QOI_END)) || (readBigEndian(data) != QOI_MAGIC)) {
+		SDL_SetError("not a QOI image");
+		return nullptr;
+	}
+
+	const auto width = readBigEndian(data + 4);
+	const auto height = readBigEndian(data + 8);
+	const auto channels = data[12];
+
+	if ((width == 0) || (height == 0) || (height > QOI_MAX_PIXELS / width) || ((channels != 3) && (channels != 4))) {
+		SDL_SetError("invalid QOI header");
+		return nullptr;
+	}
+
+	// Checked before allocating, so a header can't ask for a surface its data could never fill
+	const auto encodedBytes = static_cast<Uint64>(size - QOI_HEADER_SIZE - sizeof(QOI_END));
+
+	if (static_cast<Uint64>(width) * height > encodedBytes * QOI_MAX_RUN) {
+		SDL_SetError("QOI image is %ux%u but has only %llu bytes of data", width, height, static_cast<unsigned long long>(encodedBytes));
+		return nullptr;
+	}
+
+	SurfacePtr surface(SDL_CreateRGBSurfaceWithFormat(0, static_cast<int>(width), static_cast<int>(height), 32, SDL_PIXELFORMAT_ARGB8888));
+
+	if (!surface) {
+		return nullptr;
+	}
+
+	Rgba index[64] = {};
+	Rgba px { 0, 0, 0, 255 };
+	auto run = 0;
+
+	const auto *in = data + QOI_HEADER_SIZE;
+	const auto *end = data + size - sizeof(QOI_END);
+
+	auto *row = static_cast<Uint8*>(surface->pixels);
+
+	for (Uint32 y = 0; y < height; ++y, row += surface->pitch) {
+		auto *out = reinterpret_cast<Uint32*>(row);
+
+		for (Uint32 x = 0; x < width; ++x) {
+			if (run > 0) {
+				--run;
+			} else {
+				if (in >= end) {
+					SDL_SetError("QOI data ends early");
+					return nullptr;
+				}
+
+				const auto op = *in++;
+
+				if (op == QOI_OP_RGB) {
+					if (end - in < 3) {
+						SDL_SetError("QOI data ends early");
+						return nullptr;
+					}
+
+					px.r = in[0];
+					px.g = in[1];
+					px.b = in[2];
+					in += 3;
+				} else if (op == QOI_OP_RGBA) {
+					if (end - in < 4) {
+						SDL_SetError("QOI data ends early");
+						return nullptr;
+					}
+
+					px.r = in[0];
+					px.g = in[1];
+					px.b = in[2];
+					px.a = in[3];
+					in += 4;
+				} else if ((op & QOI_MASK) == QOI_OP_INDEX) {
+					px = index[op];
+				} else if ((op & QOI_MASK) == QOI_OP_DIFF) {
+					px.r = static_cast<Uint8>(px.r + ((op >> 4) & 0x03) - 2);
+					px.g = static_cast<Uint8>(px.g + ((op >> 2) & 0x03) - 2);
+					px.b = static_cast<Uint8>(px.b + (op & 0x03) - 2);
+				} else if ((op & QOI_MASK) == QOI_OP_LUMA) {
+					if (in >= end) {
+						SDL_SetError("QOI data ends early");
+						return nullptr;
+					}
+
+					const auto next = *in++;
+					const auto greenDiff = (op & 0x3F) - 32;
+
+					px.r = static_cast<Uint8>(px.r + greenDiff - 8 + ((next >> 4) & 0x0F));
+					px.g = static_cast<Uint8>(px.g + greenDiff);
+					px.b = static_cast<Uint8>(px.b + greenDiff - 8 + (next & 0x0F));
+				} else {
+					// QOI_OP_RUN; this pixel is the first of the run
+					run = op & 0x3F;
+				}
+
+				index[hash(px)] = px;
+			}
+
+			out[x] = (static_cast<Uint32>(px.a) << 24) | (static_cast<Uint32>(px.r) << 16) | (static_cast<Uint32>(px.g) << 8) | px.b;
+		}
+	}
+
+	return surface;
+}
+
+bool encodeQOI(SDL_Surface *surface, std::vector<unsigned char>& output) {
+	PROFILE_SCOPE("encodeQOI");
+
+	SurfacePtr converted;
+
+	if (surface->format->format != SDL_PIXELFORMAT_ARGB8888) {
+		converted = convertToARGB8888(surface);
+
+		if (!converted) {
+			return false;
+		}
+
+		surface = converted.get();
+	}
+
+	output.clear();
+	output.reserve(QOI_HEADER_SIZE + static_cast<std::size_t>(surface->w) * surface->h + sizeof(QOI_END));
+
+	writeBigEndian(output, QOI_MAGIC);
+	writeBigEndian(output, static_cast<Uint32>(surface->w));
+	writeBigEndian(output, static_cast<Uint32>(surface->h));
+	output.push_back(4);
+	output.push_back(0);
+
+	Rgba index[64] = {};
+	Rgba previous { 0, 0, 0, 255 };
+	auto run = 0;
+
+	SDL_LockSurface(surface);
+
+	const auto *row = static_cast<const Uint8*>(surface->pixels);
+	const auto lastRow = surface->h - 1;
+
+	for (auto y = 0; y < surface->h; ++y, row += surface->pitch) {
+		const auto *in = reinterpret_cast<const Uint32*>(row);
+
+		for (auto x = 0; x < surface->w; ++x) {
+			const auto argb = in[x];
+			const Rgba px {
+				static_cast<Uint8>(argb >> 16),
+				static_cast<Uint8>(argb >> 8),
+				static_cast<Uint8>(argb),
+				static_cast<Uint8>(argb >> 24)
+			};
+
+			if (same(px, previous)) {
+				++run;
+
+				// Runs of 63 and 64 would collide with the RGB and RGBA tags
+				if ((run == 62) || ((y == lastRow) && (x == surface->w - 1))) {
+					output.push_back(static_cast<unsigned char>(QOI_OP_RUN | (run - 1)));
+					run = 0;
+				}
+
+				continue;
+			}
+
+			if (run > 0) {
+				output.push_back(static_cast<unsigned char>(QOI_OP_RUN | (run - 1)));
+				run = 0;
+			}
+
+			const auto slot = hash(px);
+
+			if (same(index[slot], px)) {
+				output.push_back(static_cast<unsigned char>(QOI_OP_INDEX | slot));
+			} else {
+				index[slot] = px;
+
+				if (px.a == previous.a) {
+					const auto dr = static_cast<Sint8>(px.r - previous.r);
+					const auto dg = static_cast<Sint8>(px.g - previous.g);
+					const auto db = static_cast<Sint8>(px.b - previous.b);
+					const auto drg = static_cast<Sint8>(dr - dg);
+					const auto dbg = static_cast<Sint8>(db - dg);
+
+					if ((dr >= -2) && (dr <= 1) && (dg >= -2) && (dg <= 1) && (db >= -2) && (db <= 1)) {
+						output.push_back(static_cast<unsigned char>(QOI_OP_DIFF | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2)));
+					} else if ((dg >= -32) && (dg <= 31) && (drg >= -8) && (drg <= 7) && (dbg >= -8) && (dbg <= 7)) {
+						output.push_back(static_cast<unsigned char>(QOI_OP_LUMA | (dg + 32)));
+						output.push_back(static_cast<unsigned char>(((drg + 8) << 4) | (dbg + 8)));
+					} else {
+						output.push_back(QOI_OP_RGB);
+						output.push_back(px.r);
+						output.push_back(px.g);
+						output.push_back(px.b);
+					}
+				} else {
+					output.push_back(QOI_OP_RGBA);
+					output.push_back(px.r);
+					output.push_back(px.g);
+					output.push_back(px.b);
+					output.push_back(px.a);
+				}
+			}
+
+			previous = px;
+		}
+	}
+
+	SDL_UnlockSurface(surface);
+
+	output.insert(output.end(), std::begin(QOI_END), std::end(QOI_END));
+	return true;
+}
+
+bool writeQOI(const std::string& path, SDL_Surface *surface) {
+	std::vector<unsigned char> encoded;
+
+	if (!encodeQOI(surface, encoded)) {
+		return false;
+	}
+
+	std::FILE *output = std::fopen(path.c_str(), "wb");
+
+	if (!output) {
+		SDL_SetError("could not open %s for writing", path.c_str());
+		return false;
+	}
+
+	const auto ok = std::fwrite(encoded.data(), 1, encoded.size(), output) == encoded.size();
+
+	if ((std::fclose(output) != 0) || !ok) {
+		SDL_SetError("could not write %s", path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+std::string compressedImagePath(const std::string& path) {
+	return hasExtension(path, ".bmp") ? path.substr(0, path.size() - 4) + ".qoi" : std::string();
+}
+
+SurfacePtr loadImage(const std::string& path) {
+	PROFILE_SCOPE("loadImage");
+
+	if (hasExtension(path, ".qoi")) {
+		return loadQOI(path);
+	}
+
+	const auto compressed = compressedImagePath(path);
+
+	if (!compressed.empty()) {
+		const auto file = MappedFile::open(compressed);
+
+		if (file) {
+			return decodeQOI(file->data(), file->size());
+		}
+	}
+
+	return SurfacePtr(SDL_LoadBMP(path.c_str()));
+}
+
+SurfacePtr loadImageFile(const std::string& path) {
+	PROFILE_SCOPE("loadImageFile");
+
+	return hasExtension(path, ".qoi") ? loadQOI(path) : SurfacePtr(SDL_LoadBMP(path.c_str()));
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+#include "SDLHandles.h"
+
+/** Function: decodeQOI
+ *
+ *  Description:
+ *  Decodes a QOI ("Quite OK Image") file held in memory straight into a new ARGB8888 surface,
+ *  which is the format everything past loading wants, so there's no conversion pass afterwards.
+ *  QOI is lossless and decodes in a single linear pass. Returns nullptr, with the reason in
+ *  SDL_GetError, if the data isn't a valid QOI image.
+ *
+ */
+
+SurfacePtr decodeQOI(const unsigned char *data, std::size_t size);
+
+// Encodes any surface SDL can convert to ARGB8888; always writes four channels
+bool encodeQOI(SDL_Surface *surface, std::vector<unsigned char>& output);
+bool writeQOI(const std::string& path, SDL_Surface *surface);
+
+/** Function: loadImage
+ *
+ *  Description:
+ *  Loads a BMP or QOI image, chosen by extension. Asking for a .bmp that has a .qoi of the same
+ *  name next to it loads the .qoi instead, so converted assets are picked up without renaming
+ *  anything. QOI images come back as ARGB8888 and BMPs in whatever format the file used, so
+ *  callers should only convert when the format differs.
+ *
+ *  loadImageFile() loads exactly the file given, never a substitute. Hot reload uses it: the
+ *  watcher only sees the .bmp change, and whatever .qoi sits next to it is now out of date.
+ *
+ */
+
+SurfacePtr loadImage(const std::string& path);
+SurfacePtr loadImageFile(const std::string& path);
+
+// The .qoi file loadImage() would substitute for a .bmp path
+std::string compressedImagePath(const std::string& path);
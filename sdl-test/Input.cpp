@@ -0,0 +1,146 @@
+#include "Input.h"
+
+#include "Log.h"
+#include "Profiler.h"
+
+namespace {
+	// How much of each new latency sample goes into the running average
+	const Uint64 LATENCY_SMOOTHING_DIVISOR = 16;
+
+	bool isInputEvent(Uint32 type) {
+		return (type == SDL_KEYDOWN) || (type == SDL_KEYUP) || (type == SDL_MOUSEMOTION)
+			|| (type == SDL_MOUSEBUTTONDOWN) || (type == SDL_MOUSEBUTTONUP) || (type == SDL_MOUSEWHEEL);
+	}
+}
+
+const InputSnapshot& Input::poll() {
+	PROFILE_SCOPE("Input::poll");
+
+	current.keysPressed.reset();
+	current.keysReleased.reset();
+	current.buttonsPressed = 0;
+	current.buttonsReleased = 0;
+	current.wheelY = 0;
+	current.renderTargetsLost = false;
+	current.oldestInput = 0;
+	current.events = 0;
+
+	SDL_PumpEvents();
+
+	// Event timestamps are in SDL ticks; these two let us put them on the performance counter
+	const auto now = SDL_GetPerformanceCounter();
+	const auto nowTicks = SDL_GetTicks();
+
+	for (;;) {
+		const auto count = SDL_PeepEvents(events, EVENT_BATCH, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+
+		if (count < 0) {
+			LogSDLError(std::cerr, "PeepEvents");
+			break;
+		}
+
+		for (auto i = 0; i < count; ++i) {
+			handle(events[i], now, nowTicks);
+		}
+
+		current.events += count;
+
+		if (count < EVENT_BATCH) {
+			break;
+		}
+	}
+
+	return current;
+}
+
+void Input::handle(const SDL_Event& event, Uint64 now, Uint32 nowTicks) {
+	if (isInputEvent(event.type)) {
+		const auto ageTicks = static_cast<Uint64>((nowTicks > event.common.timestamp) ? nowTicks - event.common.timestamp : 0);
+		const auto happened = now - (ageTicks * SDL_GetPerformanceFrequency()) / 1000;
+
+		if ((current.oldestInput == 0) || (happened < current.oldestInput)) {
+			current.oldestInput = happened;
+		}
+	}
+
+	switch (event.type) {
+		case SDL_QUIT:
+			current.quitRequested = true;
+			break;
+
+		case SDL_RENDER_TARGETS_RESET:
+		case SDL_RENDER_DEVICE_RESET:
+			current.renderTargetsLost = true;
+			break;
+
+		case SDL_WINDOWEVENT:
+			if (event.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
+				current.keysReleased |= current.keysDown;
+				current.keysDown.reset();
+				current.buttonsReleased |= current.buttonsDown;
+				current.buttonsDown = 0;
+			}
+			break;
+
+		case SDL_KEYDOWN:
+		case SDL_KEYUP: {
+			const auto key = event.key.keysym.scancode;
+
+			if ((key < 0) || (key >= SDL_NUM_SCANCODES) || event.key.repeat) {
+				break;
+			}
+
+			const auto down = event.type == SDL_KEYDOWN;
+			current.keysDown.set(key, down);
+			(down ? current.keysPressed : current.keysReleased).set(key);
+			break;
+		}
+
+		case SDL_MOUSEMOTION:
+			current.mouseX = event.motion.x;
+			current.mouseY = event.motion.y;
+			break;
+
+		case SDL_MOUSEBUTTONDOWN:
+			current.mouseX = current.pressX = event.button.x;
+			current.mouseY = current.pressY = event.button.y;
+			current.buttonsDown |= SDL_BUTTON(event.button.button);
+			current.buttonsPressed |= SDL_BUTTON(event.button.button);
+			break;
+
+		case SDL_MOUSEBUTTONUP:
+			current.mouseX = event.button.x;
+			current.mouseY = event.button.y;
+			current.buttonsDown &= ~SDL_BUTTON(event.button.button);
+			current.buttonsReleased |= SDL_BUTTON(event.button.button);
+			break;
+
+		case SDL_MOUSEWHEEL:
+			current.wheelY += event.wheel.y;
+			break;
+
+		default:
+			break;
+	}
+}
+
+void InputLatency::presented(Uint64 inputTime) {
+	const auto now = SDL_GetPerformanceCounter();
+
+	if (inputTime == 0 || inputTime > now) {
+		return;
+	}
+
+	const auto micros = (now - inputTime) * 1000000 / SDL_GetPerformanceFrequency();
+
+	// Only the presenting thread writes, so these don't need to be one atomic step
+	const auto average = averageMicros.load(std::memory_order_relaxed);
+	const auto smoothed = (average == 0) ? micros : average - average / LATENCY_SMOOTHING_DIVISOR + micros / LATENCY_SMOOTHING_DIVISOR;
+
+	lastMicros.store(micros, std::memory_order_relaxed);
+	averageMicros.store(smoothed, std::memory_order_relaxed);
+
+	if (micros > worstMicros.load(std::memory_order_relaxed)) {
+		worstMicros.store(micros, std::memory_order_relaxed);
+	}
+}
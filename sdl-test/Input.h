@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <bitset>
+#include <cstddef>
+
+#include <SDL/SDL.h>
+
+/** Struct: InputSnapshot
+ *
+ *  Description:
+ *  Everything the game needs to know about input for one frame, built from that frame's events.
+ *  Keys and mouse buttons have three states: down (held at the end of the frame), pressed (went down
+ *  during the frame) and released (came up during the frame). A tap that started and ended between
+ *  two frames shows up as both pressed and released without ever being down, so nothing is missed
+ *  however short it was. Key repeats don't count as presses.
+ *
+ *  oldestInput is when the earliest input event in the frame happened, on the performance counter,
+ *  or 0 if there was none; it's what input latency is measured from.
+ *
+ */
+
+struct InputSnapshot {
+	std::bitset<SDL_NUM_SCANCODES> keysDown;
+	std::bitset<SDL_NUM_SCANCODES> keysPressed;
+	std::bitset<SDL_NUM_SCANCODES> keysReleased;
+
+	int mouseX = 0;
+	int mouseY = 0;
+	Uint32 buttonsDown = 0;
+	Uint32 buttonsPressed = 0;
+	Uint32 buttonsReleased = 0;
+	int wheelY = 0;
+
+	// Where the mouse was when a button last went down, which can differ from where it is now
+	int pressX = 0;
+	int pressY = 0;
+
+	bool quitRequested = false;
+	bool renderTargetsLost = false;
+
+	Uint64 oldestInput = 0;
+	std::size_t events = 0;
+
+	bool keyDown(SDL_Scancode key) const { return keysDown.test(key); }
+	bool keyPressed(SDL_Scancode key) const { return keysPressed.test(key); }
+	bool keyReleased(SDL_Scancode key) const { return keysReleased.test(key); }
+
+	bool buttonDown(int button) const { return (buttonsDown & SDL_BUTTON(button)) != 0; }
+	bool buttonPressed(int button) const { return (buttonsPressed & SDL_BUTTON(button)) != 0; }
+	bool buttonReleased(int button) const { return (buttonsReleased & SDL_BUTTON(button)) != 0; }
+};
+
+/** Class: Input
+ *
+ *  Description:
+ *  Drains the event queue once per frame and turns it into an InputSnapshot. Events are pulled out
+ *  with SDL_PeepEvents a batch at a time rather than one SDL_PollEvent call each, so a flood of
+ *  mouse motion costs a few calls instead of hundreds. Keys that were held when the window lost
+ *  focus are let go, since their key-up events will go to another window.
+ *
+ *  Must be called on the thread that created the window.
+ *
+ */
+
+class Input {
+public:
+	Input() = default;
+	Input(const Input&) = delete;
+	Input& operator=(const Input&) = delete;
+
+	const InputSnapshot& poll();
+	const InputSnapshot& snapshot() const { return current; }
+
+private:
+	void handle(const SDL_Event& event, Uint64 now, Uint32 nowTicks);
+
+	static const int EVENT_BATCH = 64;
+
+	SDL_Event events[EVENT_BATCH];
+	InputSnapshot current;
+};
+
+/** Class: InputLatency
+ *
+ *  Description:
+ *  Measures how long input takes to reach the screen: from when the oldest input event of a frame
+ *  happened to when that frame had been presented. presented() is meant to be called right after
+ *  SDL_RenderPresent returns on whichever thread presents, and the results can be read from any
+ *  thread. With vsync, present returns once the frame is queued for display, so this is the part
+ *  of the latency the program controls; the display adds its own on top.
+ *
+ */
+
+class InputLatency {
+public:
+	void presented(Uint64 inputTime);
+
+	double lastMilliseconds() const { return lastMicros.load(std::memory_order_relaxed) / 1000.0; }
+	double averageMilliseconds() const { return averageMicros.load(std::memory_order_relaxed) / 1000.0; }
+
+	// The worst since the last call, so callers can show the worst per interval
+	double takeWorstMilliseconds() { return worstMicros.exchange(0, std::memory_order_relaxed) / 1000.0; }
+
+private:
+	std::atomic<Uint64> lastMicros { 0 };
+	std::atomic<Uint64> averageMicros { 0 };
+	std::atomic<Uint64> worstMicros { 0 };
+};
@@ -0,0 +1,160 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+#include <SDL/SDL.h>
+
+#include "Profiler.h"
+
+namespace {
+	// Which pool the current thread works for, and which of its queues is its own
+	thread_local const JobSystem *workerPool = nullptr;
+	thread_local std::size_t workerQueue = 0;
+}
+
+unsigned JobSystem::defaultWorkerCount() {
+	return static_cast<unsigned>(std::max(SDL_GetCPUCount() - 1, 0));
+}
+
+JobSystem::JobSystem(unsigned workers) {
+	for (unsigned i = 0; i <= workers; ++i) {
+		queues.emplace_back(new Queue());
+	}
+
+	for (unsigned i = 0; i < workers; ++i) {
+		threads.emplace_back(&JobSystem::workerMain, this, static_cast<std::size_t>(i + 1));
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+
+	wake.notify_all();
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+std::size_t JobSystem::currentQueue() const {
+	return (workerPool == this) ? workerQueue : 0;
+}
+
+void JobSystem::run(JobGroup& group, std::function<void()> job) {
+	group.pending.fetch_add(1);
+
+	auto& queue = *queues[currentQueue()];
+
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(Job { std::move(job), &group });
+	}
+
+	queued.fetch_add(1);
+
+	// Taking the lock orders this against a worker that has just checked for work and is about to sleep
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+
+	wake.notify_one();
+}
+
+bool JobSystem::take(std::size_t home, Job& job) {
+	// Newest first from our own queue...
+	{
+		auto& queue = *queues[home];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (!queue.jobs.empty()) {
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+			queued.fetch_sub(1);
+			return true;
+		}
+	}
+
+	// ...then oldest first from everyone else's, starting with our neighbour so thieves spread out
+	for (std::size_t offset = 1; offset < queues.size(); ++offset) {
+		auto& queue = *queues[(home + offset) % queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (!queue.jobs.empty()) {
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			queued.fetch_sub(1);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void JobSystem::execute(Job& job) {
+	job.function();
+	job.group->pending.fetch_sub(1);
+}
+
+void JobSystem::workerMain(std::size_t index) {
+	workerPool = this;
+	workerQueue = index;
+
+	while (true) {
+		Job job;
+
+		if (take(index, job)) {
+			execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this]() { return stopping || (queued.load() > 0); });
+
+		if (stopping) {
+			return;
+		}
+	}
+}
+
+void JobSystem::wait(JobGroup& group) {
+	PROFILE_SCOPE("JobSystem::wait");
+
+	const auto home = currentQueue();
+
+	while (group.pending.load() > 0) {
+		Job job;
+
+		if (take(home, job)) {
+			execute(job);
+		} else {
+			// Whatever is left is already running on other threads
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::parallelFor(std::size_t count, std::size_t grain, const std::function<void(std::size_t, std::size_t)>& body) {
+	grain = std::max(grain, std::size_t { 1 });
+
+	if ((count <= grain) || threads.empty()) {
+		if (count > 0) {
+			body(0, count);
+		}
+
+		return;
+	}
+
+	JobGroup group;
+
+	// The calling thread takes the first range itself rather than queueing it
+	for (auto first = grain; first < count; first += grain) {
+		const auto last = std::min(first + grain, count);
+		run(group, [&body, first, last]() { body(first, last); });
+	}
+
+	body(0, grain);
+	wait(group);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** Struct: JobGroup
+ *
+ *  Description:
+ *  Counts the jobs started under it that haven't finished yet. Pass the same group to every
+ *  JobSystem::run() that belongs together, then JobSystem::wait() on it. A group must outlive
+ *  its jobs.
+ *
+ */
+
+struct JobGroup {
+	std::atomic<std::size_t> pending { 0 };
+};
+
+/** Class: JobSystem
+ *
+ *  Description:
+ *  A pool of worker threads, one per spare core, for splitting a frame's CPU work (sprite updates,
+ *  culling, animation) across the machine. Each worker has its own deque of jobs: it pushes and
+ *  pops at the back, so it works through its newest jobs first while they're still in cache, and
+ *  when it runs dry it steals the oldest job from the front of someone else's deque. Jobs started
+ *  from threads outside the pool go in a deque of their own that every worker steals from.
+ *
+ *  wait() doesn't block while there's work: the waiting thread runs queued jobs itself until the
+ *  group is done, so waiting from the main thread or from inside another job can't deadlock and
+ *  doesn't leave a core idle.
+ *
+ *  Jobs must not touch the SDL_Renderer, which only the render thread may use. They should prepare
+ *  data for the main thread to record into a command buffer instead.
+ *
+ *  Each deque has its own lock, which costs little since owners and thieves rarely meet on the
+ *  same one; jobs are meant to be coarse (parallelFor hands out ranges, not single elements).
+ *
+ *  Destroying the system stops the workers without running what's still queued, so wait on every
+ *  group first.
+ *
+ */
+
+class JobSystem {
+public:
+	// One less than the number of cores, leaving a core to the main thread; can be 0
+	static unsigned defaultWorkerCount();
+
+	explicit JobSystem(unsigned workers = defaultWorkerCount());
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+	~JobSystem();
+
+	unsigned workerCount() const { return static_cast<unsigned>(threads.size()); }
+
+	void run(JobGroup& group, std::function<void()> job);
+	void wait(JobGroup& group);
+
+	/** Function: parallelFor
+	 *
+	 *  Description:
+	 *  Calls body(first, last) over consecutive ranges covering [0, count), each at most grain
+	 *  elements long, spread across the workers and the calling thread, and returns once all of
+	 *  them have. A count of at most grain runs on the calling thread with no scheduling at all.
+	 *
+	 */
+
+	void parallelFor(std::size_t count, std::size_t grain, const std::function<void(std::size_t, std::size_t)>& body);
+
+private:
+	struct Job {
+		std::function<void()> function;
+		JobGroup *group;
+	};
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	void workerMain(std::size_t index);
+	bool take(std::size_t home, Job& job);
+	void execute(Job& job);
+	std::size_t currentQueue() const;
+
+	// queues[0] is shared by every thread outside the pool; queues[i + 1] belongs to worker i
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> threads;
+
+	std::atomic<std::size_t> queued { 0 };
+	std::atomic<bool> stopping { false };
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+};
@@ -0,0 +1,7 @@
+#include "Log.h"
+
+#include <SDL/SDL.h>
+
+void LogSDLError(std::ostream& os, const std::string& errorMessage) {
+	os << errorMessage << " error: " << SDL_GetError() << '\n';
+}
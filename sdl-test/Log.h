@@ -0,0 +1,14 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+
+/** Function: LogSDLError
+ *
+ *  Description:
+ *  Writes the given message followed by the last error SDL reported. Every module that calls
+ *  into SDL reports failures through here so the output stays in one format.
+ *
+ */
+
+void LogSDLError(std::ostream& os, const std::string& errorMessage);
@@ -0,0 +1,168 @@
+#include "MetricsSocket.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#include "Profiler.h"
+
+namespace {
+#ifdef _WIN32
+	using NativeSocket = SOCKET;
+
+	const auto NO_SOCKET = INVALID_SOCKET;
+
+	void closeSocket(NativeSocket socket) {
+		closesocket(socket);
+	}
+
+	bool setNonBlocking(NativeSocket socket) {
+		u_long enabled = 1;
+		return ioctlsocket(socket, FIONBIO, &enabled) == 0;
+	}
+#else
+	using NativeSocket = int;
+
+	const auto NO_SOCKET = -1;
+
+	void closeSocket(NativeSocket socket) {
+		close(socket);
+	}
+
+	bool setNonBlocking(NativeSocket socket) {
+		const auto flags = fcntl(socket, F_GETFL, 0);
+		return (flags >= 0) && (fcntl(socket, F_SETFL, flags | O_NONBLOCK) == 0);
+	}
+#endif
+
+	NativeSocket nativeSocket(std::uintptr_t handle) {
+		return static_cast<NativeSocket>(handle);
+	}
+}
+
+std::unique_ptr<MetricsSocket> MetricsSocket::open(const std::string& address, const std::string& prefix) {
+	static_assert(sizeof(sockaddr_storage) <= sizeof(MetricsSocket::destination), "destination has to hold any socket address");
+
+	const auto separator = address.rfind(':');
+
+	if ((separator == std::string::npos) || (separator == 0) || (separator + 1 == address.size())) {
+		std::cerr << "MetricsSocket " << address << " error: expected host:port\n";
+		return nullptr;
+	}
+
+	auto host = address.substr(0, separator);
+	const auto port = address.substr(separator + 1);
+
+	// IPv6 addresses come in brackets so their own colons aren't taken for the port's
+	if ((host.size() > 2) && (host.front() == '[') && (host.back() == ']')) {
+		host = host.substr(1, host.size() - 2);
+	}
+
+	std::unique_ptr<MetricsSocket> metrics(new MetricsSocket());
+	metrics->prefix = prefix;
+
+#ifdef _WIN32
+	WSADATA data;
+
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+		std::cerr << "MetricsSocket " << address << " error: could not start Winsock\n";
+		return nullptr;
+	}
+
+	metrics->winsockStarted = true;
+#endif
+
+	addrinfo hints {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+
+	addrinfo *resolved = nullptr;
+
+	if ((getaddrinfo(host.c_str(), port.c_str(), &hints, &resolved) != 0) || !resolved) {
+		std::cerr << "MetricsSocket " << address << " error: could not resolve " << host << '\n';
+		return nullptr;
+	}
+
+	const auto socket = ::socket(resolved->ai_family, resolved->ai_socktype, resolved->ai_protocol);
+
+	if (socket != NO_SOCKET) {
+		metrics->socketHandle = static_cast<std::uintptr_t>(socket);
+		metrics->socketOpen = true;
+
+		std::memcpy(metrics->destination, resolved->ai_addr, resolved->ai_addrlen);
+		metrics->destinationLength = static_cast<int>(resolved->ai_addrlen);
+	}
+
+	freeaddrinfo(resolved);
+
+	if (!metrics->socketOpen || !setNonBlocking(socket)) {
+		std::cerr << "MetricsSocket " << address << " error: could not open a UDP socket\n";
+		return nullptr;
+	}
+
+	// Room for every line, so sending never grows it
+	metrics->datagram.reserve(512 + 16 * prefix.size());
+
+	return metrics;
+}
+
+MetricsSocket::~MetricsSocket() {
+	if (socketOpen) {
+		closeSocket(nativeSocket(socketHandle));
+	}
+
+#ifdef _WIN32
+	if (winsockStarted) {
+		WSACleanup();
+	}
+#endif
+}
+
+void MetricsSocket::send(const FrameStats& stats, bool overBudget) {
+	PROFILE_SCOPE("MetricsSocket::send");
+
+	datagram.clear();
+
+	auto gauge = [&](const char *name, unsigned long long value) {
+		char line[64];
+		std::snprintf(line, sizeof(line), ".%s:%llu|g\n", name, value);
+
+		datagram += prefix;
+		datagram += line;
+	};
+
+	gauge("draw_calls", stats.drawCalls);
+	gauge("texture_switches", stats.textureSwitches);
+	gauge("vertices", stats.vertices);
+	gauge("uploads", stats.uploads);
+	gauge("upload_bytes", stats.uploadBytes);
+	gauge("cache_hits", stats.cacheHits);
+	gauge("cache_misses", stats.cacheMisses);
+	gauge("allocations", stats.allocations);
+	gauge("over_budget", overBudget ? 1 : 0);
+
+	// StatsD takes the last line without its newline too, but not every agent likes a trailing one
+	datagram.pop_back();
+
+	const auto result = sendto(nativeSocket(socketHandle), datagram.data(), static_cast<int>(datagram.size()), 0,
+		reinterpret_cast<const sockaddr*>(destination), destinationLength);
+
+	if (result < 0) {
+		++dropped;
+	} else {
+		++sent;
+	}
+}
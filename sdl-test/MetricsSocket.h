@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "RenderStats.h"
+
+/** Class: MetricsSocket
+ *
+ *  Description:
+ *  Sends every frame's RenderStats to a metrics collector as StatsD gauges over UDP, one datagram
+ *  a frame with a line per counter ("<prefix>.draw_calls:118|g"), plus over_budget as 0 or 1. Any
+ *  StatsD-speaking agent (statsd, Telegraf, the Datadog agent) can collect them and alert on them.
+ *
+ *  open() takes "host:port" and resolves it once. The socket doesn't block: a frame the network
+ *  can't take right away is dropped rather than holding up the thread that sends it, which is
+ *  normally the render thread, right after presenting.
+ *
+ */
+
+class MetricsSocket {
+public:
+	static std::unique_ptr<MetricsSocket> open(const std::string& address, const std::string& prefix);
+
+	MetricsSocket(const MetricsSocket&) = delete;
+	MetricsSocket& operator=(const MetricsSocket&) = delete;
+	~MetricsSocket();
+
+	void send(const FrameStats& stats, bool overBudget);
+
+	std::size_t sentCount() const { return sent; }
+	std::size_t droppedCount() const { return dropped; }
+
+private:
+	MetricsSocket() = default;
+
+	std::string prefix;
+	std::string datagram;
+
+	// A SOCKET or a file descriptor, and a sockaddr_storage, kept opaque so the socket headers
+	// (winsock2.h in particular) stay out of everything that includes this
+	std::uintptr_t socketHandle = 0;
+	bool socketOpen = false;
+	bool winsockStarted = false;
+	alignas(8) unsigned char destination[128];
+	int destinationLength = 0;
+
+	std::size_t sent = 0;
+	std::size_t dropped = 0;
+};
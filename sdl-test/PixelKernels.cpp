@@ -0,0 +1,437 @@
+#include "PixelKernels.h"
+
+#include <cstring>
+
+#include "Log.h"
+#include "Profiler.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PIXEL_KERNELS_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PIXEL_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+// MSVC compiles any intrinsic without extra flags; GCC and Clang need each function marked
+#if defined(_MSC_VER) || !defined(PIXEL_KERNELS_X86)
+#define PIXEL_TARGET(isa)
+#else
+#define PIXEL_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace {
+	// Exact round(x / 255) for x in [0, 65025], the range of a product of two 8-bit values
+	inline Uint32 divide255(Uint32 x) {
+		x += 128;
+		return (x + (x >> 8)) >> 8;
+	}
+
+	void convertBGR24Scalar(const Uint8 *source, Uint32 *destination, std::size_t count) {
+		for (std::size_t i = 0; i < count; ++i, source += 3) {
+			destination[i] = 0xFF000000u | (static_cast<Uint32>(source[2]) << 16) | (static_cast<Uint32>(source[1]) << 8) | source[0];
+		}
+	}
+
+	void premultiplyScalar(Uint32 *pixels, std::size_t count) {
+		for (std::size_t i = 0; i < count; ++i) {
+			const auto pixel = pixels[i];
+			const auto alpha = pixel >> 24;
+
+			const auto r = divide255(((pixel >> 16) & 0xFF) * alpha);
+			const auto g = divide255(((pixel >> 8) & 0xFF) * alpha);
+			const auto b = divide255((pixel & 0xFF) * alpha);
+
+			pixels[i] = (alpha << 24) | (r << 16) | (g << 8) | b;
+		}
+	}
+
+	void colorKeyToAlphaScalar(Uint32 *pixels, std::size_t count, Uint32 key) {
+		key &= 0x00FFFFFF;
+
+		for (std::size_t i = 0; i < count; ++i) {
+			if ((pixels[i] & 0x00FFFFFF) == key) {
+				pixels[i] = 0;
+			}
+		}
+	}
+
+	void blendOverScalar(const Uint32 *source, Uint32 *destination, std::size_t count) {
+		for (std::size_t i = 0; i < count; ++i) {
+			const auto top = source[i];
+			const auto alpha = top >> 24;
+			const auto inverse = 255 - alpha;
+			const auto bottom = destination[i];
+
+			// The source's own alpha channel counts as 255, which gives a + da * (1 - a) for alpha
+			const auto a = divide255(255 * alpha + (bottom >> 24) * inverse);
+			const auto r = divide255(((top >> 16) & 0xFF) * alpha + ((bottom >> 16) & 0xFF) * inverse);
+			const auto g = divide255(((top >> 8) & 0xFF) * alpha + ((bottom >> 8) & 0xFF) * inverse);
+			const auto b = divide255((top & 0xFF) * alpha + (bottom & 0xFF) * inverse);
+
+			destination[i] = (a << 24) | (r << 16) | (g << 8) | b;
+		}
+	}
+
+#ifdef PIXEL_KERNELS_X86
+
+	// 16-bit lane version of divide255
+	PIXEL_TARGET("sse2") inline __m128i divide255(__m128i x) {
+		x = _mm_add_epi16(x, _mm_set1_epi16(128));
+		return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+	}
+
+	PIXEL_TARGET("sse2") inline __m128i broadcastAlpha(__m128i pixels16) {
+		// Each pixel is four 16-bit lanes b, g, r, a; copy a across all four
+		pixels16 = _mm_shufflelo_epi16(pixels16, _MM_SHUFFLE(3, 3, 3, 3));
+		return _mm_shufflehi_epi16(pixels16, _MM_SHUFFLE(3, 3, 3, 3));
+	}
+
+	PIXEL_TARGET("sse4.1") void convertBGR24SSE(const Uint8 *source, Uint32 *destination, std::size_t count) {
+		const auto shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const auto opaque = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+
+		std::size_t i = 0;
+
+		// Each 16-byte load covers five and a third pixels; only the first four are used, and the
+		// last iteration needs four bytes of slack past the final pixel it converts
+		for (; i + 6 <= count; i += 4) {
+			const auto bgr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 3));
+			const auto argb = _mm_or_si128(_mm_shuffle_epi8(bgr, shuffle), opaque);
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), argb);
+		}
+
+		convertBGR24Scalar(source + i * 3, destination + i, count - i);
+	}
+
+	PIXEL_TARGET("sse2") void premultiplySSE(Uint32 *pixels, std::size_t count) {
+		const auto zero = _mm_setzero_si128();
+		const auto alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+
+		std::size_t i = 0;
+
+		for (; i + 4 <= count; i += 4) {
+			const auto source = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i));
+
+			auto low = _mm_unpacklo_epi8(source, zero);
+			auto high = _mm_unpackhi_epi8(source, zero);
+
+			low = divide255(_mm_mullo_epi16(low, broadcastAlpha(low)));
+			high = divide255(_mm_mullo_epi16(high, broadcastAlpha(high)));
+
+			// Color channels are scaled, alpha is kept as it was
+			const auto scaled = _mm_andnot_si128(alphaMask, _mm_packus_epi16(low, high));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i), _mm_or_si128(scaled, _mm_and_si128(source, alphaMask)));
+		}
+
+		premultiplyScalar(pixels + i, count - i);
+	}
+
+	PIXEL_TARGET("sse2") void colorKeyToAlphaSSE(Uint32 *pixels, std::size_t count, Uint32 key) {
+		const auto colorMask = _mm_set1_epi32(0x00FFFFFF);
+		const auto keyColor = _mm_set1_epi32(static_cast<int>(key & 0x00FFFFFF));
+
+		std::size_t i = 0;
+
+		for (; i + 4 <= count; i += 4) {
+			const auto source = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i));
+			const auto keyed = _mm_cmpeq_epi32(_mm_and_si128(source, colorMask), keyColor);
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i), _mm_andnot_si128(keyed, source));
+		}
+
+		colorKeyToAlphaScalar(pixels + i, count - i, key);
+	}
+
+	PIXEL_TARGET("sse2") void blendOverSSE(const Uint32 *source, Uint32 *destination, std::size_t count) {
+		const auto zero = _mm_setzero_si128();
+		const auto full = _mm_set1_epi16(255);
+		const auto sourceAlphaOne = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+
+		std::size_t i = 0;
+
+		for (; i + 4 <= count; i += 4) {
+			const auto top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+			const auto bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(destination + i));
+
+			// Weights come from the source's real alpha; then its alpha lane is treated as 255
+			const auto alphaLow = broadcastAlpha(_mm_unpacklo_epi8(top, zero));
+			const auto alphaHigh = broadcastAlpha(_mm_unpackhi_epi8(top, zero));
+
+			const auto opaqueTop = _mm_or_si128(top, sourceAlphaOne);
+
+			const auto low = divide255(_mm_add_epi16(
+				_mm_mullo_epi16(_mm_unpacklo_epi8(opaqueTop, zero), alphaLow),
+				_mm_mullo_epi16(_mm_unpacklo_epi8(bottom, zero), _mm_sub_epi16(full, alphaLow))));
+
+			const auto high = divide255(_mm_add_epi16(
+				_mm_mullo_epi16(_mm_unpackhi_epi8(opaqueTop, zero), alphaHigh),
+				_mm_mullo_epi16(_mm_unpackhi_epi8(bottom, zero), _mm_sub_epi16(full, alphaHigh))));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_packus_epi16(low, high));
+		}
+
+		blendOverScalar(source + i, destination + i, count - i);
+	}
+
+	PIXEL_TARGET("avx2") inline __m256i divide255(__m256i x) {
+		x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+		return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+	}
+
+	PIXEL_TARGET("avx2") inline __m256i broadcastAlpha(__m256i pixels16) {
+		pixels16 = _mm256_shufflelo_epi16(pixels16, _MM_SHUFFLE(3, 3, 3, 3));
+		return _mm256_shufflehi_epi16(pixels16, _MM_SHUFFLE(3, 3, 3, 3));
+	}
+
+	// The AVX2 versions mirror the SSE ones on twice the width. Unpack and pack both work within
+	// 128-bit lanes, so pixels come back out in the order they went in.
+
+	PIXEL_TARGET("avx2") void premultiplyAVX2(Uint32 *pixels, std::size_t count) {
+		const auto zero = _mm256_setzero_si256();
+		const auto alphaMask = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+
+		std::size_t i = 0;
+
+		for (; i + 8 <= count; i += 8) {
+			const auto source = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + i));
+
+			auto low = _mm256_unpacklo_epi8(source, zero);
+			auto high = _mm256_unpackhi_epi8(source, zero);
+
+			low = divide255(_mm256_mullo_epi16(low, broadcastAlpha(low)));
+			high = divide255(_mm256_mullo_epi16(high, broadcastAlpha(high)));
+
+			const auto scaled = _mm256_andnot_si256(alphaMask, _mm256_packus_epi16(low, high));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i), _mm256_or_si256(scaled, _mm256_and_si256(source, alphaMask)));
+		}
+
+		premultiplySSE(pixels + i, count - i);
+	}
+
+	PIXEL_TARGET("avx2") void colorKeyToAlphaAVX2(Uint32 *pixels, std::size_t count, Uint32 key) {
+		const auto colorMask = _mm256_set1_epi32(0x00FFFFFF);
+		const auto keyColor = _mm256_set1_epi32(static_cast<int>(key & 0x00FFFFFF));
+
+		std::size_t i = 0;
+
+		for (; i + 8 <= count; i += 8) {
+			const auto source = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + i));
+			const auto keyed = _mm256_cmpeq_epi32(_mm256_and_si256(source, colorMask), keyColor);
+
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i), _mm256_andnot_si256(keyed, source));
+		}
+
+		colorKeyToAlphaSSE(pixels + i, count - i, key);
+	}
+
+	PIXEL_TARGET("avx2") void blendOverAVX2(const Uint32 *source, Uint32 *destination, std::size_t count) {
+		const auto zero = _mm256_setzero_si256();
+		const auto full = _mm256_set1_epi16(255);
+		const auto sourceAlphaOne = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+
+		std::size_t i = 0;
+
+		for (; i + 8 <= count; i += 8) {
+			const auto top = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+			const auto bottom = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(destination + i));
+
+			const auto alphaLow = broadcastAlpha(_mm256_unpacklo_epi8(top, zero));
+			const auto alphaHigh = broadcastAlpha(_mm256_unpackhi_epi8(top, zero));
+
+			const auto opaqueTop = _mm256_or_si256(top, sourceAlphaOne);
+
+			const auto low = divide255(_mm256_add_epi16(
+				_mm256_mullo_epi16(_mm256_unpacklo_epi8(opaqueTop, zero), alphaLow),
+				_mm256_mullo_epi16(_mm256_unpacklo_epi8(bottom, zero), _mm256_sub_epi16(full, alphaLow))));
+
+			const auto high = divide255(_mm256_add_epi16(
+				_mm256_mullo_epi16(_mm256_unpackhi_epi8(opaqueTop, zero), alphaHigh),
+				_mm256_mullo_epi16(_mm256_unpackhi_epi8(bottom, zero), _mm256_sub_epi16(full, alphaHigh))));
+
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_packus_epi16(low, high));
+		}
+
+		blendOverSSE(source + i, destination + i, count - i);
+	}
+
+#endif
+
+#ifdef PIXEL_KERNELS_NEON
+
+	// Rounded division by 255 of eight 16-bit products, narrowed back to bytes
+	inline uint8x8_t divide255(uint16x8_t x) {
+		return vraddhn_u16(x, vrshrq_n_u16(x, 8));
+	}
+
+	void convertBGR24NEON(const Uint8 *source, Uint32 *destination, std::size_t count) {
+		std::size_t i = 0;
+
+		// vld3 splits the interleaved bytes into B, G and R planes; vst4 interleaves them back with A
+		for (; i + 16 <= count; i += 16) {
+			const auto bgr = vld3q_u8(source + i * 3);
+
+			uint8x16x4_t bgra;
+			bgra.val[0] = bgr.val[0];
+			bgra.val[1] = bgr.val[1];
+			bgra.val[2] = bgr.val[2];
+			bgra.val[3] = vdupq_n_u8(255);
+
+			vst4q_u8(reinterpret_cast<Uint8*>(destination + i), bgra);
+		}
+
+		convertBGR24Scalar(source + i * 3, destination + i, count - i);
+	}
+
+	void premultiplyNEON(Uint32 *pixels, std::size_t count) {
+		std::size_t i = 0;
+
+		for (; i + 8 <= count; i += 8) {
+			auto bgra = vld4_u8(reinterpret_cast<const Uint8*>(pixels + i));
+			const auto alpha = bgra.val[3];
+
+			bgra.val[0] = divide255(vmull_u8(bgra.val[0], alpha));
+			bgra.val[1] = divide255(vmull_u8(bgra.val[1], alpha));
+			bgra.val[2] = divide255(vmull_u8(bgra.val[2], alpha));
+
+			vst4_u8(reinterpret_cast<Uint8*>(pixels + i), bgra);
+		}
+
+		premultiplyScalar(pixels + i, count - i);
+	}
+
+	void colorKeyToAlphaNEON(Uint32 *pixels, std::size_t count, Uint32 key) {
+		const auto colorMask = vdupq_n_u32(0x00FFFFFF);
+		const auto keyColor = vdupq_n_u32(key & 0x00FFFFFF);
+
+		std::size_t i = 0;
+
+		for (; i + 4 <= count; i += 4) {
+			const auto source = vld1q_u32(pixels + i);
+			const auto keyed = vceqq_u32(vandq_u32(source, colorMask), keyColor);
+
+			vst1q_u32(pixels + i, vbicq_u32(source, keyed));
+		}
+
+		colorKeyToAlphaScalar(pixels + i, count - i, key);
+	}
+
+	void blendOverNEON(const Uint32 *source, Uint32 *destination, std::size_t count) {
+		std::size_t i = 0;
+
+		for (; i + 8 <= count; i += 8) {
+			const auto top = vld4_u8(reinterpret_cast<const Uint8*>(source + i));
+			auto bottom = vld4_u8(reinterpret_cast<const Uint8*>(destination + i));
+
+			const auto alpha = top.val[3];
+			const auto inverse = vmvn_u8(alpha);
+
+			for (auto channel = 0; channel < 3; ++channel) {
+				bottom.val[channel] = divide255(vmlal_u8(vmull_u8(top.val[channel], alpha), bottom.val[channel], inverse));
+			}
+
+			bottom.val[3] = divide255(vmlal_u8(vmull_u8(vdup_n_u8(255), alpha), bottom.val[3], inverse));
+
+			vst4_u8(reinterpret_cast<Uint8*>(destination + i), bottom);
+		}
+
+		blendOverScalar(source + i, destination + i, count - i);
+	}
+
+#endif
+
+	PixelKernels selectPixelKernels() {
+		PixelKernels kernels = scalarPixelKernels();
+
+#if defined(PIXEL_KERNELS_X86)
+		if (SDL_HasSSE2()) {
+			kernels.name = "sse2";
+			kernels.premultiply = premultiplySSE;
+			kernels.colorKeyToAlpha = colorKeyToAlphaSSE;
+			kernels.blendOver = blendOverSSE;
+		}
+
+		// SSE4.1 implies the SSSE3 byte shuffle the BGR24 conversion is built on
+		if (SDL_HasSSE41()) {
+			kernels.name = "sse4.1";
+			kernels.convertBGR24 = convertBGR24SSE;
+		}
+
+		if (SDL_HasAVX2()) {
+			kernels.name = "avx2";
+			kernels.premultiply = premultiplyAVX2;
+			kernels.colorKeyToAlpha = colorKeyToAlphaAVX2;
+			kernels.blendOver = blendOverAVX2;
+		}
+#elif defined(PIXEL_KERNELS_NEON)
+		kernels = PixelKernels { "neon", convertBGR24NEON, premultiplyNEON, colorKeyToAlphaNEON, blendOverNEON };
+#endif
+
+		return kernels;
+	}
+}
+
+const PixelKernels& scalarPixelKernels() {
+	static const PixelKernels kernels { "scalar", convertBGR24Scalar, premultiplyScalar, colorKeyToAlphaScalar, blendOverScalar };
+	return kernels;
+}
+
+const PixelKernels& pixelKernels() {
+	static const PixelKernels kernels = selectPixelKernels();
+	return kernels;
+}
+
+SurfacePtr convertToARGB8888(SDL_Surface *surface) {
+	PROFILE_SCOPE("convertToARGB8888");
+
+	const auto& kernels = pixelKernels();
+
+	SurfacePtr converted;
+
+	if (surface->format->format == SDL_PIXELFORMAT_BGR24) {
+		converted.reset(SDL_CreateRGBSurfaceWithFormat(0, surface->w, surface->h, 32, SDL_PIXELFORMAT_ARGB8888));
+
+		if (converted) {
+			SDL_LockSurface(surface);
+
+			const auto *sourceRow = static_cast<const Uint8*>(surface->pixels);
+			auto *destinationRow = static_cast<Uint8*>(converted->pixels);
+
+			for (auto y = 0; y < surface->h; ++y, sourceRow += surface->pitch, destinationRow += converted->pitch) {
+				kernels.convertBGR24(sourceRow, reinterpret_cast<Uint32*>(destinationRow), static_cast<std::size_t>(surface->w));
+			}
+
+			SDL_UnlockSurface(surface);
+		}
+	} else {
+		converted.reset(SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0));
+	}
+
+	if (!converted) {
+		LogSDLError(std::cerr, "ConvertSurfaceFormat");
+		return nullptr;
+	}
+
+	Uint32 key = 0;
+
+	if (SDL_GetColorKey(surface, &key) == 0) {
+		// The key is in the source's format; compare against it as ARGB8888
+		Uint8 r = 0;
+		Uint8 g = 0;
+		Uint8 b = 0;
+
+		SDL_GetRGB(key, surface->format, &r, &g, &b);
+
+		auto *row = static_cast<Uint8*>(converted->pixels);
+
+		for (auto y = 0; y < converted->h; ++y, row += converted->pitch) {
+			kernels.colorKeyToAlpha(reinterpret_cast<Uint32*>(row), static_cast<std::size_t>(converted->w), (static_cast<Uint32>(r) << 16) | (g << 8) | b);
+		}
+
+		SDL_SetColorKey(converted.get(), 0, 0);
+	}
+
+	SDL_SetSurfaceBlendMode(converted.get(), SDL_BLENDMODE_BLEND);
+	return converted;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+
+#include <SDL/SDL.h>
+
+#include "SDLHandles.h"
+
+/** Pixel kernels
+ *
+ *  Description:
+ *  Bulk pixel operations on CPU-side surfaces, with SSE4.1, AVX2 and NEON versions chosen at
+ *  runtime from what the CPU reports, and a scalar version for everything else. All 32-bit pixels
+ *  are SDL_PIXELFORMAT_ARGB8888, i.e. 0xAARRGGBB in native byte order; BGR24 is what SDL_LoadBMP
+ *  produces for 24-bit bitmaps on little-endian machines (bytes B, G, R in memory).
+ *
+ *  - convertBGR24:    BGR24 -> ARGB8888 with opaque alpha
+ *  - premultiply:     scales color channels by alpha
+ *  - colorKeyToAlpha: pixels whose color equals the key become fully transparent black
+ *  - blendOver:       straight-alpha source over destination, in place on the destination
+ *
+ */
+
+struct PixelKernels {
+	const char *name;
+	void (*convertBGR24)(const Uint8 *source, Uint32 *destination, std::size_t count);
+	void (*premultiply)(Uint32 *pixels, std::size_t count);
+	void (*colorKeyToAlpha)(Uint32 *pixels, std::size_t count, Uint32 key);
+	void (*blendOver)(const Uint32 *source, Uint32 *destination, std::size_t count);
+};
+
+// Picked once, on first use, from the best instruction set the CPU supports
+const PixelKernels& pixelKernels();
+
+// The portable versions, for comparison and for callers that need identical results everywhere
+const PixelKernels& scalarPixelKernels();
+
+/** Function: convertToARGB8888
+ *
+ *  Description:
+ *  Returns a copy of the surface in ARGB8888, using the kernels above for BGR24 sources and SDL's
+ *  own conversion for anything else. If the surface has a color key, keyed pixels come out with
+ *  zero alpha, so the result can be drawn with SDL_BLENDMODE_BLEND and no color key at all.
+ *
+ */
+
+SurfacePtr convertToARGB8888(SDL_Surface *surface);
@@ -0,0 +1,316 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+
+#include "CommandBuffer.h"
+
+namespace {
+	thread_local Uint32 scopeDepth = 0;
+
+	// Constant-initialized, so it's ready before any static constructor can allocate
+	std::atomic<Uint64> heapAllocations { 0 };
+
+	Uint32 colorFor(const char *name) {
+		// FNV-1a over the name, so a scope keeps its color from frame to frame
+		Uint32 hash = 2166136261u;
+
+		for (auto *c = name; *c; ++c) {
+			hash = (hash ^ static_cast<unsigned char>(*c)) * 16777619u;
+		}
+
+		return hash | 0x808080;
+	}
+}
+
+#ifdef SDLTEST_PROFILING
+
+// The array forms all end up here by default, so these cover every allocation
+void *operator new(std::size_t size) {
+	heapAllocations.fetch_add(1, std::memory_order_relaxed);
+
+	if (auto *memory = std::malloc(size ? size : 1)) {
+		return memory;
+	}
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+	std::free(memory);
+}
+
+#endif
+
+Uint64 Profiler::allocationCount() {
+	return heapAllocations.load(std::memory_order_relaxed);
+}
+
+bool Profiler::countingAllocations() {
+#ifdef SDLTEST_PROFILING
+	return true;
+#else
+	return false;
+#endif
+}
+
+Profiler& Profiler::instance() {
+	static Profiler profiler;
+	return profiler;
+}
+
+Uint32 Profiler::currentThread() {
+	static std::atomic<Uint32> nextThread { 0 };
+	thread_local const Uint32 thread = nextThread++;
+
+	return thread;
+}
+
+void Profiler::beginFrame() {
+	std::lock_guard<std::mutex> lock(frameMutex);
+
+	if (frequency == 0) {
+		frequency = SDL_GetPerformanceFrequency();
+	}
+
+	current = (current + 1) % frames.size();
+
+	auto& frame = frames[current];
+	frame.index = frameCounter++;
+	frame.start = SDL_GetPerformanceCounter();
+	frame.end = 0;
+
+	// Keeps its capacity, so steady-state frames don't allocate
+	frame.samples.assign(betweenFrames.begin(), betweenFrames.end());
+	betweenFrames.clear();
+
+	allocationsAtStart = allocationCount();
+}
+
+void Profiler::endFrame() {
+	std::lock_guard<std::mutex> lock(frameMutex);
+
+	frames[current].allocations = allocationCount() - allocationsAtStart;
+	frames[current].end = SDL_GetPerformanceCounter();
+}
+
+void Profiler::record(const char *name, Uint64 start, Uint64 end, Uint32 depth) {
+	std::lock_guard<std::mutex> lock(frameMutex);
+
+	// Completed frames are read without the lock, so they must not change once ended
+	auto& samples = (frames[current].end == 0) ? frames[current].samples : betweenFrames;
+	samples.push_back(ProfileSample { name, start, end, depth, currentThread() });
+}
+
+std::size_t Profiler::completedFrames() const {
+	std::lock_guard<std::mutex> lock(frameMutex);
+
+	// The slot being recorded into doesn't count until it ends
+	const auto recorded = static_cast<std::size_t>(frameCounter);
+	const auto inProgress = (frames[current].end == 0) ? 1 : 0;
+
+	return std::min(recorded - std::min<std::size_t>(recorded, inProgress), PROFILE_HISTORY);
+}
+
+const FrameProfile& Profiler::completedFrame(std::size_t framesAgo) const {
+	std::lock_guard<std::mutex> lock(frameMutex);
+
+	const auto skip = (frames[current].end == 0) ? 1 : 0;
+	const auto slot = (current + frames.size() * 2 - framesAgo - skip) % frames.size();
+
+	return frames[slot];
+}
+
+bool Profiler::writeCsv(const std::string& path) const {
+	std::ofstream output(path);
+
+	if (!output) {
+		return false;
+	}
+
+	const auto count = completedFrames();
+	const auto toMs = 1000.0 / std::max<Uint64>(frequency, 1);
+
+	output << "frame,name,thread,depth,start_ms,duration_ms,allocations\n";
+
+	for (auto ago = count; ago-- > 0;) {
+		const auto& frame = completedFrame(ago);
+
+		output << frame.index << ",frame,0,0,0," << (frame.end - frame.start) * toMs << ',' << frame.allocations << '\n';
+
+		for (const auto& sample : frame.samples) {
+			output << frame.index << ',' << sample.name << ',' << sample.thread << ',' << sample.depth << ','
+				<< (static_cast<double>(sample.start) - frame.start) * toMs << ',' << (sample.end - sample.start) * toMs << ",\n";
+		}
+	}
+
+	return static_cast<bool>(output);
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) const {
+	std::ofstream output(path);
+
+	if (!output) {
+		return false;
+	}
+
+	const auto count = completedFrames();
+	const auto toUs = 1000000.0 / std::max<Uint64>(frequency, 1);
+
+	if (count == 0) {
+		output << "{\"traceEvents\":[]}\n";
+		return static_cast<bool>(output);
+	}
+
+	const auto origin = completedFrame(count - 1).start;
+	auto first = true;
+
+	auto event = [&](const char *name, Uint32 thread, Uint64 start, Uint64 end) {
+		output << (first ? "\n" : ",\n") << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+			<< ",\"ts\":" << (start - origin) * toUs << ",\"dur\":" << (end - start) * toUs << '}';
+		first = false;
+	};
+
+	output << "{\"traceEvents\":[";
+
+	for (auto ago = count; ago-- > 0;) {
+		const auto& frame = completedFrame(ago);
+
+		event("frame", 0, frame.start, frame.end);
+
+		// A counter track, so allocations per frame show up as a graph under the timeline
+		output << ",\n{\"name\":\"heap allocations\",\"ph\":\"C\",\"pid\":1,\"ts\":" << (frame.start - origin) * toUs
+			<< ",\"args\":{\"count\":" << frame.allocations << "}}";
+
+		for (const auto& sample : frame.samples) {
+			// Worker samples can start before the frame they were filed under
+			if (sample.start >= origin) {
+				event(sample.name, sample.thread, sample.start, sample.end);
+			}
+		}
+	}
+
+	output << "\n]}\n";
+	return static_cast<bool>(output);
+}
+
+ProfileScope::ProfileScope(const char *name)
+	: name(name), start(SDL_GetPerformanceCounter()), depth(scopeDepth++) {
+}
+
+ProfileScope::~ProfileScope() {
+	--scopeDepth;
+	Profiler::instance().record(name, start, SDL_GetPerformanceCounter(), depth);
+}
+
+ProfilerOverlay::ProfilerOverlay(int screenWidth, int screenHeight, double targetFrameMs)
+	: screenWidth(screenWidth), screenHeight(screenHeight), targetFrameMs(targetFrameMs) {
+}
+
+void ProfilerOverlay::record(CommandBuffer& commands) {
+	const auto& profiler = Profiler::instance();
+	const auto count = profiler.completedFrames();
+
+	if (count == 0) {
+		return;
+	}
+
+	const auto frequency = static_cast<double>(SDL_GetPerformanceFrequency());
+	const auto barWidth = 2;
+	const auto targetHeight = 40;
+	const auto maxHeight = targetHeight * 3;
+	const auto pixelsPerMs = targetHeight / targetFrameMs;
+
+	// Frame history, newest on the right; frames over budget are drawn in red
+	bars.clear();
+
+	const auto visible = std::min<std::size_t>(count, static_cast<std::size_t>(screenWidth / barWidth));
+	std::size_t overBudget = 0;
+
+	for (std::size_t ago = 0; ago < visible; ++ago) {
+		const auto& frame = profiler.completedFrame(ago);
+		const auto frameMs = (frame.end - frame.start) * 1000.0 / frequency;
+		const auto height = std::min(static_cast<int>(frameMs * pixelsPerMs), maxHeight);
+
+		const SDL_Rect bar { screenWidth - static_cast<int>(ago + 1) * barWidth, screenHeight - height, barWidth - 1, height };
+
+		// Over-budget frames go at the front so they can be drawn in a second color
+		if (frameMs > targetFrameMs) {
+			bars.insert(bars.begin() + overBudget++, bar);
+		} else {
+			bars.push_back(bar);
+		}
+	}
+
+	// The latest frame's top-level scopes on this thread, stacked bottom to top
+	segments.clear();
+
+	const auto& latest = profiler.completedFrame(0);
+	const auto thread = Profiler::currentThread();
+	auto y = screenHeight - maxHeight;
+
+	for (const auto& sample : latest.samples) {
+		if ((sample.depth != 0) || (sample.thread != thread)) {
+			continue;
+		}
+
+		const auto height = std::max(static_cast<int>((sample.end - sample.start) * 1000.0 / frequency * pixelsPerMs), 1);
+
+		y -= height;
+		segments.push_back({ SDL_Rect { 0, y, 12, height }, colorFor(sample.name) });
+	}
+
+	// The render thread draws a copy: bars and segments are refilled next frame, maybe while it draws
+	auto& arena = commands.arena();
+	const auto barCount = bars.size();
+	const auto segmentCount = segments.size();
+
+	auto *barRects = static_cast<SDL_Rect*>(arena.allocate(barCount * sizeof(SDL_Rect), alignof(SDL_Rect)));
+	auto *segmentRects = static_cast<Segment*>(arena.allocate(segmentCount * sizeof(Segment), alignof(Segment)));
+
+	std::copy(bars.begin(), bars.end(), barRects);
+	std::copy(segments.begin(), segments.end(), segmentRects);
+
+	const SDL_Rect backdrop { 0, screenHeight - maxHeight, screenWidth, maxHeight };
+	const SDL_Rect budgetLine { 0, screenHeight - targetHeight, screenWidth, 1 };
+
+	commands.call([=](SDL_Renderer *renderer) {
+		// Leave the renderer's draw state the way we found it; the next frame clears with its color
+		SDL_BlendMode previousBlend;
+		Uint8 r, g, b, a;
+
+		SDL_GetRenderDrawBlendMode(renderer, &previousBlend);
+		SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+
+		SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+
+		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 128);
+		SDL_RenderFillRect(renderer, &backdrop);
+
+		SDL_SetRenderDrawColor(renderer, 224, 64, 64, 255);
+		SDL_RenderFillRects(renderer, barRects, static_cast<int>(overBudget));
+
+		SDL_SetRenderDrawColor(renderer, 96, 224, 96, 255);
+		SDL_RenderFillRects(renderer, barRects + overBudget, static_cast<int>(barCount - overBudget));
+
+		SDL_SetRenderDrawColor(renderer, 255, 255, 255, 160);
+		SDL_RenderFillRect(renderer, &budgetLine);
+
+		for (std::size_t i = 0; i < segmentCount; ++i) {
+			const auto color = segmentRects[i].color;
+
+			SDL_SetRenderDrawColor(renderer, (color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF, 255);
+			SDL_RenderFillRect(renderer, &segmentRects[i].rect);
+		}
+
+		SDL_SetRenderDrawColor(renderer, r, g, b, a);
+		SDL_SetRenderDrawBlendMode(renderer, previousBlend);
+	});
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+class CommandBuffer;
+
+/** Profiler
+ *
+ *  Description:
+ *  Scoped CPU timers. PROFILE_SCOPE("name") measures from where it appears to the end of the
+ *  enclosing block with SDL_GetPerformanceCounter and files the sample under the current frame;
+ *  PROFILE_FRAME_BEGIN/END delimit frames. The profiler keeps the last PROFILE_HISTORY frames in a
+ *  ring buffer that the overlay draws from and that can be dumped as CSV or as a Chrome trace
+ *  (load it in chrome://tracing).
+ *
+ *  Samples can be recorded from any thread. Completed frames are only read from the thread that
+ *  calls beginFrame/endFrame; anything recorded between two frames is filed under the next one.
+ *
+ *  Profiling builds also count heap allocations, by replacing the global operator new, and every
+ *  frame records how many happened on any thread while it was open. A frame whose per-frame data
+ *  all comes from frame arenas should show zero once the arenas have warmed up.
+ *
+ *  The markers only do anything when SDLTEST_PROFILING is defined. Otherwise they expand to
+ *  nothing, so they can stay in release builds at no cost.
+ *
+ */
+
+const std::size_t PROFILE_HISTORY = 240;
+
+struct ProfileSample {
+	const char *name;
+	Uint64 start;
+	Uint64 end;
+	Uint32 depth;
+	Uint32 thread;
+};
+
+struct FrameProfile {
+	Uint64 index = 0;
+	Uint64 start = 0;
+	Uint64 end = 0;
+	Uint64 allocations = 0;
+	std::vector<ProfileSample> samples;
+};
+
+class Profiler {
+public:
+	static Profiler& instance();
+
+	void beginFrame();
+	void endFrame();
+	void record(const char *name, Uint64 start, Uint64 end, Uint32 depth);
+
+	// framesAgo = 0 is the most recently completed frame
+	std::size_t completedFrames() const;
+	const FrameProfile& completedFrame(std::size_t framesAgo) const;
+
+	bool writeCsv(const std::string& path) const;
+	bool writeChromeTrace(const std::string& path) const;
+
+	static Uint32 currentThread();
+
+	// Heap allocations made by the whole program so far; always 0 without SDLTEST_PROFILING
+	static Uint64 allocationCount();
+	static bool countingAllocations();
+
+private:
+	Profiler() = default;
+
+	mutable std::mutex frameMutex;
+	std::array<FrameProfile, PROFILE_HISTORY + 1> frames;
+	std::vector<ProfileSample> betweenFrames;
+	std::size_t current = 0;
+	Uint64 frameCounter = 0;
+	Uint64 allocationsAtStart = 0;
+	Uint64 frequency = 0;
+};
+
+class ProfileScope {
+public:
+	explicit ProfileScope(const char *name);
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+	~ProfileScope();
+
+private:
+	const char *name;
+	Uint64 start;
+	Uint32 depth;
+};
+
+/** Class: ProfilerOverlay
+ *
+ *  Description:
+ *  Draws the recent frame history along the bottom of the screen: one bar per frame, scaled so the
+ *  target frame time is a fixed height, with the latest frame's top-level scopes stacked in their
+ *  own colors in the corner above it.
+ *
+ *  record() has to be called from the thread that begins and ends frames, since that's the only
+ *  one that may read them. It works out every rectangle there and records a draw of them into the
+ *  command buffer, so the render thread never touches the profiler's history.
+ *
+ */
+
+class ProfilerOverlay {
+public:
+	ProfilerOverlay(int screenWidth, int screenHeight, double targetFrameMs);
+
+	void record(CommandBuffer& commands);
+
+private:
+	struct Segment {
+		SDL_Rect rect;
+		Uint32 color;
+	};
+
+	int screenWidth;
+	int screenHeight;
+	double targetFrameMs;
+	std::vector<SDL_Rect> bars;
+	std::vector<Segment> segments;
+};
+
+#ifdef SDLTEST_PROFILING
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FRAME_BEGIN() Profiler::instance().beginFrame()
+#define PROFILE_FRAME_END() Profiler::instance().endFrame()
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FRAME_BEGIN() ((void)0)
+#define PROFILE_FRAME_END() ((void)0)
+
+#endif
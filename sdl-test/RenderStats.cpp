@@ -0,0 +1,143 @@
+#include "RenderStats.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "Profiler.h"
+
+bool parseFrameBudget(const std::string& text, FrameBudget& budget) {
+	std::size_t start = 0;
+
+	while (start < text.size()) {
+		auto end = text.find(',', start);
+
+		if (end == std::string::npos) {
+			end = text.size();
+		}
+
+		const auto item = text.substr(start, end - start);
+		const auto equals = item.find('=');
+
+		if ((equals == std::string::npos) || (equals + 1 == item.size())) {
+			return false;
+		}
+
+		const auto name = item.substr(0, equals);
+		const auto *value = item.c_str() + equals + 1;
+		char *parsed = nullptr;
+		const auto limit = static_cast<std::size_t>(std::strtoull(value, &parsed, 10));
+
+		if (*parsed != '\0') {
+			return false;
+		}
+
+		if (name == "draws") {
+			budget.drawCalls = limit;
+		} else if (name == "switches") {
+			budget.textureSwitches = limit;
+		} else if (name == "vertices") {
+			budget.vertices = limit;
+		} else if (name == "upload") {
+			budget.uploadBytes = limit;
+		} else {
+			return false;
+		}
+
+		start = end + 1;
+	}
+
+	return true;
+}
+
+bool overBudget(const FrameStats& stats, const FrameBudget& budget) {
+	return overBudget(stats.drawCalls, budget.drawCalls)
+		|| overBudget(stats.textureSwitches, budget.textureSwitches)
+		|| overBudget(stats.vertices, budget.vertices)
+		|| overBudget(stats.uploadBytes, budget.uploadBytes);
+}
+
+RenderStats& RenderStats::instance() {
+	static RenderStats stats;
+	return stats;
+}
+
+void RenderStats::countDraw(SDL_Texture *texture, std::size_t vertexCount) {
+	drawCalls.fetch_add(1, std::memory_order_relaxed);
+	vertices.fetch_add(vertexCount, std::memory_order_relaxed);
+
+	if (texture != lastTexture) {
+		textureSwitches.fetch_add(1, std::memory_order_relaxed);
+		lastTexture = texture;
+	}
+}
+
+void RenderStats::countUpload(std::size_t bytes) {
+	uploads.fetch_add(1, std::memory_order_relaxed);
+	uploadBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void RenderStats::endFrame() {
+	FrameStats frame;
+	frame.index = frameIndex++;
+	frame.drawCalls = drawCalls.exchange(0, std::memory_order_relaxed);
+	frame.textureSwitches = textureSwitches.exchange(0, std::memory_order_relaxed);
+	frame.vertices = vertices.exchange(0, std::memory_order_relaxed);
+	frame.uploads = uploads.exchange(0, std::memory_order_relaxed);
+	frame.uploadBytes = uploadBytes.exchange(0, std::memory_order_relaxed);
+	frame.cacheHits = cacheHits.exchange(0, std::memory_order_relaxed);
+	frame.cacheMisses = cacheMisses.exchange(0, std::memory_order_relaxed);
+
+	const auto allocations = Profiler::allocationCount();
+	frame.allocations = allocations - allocationsAtStart;
+	allocationsAtStart = allocations;
+
+	std::lock_guard<std::mutex> lock(frameMutex);
+
+	lastFrame = frame;
+
+	worstFrame.index = frame.index;
+	worstFrame.drawCalls = std::max(worstFrame.drawCalls, frame.drawCalls);
+	worstFrame.textureSwitches = std::max(worstFrame.textureSwitches, frame.textureSwitches);
+	worstFrame.vertices = std::max(worstFrame.vertices, frame.vertices);
+	worstFrame.uploads = std::max(worstFrame.uploads, frame.uploads);
+	worstFrame.uploadBytes = std::max(worstFrame.uploadBytes, frame.uploadBytes);
+	worstFrame.cacheHits = std::max(worstFrame.cacheHits, frame.cacheHits);
+	worstFrame.cacheMisses = std::max(worstFrame.cacheMisses, frame.cacheMisses);
+	worstFrame.allocations = std::max(worstFrame.allocations, frame.allocations);
+
+	if (overBudget(frame, frameBudget)) {
+		++overBudgetFrames;
+	}
+}
+
+FrameStats RenderStats::latest() const {
+	std::lock_guard<std::mutex> lock(frameMutex);
+	return lastFrame;
+}
+
+FrameStats RenderStats::worst() const {
+	std::lock_guard<std::mutex> lock(frameMutex);
+	return worstFrame;
+}
+
+std::size_t RenderStats::framesOverBudget() const {
+	std::lock_guard<std::mutex> lock(frameMutex);
+	return overBudgetFrames;
+}
+
+void RenderStats::reset() {
+	std::lock_guard<std::mutex> lock(frameMutex);
+
+	worstFrame = FrameStats();
+	overBudgetFrames = 0;
+}
+
+void RenderStats::setBudget(const FrameBudget& budget) {
+	std::lock_guard<std::mutex> lock(frameMutex);
+	frameBudget = budget;
+}
+
+FrameBudget RenderStats::budget() const {
+	std::lock_guard<std::mutex> lock(frameMutex);
+	return frameBudget;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <string>
+
+#include <SDL/SDL.h>
+
+struct FrameStats {
+	Uint64 index = 0;
+
+	// Every SDL_RenderCopy and SDL_RenderGeometry made, and how many of them drew with a different
+	// texture than the draw before; copies count as four vertices
+	std::size_t drawCalls = 0;
+	std::size_t textureSwitches = 0;
+	std::size_t vertices = 0;
+
+	// Pixels handed to the renderer: textures created from images, updated, or streamed
+	std::size_t uploads = 0;
+	std::size_t uploadBytes = 0;
+
+	std::size_t cacheHits = 0;
+	std::size_t cacheMisses = 0;
+
+	// Heap allocations on any thread; always 0 without SDLTEST_PROFILING
+	Uint64 allocations = 0;
+};
+
+/** Struct: FrameBudget
+ *
+ *  Description:
+ *  The most a frame is meant to cost, for the counters a scene's content drives. A limit of 0 means
+ *  that counter isn't budgeted. parseFrameBudget() reads one from a list like
+ *  "draws=200,switches=40,vertices=20000,upload=1048576", as given on the command line.
+ *
+ */
+
+struct FrameBudget {
+	std::size_t drawCalls = 0;
+	std::size_t textureSwitches = 0;
+	std::size_t vertices = 0;
+	std::size_t uploadBytes = 0;
+};
+
+bool parseFrameBudget(const std::string& text, FrameBudget& budget);
+
+inline bool overBudget(std::size_t value, std::size_t limit) {
+	return (limit != 0) && (value > limit);
+}
+
+// Whether any budgeted counter of the frame went over
+bool overBudget(const FrameStats& stats, const FrameBudget& budget);
+
+/** Class: RenderStats
+ *
+ *  Description:
+ *  Counts the work handed to the renderer each frame, next to the profiler's timings: the modules
+ *  that call SDL count their draws, uploads and texture cache lookups here as they make them, and
+ *  endFrame() closes the frame, which latest() then returns. worst() keeps the highest value seen
+ *  of every counter since reset(), for setting budgets from, and how many frames went over the
+ *  budget given to setBudget().
+ *
+ *  Counting is a relaxed atomic add, so it's always on and can happen on any thread. Draws are only
+ *  counted on the thread that owns the renderer, which is also the thread that has to call
+ *  endFrame(), right after presenting; anything counted elsewhere goes into whichever frame that
+ *  thread has open at the time.
+ *
+ */
+
+class RenderStats {
+public:
+	static RenderStats& instance();
+
+	void countDraw(SDL_Texture *texture, std::size_t vertexCount);
+	void countUpload(std::size_t bytes);
+	void countUpload(const SDL_Surface *surface) { countUpload(static_cast<std::size_t>(surface->h) * surface->pitch); }
+	void countCacheHit() { cacheHits.fetch_add(1, std::memory_order_relaxed); }
+	void countCacheMiss() { cacheMisses.fetch_add(1, std::memory_order_relaxed); }
+
+	void endFrame();
+
+	FrameStats latest() const;
+	FrameStats worst() const;
+	std::size_t framesOverBudget() const;
+	void reset();
+
+	void setBudget(const FrameBudget& budget);
+	FrameBudget budget() const;
+
+private:
+	RenderStats() = default;
+
+	std::atomic<std::size_t> drawCalls { 0 };
+	std::atomic<std::size_t> textureSwitches { 0 };
+	std::atomic<std::size_t> vertices { 0 };
+	std::atomic<std::size_t> uploads { 0 };
+	std::atomic<std::size_t> uploadBytes { 0 };
+	std::atomic<std::size_t> cacheHits { 0 };
+	std::atomic<std::size_t> cacheMisses { 0 };
+
+	// Only touched by the thread that draws
+	SDL_Texture *lastTexture = nullptr;
+	Uint64 allocationsAtStart = 0;
+	Uint64 frameIndex = 0;
+
+	mutable std::mutex frameMutex;
+	FrameStats lastFrame;
+	FrameStats worstFrame;
+	FrameBudget frameBudget;
+	std::size_t overBudgetFrames = 0;
+};
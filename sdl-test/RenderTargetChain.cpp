@@ -0,0 +1,149 @@
+#include "RenderTargetChain.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "Log.h"
+#include "Profiler.h"
+#include "RenderStats.h"
+
+namespace {
+	// How much of each new frame time goes into the running average
+	const double FRAME_SMOOTHING = 0.1;
+
+	// How far over budget the average can drift before the scale drops, so noise doesn't trigger it
+	const double OVER_BUDGET = 1.05;
+
+	// Longest the controller will wait between probes for a higher scale
+	const int MAX_PROBE_FRAMES = 3600;
+}
+
+const float RenderTargetChain::MIN_SCALE = 0.25f;
+
+RenderTargetChain::RenderTargetChain(SDL_Renderer *renderer, int width, int height)
+	: renderer(renderer), width(width), height(height), supported(SDL_RenderTargetSupported(renderer) == SDL_TRUE) {
+}
+
+std::size_t RenderTargetChain::addPass(float scale) {
+	passes.emplace_back();
+	setScale(passes.size() - 1, scale);
+
+	return passes.size() - 1;
+}
+
+void RenderTargetChain::setScale(std::size_t pass, float scale) {
+	passes[pass].scale = std::min(std::max(scale, MIN_SCALE), 1.0f);
+}
+
+void RenderTargetChain::begin(std::size_t index) {
+	PROFILE_SCOPE("RenderTargetChain::begin");
+
+	auto& pass = passes[index];
+
+	if (!prepare(pass)) {
+		return;
+	}
+
+	auto *previous = active;
+
+	SDL_SetRenderTarget(renderer, pass.texture.get());
+	SDL_RenderSetScale(renderer, static_cast<float>(pass.width) / width, static_cast<float>(pass.height) / height);
+
+	// The new target's scale maps window coordinates onto it, so the whole window is the destination
+	if (previous) {
+		SDL_RenderCopy(renderer, previous->texture.get(), NULL, NULL);
+		RenderStats::instance().countDraw(previous->texture.get(), 4);
+	}
+
+	active = &pass;
+}
+
+void RenderTargetChain::finish() {
+	PROFILE_SCOPE("RenderTargetChain::finish");
+
+	if (!active) {
+		return;
+	}
+
+	// Going back to the window also puts back its own viewport and scale
+	SDL_SetRenderTarget(renderer, NULL);
+	SDL_RenderCopy(renderer, active->texture.get(), NULL, NULL);
+	RenderStats::instance().countDraw(active->texture.get(), 4);
+
+	active = nullptr;
+}
+
+bool RenderTargetChain::prepare(Pass& pass) {
+	if (!supported) {
+		return false;
+	}
+
+	const auto passWidth = std::max(static_cast<int>(std::lround(width * pass.scale)), 1);
+	const auto passHeight = std::max(static_cast<int>(std::lround(height * pass.scale)), 1);
+
+	if (pass.texture && (pass.width == passWidth) && (pass.height == passHeight)) {
+		return true;
+	}
+
+	pass.texture.reset();
+
+	// Upscaling a pass should filter, whatever the rest of the program asked for
+	const auto *hint = SDL_GetHint(SDL_HINT_RENDER_SCALE_QUALITY);
+	const std::string previousQuality = hint ? hint : "";
+
+	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
+	pass.texture.reset(SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, passWidth, passHeight));
+	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, previousQuality.c_str());
+
+	if (!pass.texture) {
+		LogSDLError(std::cerr, "CreateTexture");
+
+		// Don't try again every frame; draw to the window from now on
+		supported = false;
+		return false;
+	}
+
+	SDL_SetTextureBlendMode(pass.texture.get(), SDL_BLENDMODE_NONE);
+
+	pass.width = passWidth;
+	pass.height = passHeight;
+
+	return true;
+}
+
+DynamicResolution::DynamicResolution(const DynamicResolutionConfig& config)
+	: config(config), currentScale(config.maxScale), probeWait(config.probeFrames) {
+}
+
+void DynamicResolution::addFrame(double frameMilliseconds) {
+	averageMs = (averageMs > 0.0) ? averageMs + (frameMilliseconds - averageMs) * FRAME_SMOOTHING : frameMilliseconds;
+
+	framesSinceChange = std::min(framesSinceChange + 1, MAX_PROBE_FRAMES);
+
+	if (framesSinceChange < config.settleFrames) {
+		return;
+	}
+
+	if (averageMs > config.targetMilliseconds * OVER_BUDGET) {
+		if (currentScale <= config.minScale) {
+			return;
+		}
+
+		// Going back down right after a probe means the higher scale really doesn't fit
+		if (probing) {
+			probeWait = std::min(probeWait * 2, MAX_PROBE_FRAMES);
+		}
+
+		currentScale = std::max(currentScale - config.step, config.minScale);
+		framesSinceChange = 0;
+		probing = false;
+	} else if ((currentScale < config.maxScale) && (framesSinceChange >= probeWait)) {
+		currentScale = std::min(currentScale + config.step, config.maxScale);
+		framesSinceChange = 0;
+		probing = true;
+	} else if (probing && (framesSinceChange >= config.settleFrames * 2)) {
+		// The probe held, so the next one can come just as soon
+		probing = false;
+	}
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+#include "SDLHandles.h"
+
+/** Class: RenderTargetChain
+ *
+ *  Description:
+ *  A sequence of offscreen passes that end up in the window. Each pass renders into a render-target
+ *  texture of its own, sized by the pass's scale relative to the window, and starts with the pass
+ *  before it upscaled into its target; finish() then upscales whichever pass ran last into the
+ *  window and switches drawing back to the window, at native resolution.
+ *
+ *  While a pass is active, the renderer's scale is set so that drawing code keeps using window
+ *  coordinates whatever the pass's real resolution is. Rendering the scene at a reduced scale and
+ *  drawing the UI after finish() keeps text and overlays sharp while the scene costs less to fill.
+ *
+ *  A pass's target is recreated when its scale changes, so scales should change in coarse steps.
+ *  Without render-target support (or if a target can't be created), passes draw straight to the
+ *  window at full resolution instead, so callers never have to check.
+ *
+ *  Everything here has to run on the thread that owns the renderer.
+ *
+ */
+
+class RenderTargetChain {
+public:
+	RenderTargetChain(SDL_Renderer *renderer, int width, int height);
+	RenderTargetChain(const RenderTargetChain&) = delete;
+	RenderTargetChain& operator=(const RenderTargetChain&) = delete;
+
+	// Passes run in the order they're added; returns the new pass's index
+	std::size_t addPass(float scale = 1.0f);
+
+	void setScale(std::size_t pass, float scale);
+	float scale(std::size_t pass) const { return passes[pass].scale; }
+
+	void begin(std::size_t pass);
+	void finish();
+
+	bool valid() const { return supported; }
+
+	static const float MIN_SCALE;
+
+private:
+	struct Pass {
+		float scale = 1.0f;
+		TexturePtr texture;
+		int width = 0;
+		int height = 0;
+	};
+
+	bool prepare(Pass& pass);
+
+	SDL_Renderer *renderer;
+	int width;
+	int height;
+	bool supported;
+	std::vector<Pass> passes;
+	Pass *active = nullptr;
+};
+
+struct DynamicResolutionConfig {
+	// The frame time to aim for
+	double targetMilliseconds = 1000.0 / 60.0;
+
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+	float step = 0.125f;
+
+	// Frames to wait after a change before judging it, and before first trying a higher scale
+	int settleFrames = 30;
+	int probeFrames = 120;
+};
+
+/** Class: DynamicResolution
+ *
+ *  Description:
+ *  Picks a render scale from measured frame times. It lowers the scale a step whenever the smoothed
+ *  frame time goes over budget, and after a stretch within budget it tries a step back up. Under
+ *  vsync a frame that's within budget looks the same however much headroom it had, so raising the
+ *  scale is a probe: if it pushes the frame over budget again, the scale drops back and the wait
+ *  before the next probe doubles, so it doesn't keep bouncing between two scales.
+ *
+ */
+
+class DynamicResolution {
+public:
+	explicit DynamicResolution(const DynamicResolutionConfig& config);
+
+	void addFrame(double frameMilliseconds);
+
+	float scale() const { return currentScale; }
+
+private:
+	DynamicResolutionConfig config;
+	float currentScale;
+	double averageMs = 0.0;
+	int framesSinceChange = 0;
+	int probeWait;
+	bool probing = false;
+};
@@ -0,0 +1,126 @@
+#include "RenderThread.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Profiler.h"
+
+RenderThread::RenderThread(SDL_Renderer *renderer, bool threaded, std::size_t bufferCount)
+	: renderer(renderer), busy(std::max(bufferCount, std::size_t { 1 }), false) {
+	for (std::size_t i = 0; i < busy.size(); ++i) {
+		buffers.emplace_back(new CommandBuffer());
+	}
+
+	if (!threaded) {
+		return;
+	}
+
+	// An OpenGL context can only be current on one thread, so let go of it here; SDL makes it current
+	// on the render thread the first time that thread draws
+	SDL_RendererInfo info;
+
+	if ((SDL_GetRendererInfo(renderer, &info) == 0) && (std::strncmp(info.name, "opengl", 6) == 0)) {
+		SDL_GL_MakeCurrent(SDL_RenderGetWindow(renderer), NULL);
+		openGL = true;
+	}
+
+	thread = std::thread(&RenderThread::renderMain, this);
+}
+
+RenderThread::~RenderThread() {
+	if (!threaded()) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	changed.notify_all();
+	thread.join();
+}
+
+CommandBuffer& RenderThread::record() {
+	PROFILE_SCOPE("RenderThread::record");
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	// The render thread is a whole ring behind; wait for it rather than overwrite a frame it hasn't drawn
+	changed.wait(lock, [this]() { return !busy[next]; });
+
+	auto& buffer = *buffers[next];
+	buffer.reset();
+
+	return buffer;
+}
+
+void RenderThread::submit() {
+	if (!threaded()) {
+		execute(*buffers[next]);
+		next = (next + 1) % buffers.size();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		busy[next] = true;
+		++pending;
+		next = (next + 1) % buffers.size();
+	}
+
+	changed.notify_all();
+}
+
+void RenderThread::finish() {
+	std::unique_lock<std::mutex> lock(mutex);
+	changed.wait(lock, [this]() { return pending == 0; });
+}
+
+void RenderThread::execute(CommandBuffer& buffer) {
+	if (!capture) {
+		buffer.execute(renderer, rasterizer);
+		return;
+	}
+
+	// Recorded first, while every texture the buffer draws with is certain to still exist
+	capture->record(buffer);
+
+	const auto start = SDL_GetPerformanceCounter();
+	buffer.execute(renderer, rasterizer);
+
+	capture->finishFrame((SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+}
+
+void RenderThread::renderMain() {
+	// Buffers are executed in the order they were submitted, which is ring order
+	std::size_t current = 0;
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [this]() { return stopping || (pending > 0); });
+
+			// Stopping still drains whatever was submitted first
+			if (pending == 0) {
+				break;
+			}
+		}
+
+		execute(*buffers[current]);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			busy[current] = false;
+			--pending;
+		}
+
+		changed.notify_all();
+		current = (current + 1) % buffers.size();
+	}
+
+	// Give the context back, so textures still alive can be destroyed on the main thread
+	if (openGL) {
+		SDL_GL_MakeCurrent(SDL_RenderGetWindow(renderer), NULL);
+	}
+}
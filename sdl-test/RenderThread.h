@@ -0,0 +1,74 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+#include "CommandBuffer.h"
+#include "FrameCapture.h"
+#include "TileRasterizer.h"
+
+/** Class: RenderThread
+ *
+ *  Description:
+ *  Owns the renderer on a thread of its own and executes the command buffers the game loop hands
+ *  it, so simulating and recording one frame overlaps with drawing and presenting the one before.
+ *  There's a small ring of buffers: record() returns the next one, blocking only if the render
+ *  thread is still busy with every other buffer, and submit() queues it for execution.
+ *
+ *  From the moment the RenderThread exists until it is destroyed, no other thread may call the
+ *  renderer directly; anything that needs it goes in a buffer, as a callback if nothing else fits.
+ *  finish() waits until everything submitted has been executed, after which the caller may use the
+ *  renderer again until the next submit().
+ *
+ *  When not threaded, submit() just executes the buffer on the calling thread, which is useful for
+ *  debugging and for renderers that can't be used from a second thread.
+ *
+ *  Given a FrameCapture, every buffer is written to it as it's executed, along with how long
+ *  executing it took. The capture is used from the render thread, so it can only be changed while
+ *  nothing is submitted, and has to outlive the RenderThread. The same goes for a TileRasterizer,
+ *  which every buffer's sprites are then drawn through.
+ *
+ */
+
+class RenderThread {
+public:
+	RenderThread(SDL_Renderer *renderer, bool threaded, std::size_t bufferCount = 2);
+	RenderThread(const RenderThread&) = delete;
+	RenderThread& operator=(const RenderThread&) = delete;
+
+	// Executes everything already submitted, then stops the thread
+	~RenderThread();
+
+	CommandBuffer& record();
+	void submit();
+	void finish();
+
+	bool threaded() const { return thread.joinable(); }
+
+	void setCapture(FrameCapture *frameCapture) { capture = frameCapture; }
+	void setRasterizer(TileRasterizer *tileRasterizer) { rasterizer = tileRasterizer; }
+
+private:
+	void renderMain();
+	void execute(CommandBuffer& buffer);
+
+	SDL_Renderer *renderer;
+	FrameCapture *capture = nullptr;
+	TileRasterizer *rasterizer = nullptr;
+	std::vector<std::unique_ptr<CommandBuffer>> buffers;
+	std::vector<bool> busy;
+	std::size_t next = 0;
+	std::size_t pending = 0;
+	bool stopping = false;
+	bool openGL = false;
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::thread thread;
+};
@@ -0,0 +1,135 @@
+#include "RendererCaps.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "Log.h"
+
+namespace {
+	// Fastest first; drivers not listed rank after these and before the software renderer
+	const char *const PREFERRED_DRIVERS[] = {
+#if defined(_WIN32)
+		"direct3d11", "direct3d12", "direct3d", "opengl", "opengles2"
+#elif defined(__APPLE__)
+		"metal", "opengl", "opengles2"
+#else
+		"opengl", "opengles2", "opengles"
+#endif
+	};
+
+	const auto DRIVER_COUNT = sizeof(PREFERRED_DRIVERS) / sizeof(PREFERRED_DRIVERS[0]);
+
+	std::size_t driverRank(const RendererCaps& driver) {
+		if ((driver.name == "software") || !driver.accelerated()) {
+			return DRIVER_COUNT + 1;
+		}
+
+		const auto found = std::find_if(std::begin(PREFERRED_DRIVERS), std::end(PREFERRED_DRIVERS), [&](const char *name) {
+			return driver.name == name;
+		});
+
+		return static_cast<std::size_t>(found - std::begin(PREFERRED_DRIVERS));
+	}
+}
+
+bool RendererCaps::supportsFormat(Uint32 format) const {
+	return std::find(formats.begin(), formats.end(), format) != formats.end();
+}
+
+int RendererCaps::fitTextureSize(int preferred) const {
+	const auto limit = std::min(maxTextureWidth > 0 ? maxTextureWidth : preferred, maxTextureHeight > 0 ? maxTextureHeight : preferred);
+
+	return std::min(preferred, limit);
+}
+
+RendererCaps rendererCaps(const SDL_RendererInfo& info) {
+	RendererCaps caps;
+
+	caps.name = info.name ? info.name : "";
+	caps.flags = info.flags;
+	caps.maxTextureWidth = info.max_texture_width;
+	caps.maxTextureHeight = info.max_texture_height;
+	caps.formats.assign(info.texture_formats, info.texture_formats + std::min<Uint32>(info.num_texture_formats, 16));
+
+	return caps;
+}
+
+std::vector<RendererCaps> renderDrivers() {
+	std::vector<RendererCaps> drivers;
+	const auto count = SDL_GetNumRenderDrivers();
+
+	for (auto i = 0; i < count; ++i) {
+		SDL_RendererInfo info;
+
+		if (SDL_GetRenderDriverInfo(i, &info) != 0) {
+			LogSDLError(std::cerr, "GetRenderDriverInfo");
+
+			// Keep the slot, so positions still line up with driver indices
+			drivers.emplace_back();
+			continue;
+		}
+
+		drivers.push_back(rendererCaps(info));
+	}
+
+	return drivers;
+}
+
+int chooseRenderDriver(const std::vector<RendererCaps>& drivers, const std::string& requested) {
+	if (!requested.empty()) {
+		for (std::size_t i = 0; i < drivers.size(); ++i) {
+			if (drivers[i].name == requested) {
+				return static_cast<int>(i);
+			}
+		}
+
+		std::cerr << "Render driver " << requested << " is not available, choosing one instead\n";
+	}
+
+	auto best = -1;
+	auto bestRank = DRIVER_COUNT + 2;
+
+	for (std::size_t i = 0; i < drivers.size(); ++i) {
+		if (drivers[i].name.empty()) {
+			continue;
+		}
+
+		const auto rank = driverRank(drivers[i]);
+
+		// Strictly better only, so ties go to the driver SDL lists first
+		if (rank < bestRank) {
+			best = static_cast<int>(i);
+			bestRank = rank;
+		}
+	}
+
+	return best;
+}
+
+bool probeRenderer(SDL_Renderer *renderer, RendererCaps& caps) {
+	SDL_RendererInfo info;
+
+	if (SDL_GetRendererInfo(renderer, &info) != 0) {
+		LogSDLError(std::cerr, "GetRendererInfo");
+		return false;
+	}
+
+	caps = rendererCaps(info);
+	return true;
+}
+
+void printRendererCaps(std::ostream& os, const RendererCaps& caps) {
+	os << caps.name << (caps.accelerated() ? ", accelerated" : "") << (caps.targetTextures() ? ", render targets" : "");
+
+	if ((caps.maxTextureWidth > 0) || (caps.maxTextureHeight > 0)) {
+		os << ", max texture " << caps.maxTextureWidth << 'x' << caps.maxTextureHeight;
+	}
+
+	os << ", formats:";
+
+	for (const auto format : caps.formats) {
+		os << ' ' << SDL_GetPixelFormatName(format);
+	}
+
+	os << '\n';
+}
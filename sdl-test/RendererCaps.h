@@ -0,0 +1,59 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+/** Struct: RendererCaps
+ *
+ *  Description:
+ *  What a render driver (or a renderer created from one) says it can do: its name and flags, the
+ *  largest texture it accepts and the texture formats it handles natively. Textures in any other
+ *  format still work, but SDL converts their pixels on every upload.
+ *
+ *  A maximum texture size of 0 means the driver doesn't report a limit.
+ *
+ */
+
+struct RendererCaps {
+	std::string name;
+	Uint32 flags = 0;
+	int maxTextureWidth = 0;
+	int maxTextureHeight = 0;
+	std::vector<Uint32> formats;
+
+	bool accelerated() const { return (flags & SDL_RENDERER_ACCELERATED) != 0; }
+	bool targetTextures() const { return (flags & SDL_RENDERER_TARGETTEXTURE) != 0; }
+
+	bool supportsFormat(Uint32 format) const;
+
+	// The preferred size, shrunk to the largest square texture the renderer allows
+	int fitTextureSize(int preferred) const;
+};
+
+RendererCaps rendererCaps(const SDL_RendererInfo& info);
+
+// Every render driver compiled into SDL, in SDL's own order, so positions are driver indices
+std::vector<RendererCaps> renderDrivers();
+
+/** Function: chooseRenderDriver
+ *
+ *  Description:
+ *  Picks the driver index to create the renderer with. A requested driver (by name, e.g. from the
+ *  command line) wins whenever it exists. Otherwise drivers are ranked by a per-platform order of
+ *  which backends are usually fastest there: Direct3D 11 on Windows, Metal on macOS, OpenGL
+ *  elsewhere, and the software renderer always last. Leaving it to SDL picks whichever driver is
+ *  listed first, which isn't always the fastest one available.
+ *
+ *  Returns -1, letting SDL choose, if there are no drivers at all.
+ *
+ */
+
+int chooseRenderDriver(const std::vector<RendererCaps>& drivers, const std::string& requested);
+
+// Fills in the capabilities of a renderer that has been created
+bool probeRenderer(SDL_Renderer *renderer, RendererCaps& caps);
+
+void printRendererCaps(std::ostream& os, const RendererCaps& caps);
@@ -0,0 +1,118 @@
+#include "RetainedLayer.h"
+
+#include "Log.h"
+#include "Profiler.h"
+#include "RenderStats.h"
+
+namespace {
+	// Past this many separate regions, tracking them costs more than redrawing their bounds
+	const std::size_t MAX_DIRTY_REGIONS = 16;
+
+	std::size_t area(const SDL_Rect& rect) {
+		return static_cast<std::size_t>(rect.w) * static_cast<std::size_t>(rect.h);
+	}
+}
+
+RetainedLayer::RetainedLayer(SDL_Renderer *renderer, int width, int height, bool opaque)
+	: renderer(renderer), bounds { 0, 0, width, height }, opaque(opaque) {
+	if (!SDL_RenderTargetSupported(renderer)) {
+		return;
+	}
+
+	texture.reset(SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width, height));
+
+	if (!texture) {
+		LogSDLError(std::cerr, "CreateTexture");
+		return;
+	}
+
+	SDL_SetTextureBlendMode(texture.get(), opaque ? SDL_BLENDMODE_NONE : SDL_BLENDMODE_BLEND);
+	invalidate();
+}
+
+void RetainedLayer::invalidate() {
+	dirtyRegions.assign(1, bounds);
+}
+
+void RetainedLayer::markDirty(const SDL_Rect& region) {
+	SDL_Rect clipped;
+
+	if (!SDL_IntersectRect(&region, &bounds, &clipped)) {
+		return;
+	}
+
+	// Fold the new region into any it touches, repeating since the union can reach further ones
+	for (auto i = dirtyRegions.size(); i-- > 0;) {
+		if (SDL_HasIntersection(&dirtyRegions[i], &clipped)) {
+			SDL_UnionRect(&dirtyRegions[i], &clipped, &clipped);
+
+			dirtyRegions[i] = dirtyRegions.back();
+			dirtyRegions.pop_back();
+			i = dirtyRegions.size();
+		}
+	}
+
+	dirtyRegions.push_back(clipped);
+
+	if (dirtyRegions.size() > MAX_DIRTY_REGIONS) {
+		auto combined = dirtyRegions.front();
+
+		for (const auto& dirtyRegion : dirtyRegions) {
+			SDL_UnionRect(&combined, &dirtyRegion, &combined);
+		}
+
+		dirtyRegions.assign(1, combined);
+	}
+}
+
+void RetainedLayer::update(const std::function<void(const SDL_Rect&)>& redraw) {
+	lastRedrawn = 0;
+
+	if (!texture || dirtyRegions.empty()) {
+		return;
+	}
+
+	PROFILE_SCOPE("RetainedLayer::update");
+
+	// Leave the renderer's draw state the way we found it
+	SDL_Texture *previousTarget = SDL_GetRenderTarget(renderer);
+	SDL_BlendMode previousBlend;
+	SDL_Rect previousClip;
+	Uint8 r, g, b, a;
+
+	SDL_GetRenderDrawBlendMode(renderer, &previousBlend);
+	SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+	SDL_RenderGetClipRect(renderer, &previousClip);
+
+	const auto clipped = SDL_RenderIsClipEnabled(renderer);
+
+	SDL_SetRenderTarget(renderer, texture.get());
+
+	for (const auto& region : dirtyRegions) {
+		SDL_RenderSetClipRect(renderer, &region);
+
+		// Wipe the region first; transparent layers must not keep what was there before
+		SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+		SDL_SetRenderDrawColor(renderer, 0, 0, 0, opaque ? 255 : 0);
+		SDL_RenderFillRect(renderer, &region);
+
+		redraw(region);
+
+		lastRedrawn += area(region);
+	}
+
+	SDL_RenderSetClipRect(renderer, NULL);
+	SDL_SetRenderTarget(renderer, previousTarget);
+	SDL_RenderSetClipRect(renderer, clipped ? &previousClip : NULL);
+	SDL_SetRenderDrawColor(renderer, r, g, b, a);
+	SDL_SetRenderDrawBlendMode(renderer, previousBlend);
+
+	dirtyRegions.clear();
+}
+
+void RetainedLayer::composite() {
+	if (texture) {
+		SDL_RenderCopy(renderer, texture.get(), NULL, NULL);
+		RenderStats::instance().countDraw(texture.get(), 4);
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+#include "SDLHandles.h"
+
+/** Class: RetainedLayer
+ *
+ *  Description:
+ *  Keeps content that rarely changes in its own render-target texture. Drawing code marks the
+ *  regions that changed with markDirty(); update() then redraws only those regions into the layer,
+ *  clipped to each one, and composite() copies the whole layer to the current render target. A
+ *  screen that's mostly static costs one full-screen copy per frame plus whatever actually changed.
+ *
+ *  The redraw callback is handed the region being redrawn and should draw everything that overlaps
+ *  it; anything outside is clipped. Dirty regions that overlap are merged, and past a handful of
+ *  them the layer simply redraws their bounding box.
+ *
+ *  If the renderer can't create render targets the layer is invalid, and callers should fall
+ *  back to drawing the content directly every frame.
+ *
+ */
+
+class RetainedLayer {
+public:
+	RetainedLayer(SDL_Renderer *renderer, int width, int height, bool opaque);
+	RetainedLayer(const RetainedLayer&) = delete;
+	RetainedLayer& operator=(const RetainedLayer&) = delete;
+
+	bool valid() const { return texture != nullptr; }
+
+	void invalidate();
+	void markDirty(const SDL_Rect& region);
+	bool dirty() const { return !dirtyRegions.empty(); }
+
+	void update(const std::function<void(const SDL_Rect&)>& redraw);
+	void composite();
+
+	// Pixels redrawn by the most recent update(), for judging how much the layer is saving
+	std::size_t redrawnPixels() const { return lastRedrawn; }
+
+private:
+	SDL_Renderer *renderer;
+	TexturePtr texture;
+	SDL_Rect bounds;
+	bool opaque;
+	std::vector<SDL_Rect> dirtyRegions;
+	std::size_t lastRedrawn = 0;
+};
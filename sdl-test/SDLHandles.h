@@ -0,0 +1,56 @@
+#pragma once
+
+#include <memory>
+
+#include <SDL/SDL.h>
+
+/** RAII handles for SDL objects
+ *
+ *  Description:
+ *  Every SDL object we create is owned by one of these move-only handles, which calls the matching
+ *  SDL_DestroyX/SDL_FreeSurface when it goes out of scope. That way early returns can't leak, and
+ *  SDL objects can be kept in containers and moved around without anyone having to remember who
+ *  destroys them. Use .get() to pass the raw pointer to SDL functions.
+ *
+ *  Textures still have to go before the renderer that created them, which falls out naturally as
+ *  long as the renderer handle is declared first.
+ *
+ */
+
+struct SDLDeleter {
+	void operator()(SDL_Window *window) const { SDL_DestroyWindow(window); }
+	void operator()(SDL_Renderer *renderer) const { SDL_DestroyRenderer(renderer); }
+	void operator()(SDL_Texture *texture) const { SDL_DestroyTexture(texture); }
+	void operator()(SDL_Surface *surface) const { SDL_FreeSurface(surface); }
+};
+
+using WindowPtr = std::unique_ptr<SDL_Window, SDLDeleter>;
+using RendererPtr = std::unique_ptr<SDL_Renderer, SDLDeleter>;
+using TexturePtr = std::unique_ptr<SDL_Texture, SDLDeleter>;
+using SurfacePtr = std::unique_ptr<SDL_Surface, SDLDeleter>;
+
+/** Class: SDLContext
+ *
+ *  Description:
+ *  Initializes the requested SDL subsystems and calls SDL_Quit when it goes away. Declare it before
+ *  any other SDL handle so it's the last thing destroyed.
+ *
+ */
+
+class SDLContext {
+public:
+	explicit SDLContext(Uint32 flags) : initialized(SDL_Init(flags) == 0) {}
+	SDLContext(const SDLContext&) = delete;
+	SDLContext& operator=(const SDLContext&) = delete;
+
+	~SDLContext() {
+		if (initialized) {
+			SDL_Quit();
+		}
+	}
+
+	explicit operator bool() const { return initialized; }
+
+private:
+	bool initialized;
+};
@@ -0,0 +1,166 @@
+#include "SpatialGrid.h"
+
+#include <algorithm>
+
+#include "Profiler.h"
+
+SpatialGrid::SpatialGrid(int size) : cellSize(std::max(size, 1)) {
+}
+
+int SpatialGrid::cellOf(int coordinate) const {
+	// Floor division, so negative coordinates land in negative cells rather than folding onto cell 0
+	return (coordinate >= 0) ? coordinate / cellSize : -((-coordinate + cellSize - 1) / cellSize);
+}
+
+SpatialGrid::CellRange SpatialGrid::cellRange(const SDL_Rect& bounds) const {
+	// Empty rectangles still occupy the cell they sit in, so they can be found by point queries
+	return CellRange {
+		cellOf(bounds.x),
+		cellOf(bounds.y),
+		cellOf(bounds.x + std::max(bounds.w, 1) - 1),
+		cellOf(bounds.y + std::max(bounds.h, 1) - 1)
+	};
+}
+
+void SpatialGrid::link(SpatialId id, const CellRange& range) {
+	for (auto row = range.top; row <= range.bottom; ++row) {
+		for (auto column = range.left; column <= range.right; ++column) {
+			cells[cellKey(column, row)].push_back(id);
+		}
+	}
+}
+
+void SpatialGrid::unlink(SpatialId id, const CellRange& range) {
+	for (auto row = range.top; row <= range.bottom; ++row) {
+		for (auto column = range.left; column <= range.right; ++column) {
+			const auto cell = cells.find(cellKey(column, row));
+
+			if (cell == cells.end()) {
+				continue;
+			}
+
+			auto& ids = cell->second;
+			const auto found = std::find(ids.begin(), ids.end(), id);
+
+			if (found != ids.end()) {
+				*found = ids.back();
+				ids.pop_back();
+			}
+
+			if (ids.empty()) {
+				cells.erase(cell);
+			}
+		}
+	}
+}
+
+void SpatialGrid::insert(SpatialId id, const SDL_Rect& bounds) {
+	if (contains(id)) {
+		update(id, bounds);
+		return;
+	}
+
+	if (id >= entries.size()) {
+		entries.resize(id + 1, Entry { SDL_Rect {}, CellRange {}, false });
+	}
+
+	auto& entry = entries[id];
+	entry.bounds = bounds;
+	entry.cells = cellRange(bounds);
+	entry.live = true;
+
+	link(id, entry.cells);
+	++liveCount;
+}
+
+void SpatialGrid::update(SpatialId id, const SDL_Rect& bounds) {
+	if (!contains(id)) {
+		insert(id, bounds);
+		return;
+	}
+
+	auto& entry = entries[id];
+	const auto range = cellRange(bounds);
+
+	entry.bounds = bounds;
+
+	if ((range.left == entry.cells.left) && (range.top == entry.cells.top) &&
+		(range.right == entry.cells.right) && (range.bottom == entry.cells.bottom)) {
+		return;
+	}
+
+	unlink(id, entry.cells);
+	link(id, range);
+	entry.cells = range;
+}
+
+void SpatialGrid::remove(SpatialId id) {
+	if (!contains(id)) {
+		return;
+	}
+
+	unlink(id, entries[id].cells);
+	entries[id].live = false;
+	--liveCount;
+}
+
+void SpatialGrid::clear() {
+	cells.clear();
+	entries.clear();
+	liveCount = 0;
+}
+
+void SpatialGrid::query(const SDL_Rect& area, std::vector<SpatialId>& results) const {
+	PROFILE_SCOPE("SpatialGrid::query");
+
+	if ((area.w <= 0) || (area.h <= 0) || cells.empty()) {
+		return;
+	}
+
+	const auto range = cellRange(area);
+
+	for (auto row = range.top; row <= range.bottom; ++row) {
+		for (auto column = range.left; column <= range.right; ++column) {
+			const auto cell = cells.find(cellKey(column, row));
+
+			if (cell == cells.end()) {
+				continue;
+			}
+
+			for (const auto id : cell->second) {
+				const auto& bounds = entries[id].bounds;
+
+				// Overlap of the object with the query area; empty objects count if they sit inside it
+				const auto left = std::max(bounds.x, area.x);
+				const auto top = std::max(bounds.y, area.y);
+				const auto right = std::min(bounds.x + std::max(bounds.w, 1), area.x + area.w);
+				const auto bottom = std::min(bounds.y + std::max(bounds.h, 1), area.y + area.h);
+
+				if ((left >= right) || (top >= bottom)) {
+					continue;
+				}
+
+				// Report it from one cell only, whichever holds the overlap's top-left corner
+				if ((cellOf(left) == column) && (cellOf(top) == row)) {
+					results.push_back(id);
+				}
+			}
+		}
+	}
+}
+
+void SpatialGrid::queryPoint(int x, int y, std::vector<SpatialId>& results) const {
+	const auto cell = cells.find(cellKey(cellOf(x), cellOf(y)));
+
+	if (cell == cells.end()) {
+		return;
+	}
+
+	for (const auto id : cell->second) {
+		const auto& bounds = entries[id].bounds;
+
+		if ((x >= bounds.x) && (y >= bounds.y) && (x < bounds.x + bounds.w) && (y < bounds.y + bounds.h)) {
+			results.push_back(id);
+		}
+	}
+}
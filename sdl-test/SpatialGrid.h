@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+// Ids are chosen by the caller and should be small and dense, e.g. indices into a sprite array
+using SpatialId = Uint32;
+
+/** Class: SpatialGrid
+ *
+ *  Description:
+ *  A uniform grid over an unbounded world, for finding what overlaps a rectangle or a point without
+ *  testing everything. Each object is listed in every cell its bounds touch; cells are kept in a
+ *  hash map, so only cells with something in them cost memory.
+ *
+ *  update() only touches the cell lists when an object moves into a different set of cells, which
+ *  for objects smaller than a cell is rare, so moving thousands of objects a frame stays cheap.
+ *
+ *  An object spanning several cells is reported once per query: only by the cell holding the
+ *  top-left corner of its overlap with the query area. Queries don't modify the grid, so any
+ *  number of them may run at once as long as nothing is inserted, updated or removed meanwhile.
+ *
+ *  The cell size should be around the size of a typical object; much smaller and objects are
+ *  listed in many cells, much larger and queries test too many objects they don't overlap.
+ *
+ */
+
+class SpatialGrid {
+public:
+	explicit SpatialGrid(int cellSize = 128);
+
+	void insert(SpatialId id, const SDL_Rect& bounds);
+	void update(SpatialId id, const SDL_Rect& bounds);
+	void remove(SpatialId id);
+	void clear();
+
+	bool contains(SpatialId id) const { return (id < entries.size()) && entries[id].live; }
+	const SDL_Rect& bounds(SpatialId id) const { return entries[id].bounds; }
+	std::size_t size() const { return liveCount; }
+
+	// Appends every object overlapping the area; results are in no particular order
+	void query(const SDL_Rect& area, std::vector<SpatialId>& results) const;
+
+	// Appends every object whose bounds contain the point
+	void queryPoint(int x, int y, std::vector<SpatialId>& results) const;
+
+private:
+	struct CellRange {
+		int left;
+		int top;
+		int right;
+		int bottom;
+	};
+
+	struct Entry {
+		SDL_Rect bounds;
+		CellRange cells;
+		bool live;
+	};
+
+	CellRange cellRange(const SDL_Rect& bounds) const;
+	int cellOf(int coordinate) const;
+	void link(SpatialId id, const CellRange& range);
+	void unlink(SpatialId id, const CellRange& range);
+
+	static Uint64 cellKey(int column, int row) {
+		return (static_cast<Uint64>(static_cast<Uint32>(column)) << 32) | static_cast<Uint32>(row);
+	}
+
+	int cellSize;
+	std::unordered_map<Uint64, std::vector<SpatialId>> cells;
+	std::vector<Entry> entries;
+	std::size_t liveCount = 0;
+};
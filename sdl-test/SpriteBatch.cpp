@@ -0,0 +1,261 @@
+#include "SpriteBatch.h"
+
+#include <algorithm>
+
+#include "CommandBuffer.h"
+#include "Profiler.h"
+#include "RenderStats.h"
+#include "TextureAtlas.h"
+#include "TextureCache.h"
+#include "TileRasterizer.h"
+
+namespace {
+	// Sort key layout, most significant first: layer | blend mode | texture | submission order
+	const auto LAYER_SHIFT = 52;
+	const auto BLEND_SHIFT = 48;
+	const auto TEXTURE_SHIFT = 32;
+	const Uint64 TEXTURE_MASK = 0xFFFF;
+	const Uint64 SEQUENCE_MASK = 0xFFFFFFFF;
+
+	Uint64 blendOrder(SDL_BlendMode mode) {
+		switch (mode) {
+			case SDL_BLENDMODE_NONE:  return 0;
+			case SDL_BLENDMODE_BLEND: return 1;
+			case SDL_BLENDMODE_ADD:   return 2;
+			case SDL_BLENDMODE_MOD:   return 3;
+			default:                  return 4;
+		}
+	}
+
+	Uint32 textureOf(Uint64 key) {
+		return static_cast<Uint32>((key >> TEXTURE_SHIFT) & TEXTURE_MASK);
+	}
+}
+
+SpriteBatch::SpriteBatch(SDL_Renderer *renderer) : renderer(renderer) {
+	attachToArena(textures, arena, 0);
+	attachToArena(sprites, arena, 0);
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	attachToArena(vertices, arena, 0);
+#endif
+}
+
+void SpriteBatch::begin() {
+	// Room for as much as the last batch needed, so steady-state batches never grow
+	const auto textureCount = detachFromArena(textures);
+	const auto spriteCount = std::max(detachFromArena(sprites), lastSpriteCount);
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	const auto vertexCount = detachFromArena(vertices);
+#endif
+
+	arena.reset();
+
+	attachToArena(textures, arena, textureCount);
+	attachToArena(sprites, arena, spriteCount);
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	attachToArena(vertices, arena, vertexCount);
+#endif
+
+	lastTexture = 0;
+	batchStats = SpriteBatchStats {};
+}
+
+void SpriteBatch::draw(SDL_Texture *texture, int x, int y, int layer) {
+	const auto index = lookup(texture, -1, -1);
+	const auto& info = textures[index];
+
+	push(index, SDL_Rect { 0, 0, info.width, info.height }, SDL_Rect { x, y, info.width, info.height }, layer);
+}
+
+void SpriteBatch::draw(SDL_Texture *texture, const SDL_Rect *source, const SDL_Rect& destination, int layer) {
+	const auto index = lookup(texture, -1, -1);
+	const auto& info = textures[index];
+
+	push(index, source ? *source : SDL_Rect { 0, 0, info.width, info.height }, destination, layer);
+}
+
+void SpriteBatch::draw(const TextureEntry& texture, int x, int y, int layer) {
+	// Entries already know their size, so there's no need to ask the renderer
+	const auto index = lookup(texture.texture.get(), texture.width, texture.height);
+
+	push(index, SDL_Rect { 0, 0, texture.width, texture.height }, SDL_Rect { x, y, texture.width, texture.height }, layer);
+}
+
+void SpriteBatch::draw(const AtlasRegion& region, int x, int y, int layer) {
+	push(lookup(region.texture, -1, -1), region.rect, SDL_Rect { x, y, region.rect.w, region.rect.h }, layer);
+}
+
+void SpriteBatch::draw(const AtlasRegion& region, const SDL_Rect& destination, int layer) {
+	push(lookup(region.texture, -1, -1), region.rect, destination, layer);
+}
+
+Uint32 SpriteBatch::lookup(SDL_Texture *texture, int width, int height) {
+	// Sprites usually arrive in runs of the same texture, so check the last one first
+	if ((lastTexture < textures.size()) && (textures[lastTexture].texture == texture)) {
+		return lastTexture;
+	}
+
+	for (Uint32 i = 0; i < textures.size(); ++i) {
+		if (textures[i].texture == texture) {
+			return lastTexture = i;
+		}
+	}
+
+	TextureInfo info { texture, width, height, SDL_BLENDMODE_NONE };
+
+	if ((width < 0) || (height < 0)) {
+		SDL_QueryTexture(texture, NULL, NULL, &info.width, &info.height);
+	}
+
+	SDL_GetTextureBlendMode(texture, &info.blendMode);
+
+	textures.push_back(info);
+	return lastTexture = static_cast<Uint32>(textures.size() - 1);
+}
+
+void SpriteBatch::push(Uint32 textureIndex, const SDL_Rect& source, const SDL_Rect& destination, int layer) {
+	// Biased so the key's 12 bits sort negative layers before positive ones
+	const auto biasedLayer = std::min(std::max(layer, SPRITE_LAYER_MIN), SPRITE_LAYER_MAX) - SPRITE_LAYER_MIN;
+
+	const auto key = (static_cast<Uint64>(biasedLayer) << LAYER_SHIFT)
+		| (blendOrder(textures[textureIndex].blendMode) << BLEND_SHIFT)
+		| ((textureIndex & TEXTURE_MASK) << TEXTURE_SHIFT)
+		| (sprites.size() & SEQUENCE_MASK);
+
+	sprites.push_back(Sprite { key, source, destination });
+}
+
+void SpriteBatch::flush() {
+	if (sprites.empty()) {
+		return;
+	}
+
+	PROFILE_SCOPE("SpriteBatch::flush");
+
+	// Callers that already submit in key order (like SpriteStore) only pay for the check
+	const auto byKey = [](const Sprite& a, const Sprite& b) { return a.key < b.key; };
+
+	if (!std::is_sorted(sprites.begin(), sprites.end(), byKey)) {
+		std::sort(sprites.begin(), sprites.end(), byKey);
+	}
+
+	batchStats.sprites += sprites.size();
+	lastSpriteCount = sprites.size();
+
+	// Every run of sprites that share a texture becomes one submission
+	std::size_t first = 0;
+
+	for (std::size_t i = 1; i <= sprites.size(); ++i) {
+		if ((i == sprites.size()) || (textureOf(sprites[i].key) != textureOf(sprites[first].key))) {
+			submitRun(first, i);
+			++batchStats.textureSwitches;
+			first = i;
+		}
+	}
+
+	sprites.clear();
+}
+
+void SpriteBatch::flush(CommandBuffer& commands) {
+	recording = &commands;
+	flush();
+	recording = nullptr;
+}
+
+void SpriteBatch::flush(TileRasterizer& rasterizer) {
+	rasterizing = &rasterizer;
+	flush();
+	rasterizing = nullptr;
+}
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+
+void SpriteBatch::submitRun(std::size_t first, std::size_t last) {
+	PROFILE_SCOPE("SpriteBatch::submitRun");
+
+	const auto count = last - first;
+
+	// The index pattern is the same for every run, so it only needs to grow, never be rebuilt
+	for (auto quad = indices.size() / 6; quad < count; ++quad) {
+		const auto base = static_cast<int>(quad * 4);
+		const int pattern[] = { base, base + 1, base + 2, base + 2, base + 3, base };
+
+		indices.insert(indices.end(), pattern, pattern + 6);
+	}
+
+	vertices.resize(count * 4);
+
+	const auto& info = textures[textureOf(sprites[first].key)];
+
+	const auto inverseWidth = 1.0f / std::max(info.width, 1);
+	const auto inverseHeight = 1.0f / std::max(info.height, 1);
+	const SDL_Color white { 255, 255, 255, 255 };
+
+	auto *vertex = vertices.data();
+
+	for (auto i = first; i < last; ++i) {
+		const auto& source = sprites[i].source;
+		const auto& destination = sprites[i].destination;
+
+		const auto x0 = static_cast<float>(destination.x);
+		const auto y0 = static_cast<float>(destination.y);
+		const auto x1 = static_cast<float>(destination.x + destination.w);
+		const auto y1 = static_cast<float>(destination.y + destination.h);
+
+		const auto u0 = source.x * inverseWidth;
+		const auto v0 = source.y * inverseHeight;
+		const auto u1 = (source.x + source.w) * inverseWidth;
+		const auto v1 = (source.y + source.h) * inverseHeight;
+
+		*vertex++ = SDL_Vertex { { x0, y0 }, white, { u0, v0 } };
+		*vertex++ = SDL_Vertex { { x1, y0 }, white, { u1, v0 } };
+		*vertex++ = SDL_Vertex { { x1, y1 }, white, { u1, v1 } };
+		*vertex++ = SDL_Vertex { { x0, y1 }, white, { u0, v1 } };
+	}
+
+	if (recording) {
+		recording->drawQuads(info.texture, vertices.data(), count * 4);
+	} else if (!rasterizing || !rasterizing->drawQuads(info.texture, vertices.data(), count * 4)) {
+		SDL_RenderGeometry(renderer, info.texture, vertices.data(), static_cast<int>(count * 4), indices.data(), static_cast<int>(count * 6));
+		RenderStats::instance().countDraw(info.texture, count * 4);
+	}
+
+	++batchStats.drawCalls;
+}
+
+#else
+
+void SpriteBatch::submitRun(std::size_t first, std::size_t last) {
+	PROFILE_SCOPE("SpriteBatch::submitRun");
+
+	SDL_Texture *texture = textures[textureOf(sprites[first].key)].texture;
+
+	// Without SDL_RenderGeometry each sprite is its own copy; SDL 2.0.10+ still batches these internally.
+	// Where the copies go is the same for the whole run, so it's decided once rather than per sprite
+	if (recording) {
+		for (auto i = first; i < last; ++i) {
+			recording->copy(texture, &sprites[i].source, &sprites[i].destination);
+		}
+	} else if (rasterizing) {
+		for (auto i = first; i < last; ++i) {
+			if (!rasterizing->copy(texture, &sprites[i].source, &sprites[i].destination)) {
+				SDL_RenderCopy(renderer, texture, &sprites[i].source, &sprites[i].destination);
+				RenderStats::instance().countDraw(texture, 4);
+			}
+		}
+	} else {
+		auto& stats = RenderStats::instance();
+
+		for (auto i = first; i < last; ++i) {
+			SDL_RenderCopy(renderer, texture, &sprites[i].source, &sprites[i].destination);
+			stats.countDraw(texture, 4);
+		}
+	}
+
+	batchStats.drawCalls += last - first;
+}
+
+#endif
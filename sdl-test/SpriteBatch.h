@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+#include "FrameArena.h"
+
+class CommandBuffer;
+class TileRasterizer;
+struct AtlasRegion;
+struct TextureEntry;
+
+// The layers a sprite can be drawn in; anything outside the range is clamped to it
+const int SPRITE_LAYER_MIN = -2048;
+const int SPRITE_LAYER_MAX = 2047;
+
+struct SpriteBatchStats {
+	std::size_t sprites = 0;
+	std::size_t drawCalls = 0;
+	std::size_t textureSwitches = 0;
+};
+
+/** Class: SpriteBatch
+ *
+ *  Description:
+ *  Collects every sprite drawn between begin() and flush(), sorts them so that sprites sharing a
+ *  texture and blend mode end up next to each other, and submits each run with a single call to
+ *  SDL_RenderGeometry. On SDL versions older than 2.0.18, which don't have SDL_RenderGeometry, the
+ *  sorted sprites are submitted one SDL_RenderCopy at a time instead.
+ *
+ *  Sorting would normally break the painter's algorithm, so every sprite carries a layer: sprites
+ *  in a lower layer are always drawn before sprites in a higher one, and within a layer sprites
+ *  are assumed not to depend on each other's order unless they share a texture. Layers may be
+ *  negative, down to SPRITE_LAYER_MIN, so things can go behind layer 0 without renumbering it.
+ *
+ *  Texture sizes and blend modes are queried at most once per texture per batch. Everything a
+ *  batch collects lives in its own frame arena, which begin() resets.
+ *
+ *  flush(commands) records the same calls into a command buffer instead of making them, so a batch
+ *  can be built on a thread that doesn't own the renderer. Drawing only reads texture properties,
+ *  which is safe while the render thread is using the renderer. flush(rasterizer) draws the batch
+ *  on the CPU through a TileRasterizer instead, falling back to the renderer for any run the
+ *  rasterizer turns down; the rasterizer still needs flushing itself afterwards.
+ *
+ */
+
+class SpriteBatch {
+public:
+	explicit SpriteBatch(SDL_Renderer *renderer);
+	SpriteBatch(const SpriteBatch&) = delete;
+	SpriteBatch& operator=(const SpriteBatch&) = delete;
+
+	void begin();
+
+	void draw(SDL_Texture *texture, int x, int y, int layer = 0);
+	void draw(SDL_Texture *texture, const SDL_Rect *source, const SDL_Rect& destination, int layer = 0);
+	void draw(const TextureEntry& texture, int x, int y, int layer = 0);
+	void draw(const AtlasRegion& region, int x, int y, int layer = 0);
+	void draw(const AtlasRegion& region, const SDL_Rect& destination, int layer = 0);
+
+	void flush();
+	void flush(CommandBuffer& commands);
+	void flush(TileRasterizer& rasterizer);
+
+	const SpriteBatchStats& stats() const { return batchStats; }
+
+private:
+	struct TextureInfo {
+		SDL_Texture *texture;
+		int width;
+		int height;
+		SDL_BlendMode blendMode;
+	};
+
+	struct Sprite {
+		Uint64 key;
+		SDL_Rect source;
+		SDL_Rect destination;
+	};
+
+	Uint32 lookup(SDL_Texture *texture, int width, int height);
+	void push(Uint32 textureIndex, const SDL_Rect& source, const SDL_Rect& destination, int layer);
+	void submitRun(std::size_t first, std::size_t last);
+
+	SDL_Renderer *renderer;
+	FrameArena arena;
+	ArenaVector<TextureInfo> textures;
+	ArenaVector<Sprite> sprites;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	ArenaVector<SDL_Vertex> vertices;
+	std::vector<int> indices;
+#endif
+
+	std::size_t lastSpriteCount = 0;
+	Uint32 lastTexture = 0;
+	CommandBuffer *recording = nullptr;
+	TileRasterizer *rasterizing = nullptr;
+	SpriteBatchStats batchStats;
+};
@@ -0,0 +1,282 @@
+#include "SpriteStore.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Profiler.h"
+#include "SpatialGrid.h"
+#include "SpriteBatch.h"
+
+namespace {
+	// Layers are stored biased by SPRITE_LAYER_MIN, as the batch sorts them, so they order as unsigned
+	Uint16 storedLayer(int layer) {
+		return static_cast<Uint16>(std::min(std::max(layer, SPRITE_LAYER_MIN), SPRITE_LAYER_MAX) - SPRITE_LAYER_MIN);
+	}
+
+	// Sort word layout, most significant first: layer | texture slot | sprite index
+	const auto LAYER_SHIFT = 48;
+	const auto SLOT_SHIFT = 32;
+	const Uint64 INDEX_MASK = 0xFFFFFFFF;
+}
+
+const std::size_t SpriteStore::INVALID_INDEX;
+
+SpriteId SpriteStore::create(const AtlasRegion& region, float x, float y, int layer) {
+	SpriteId id;
+
+	if (!freeIds.empty()) {
+		id = freeIds.back();
+		freeIds.pop_back();
+	} else {
+		id = static_cast<SpriteId>(indices.size());
+		indices.push_back(INVALID_INDEX);
+	}
+
+	indices[id] = ids.size();
+
+	positionX.push_back(x);
+	positionY.push_back(y);
+	previousX.push_back(x);
+	previousY.push_back(y);
+	speedX.push_back(0.0f);
+	speedY.push_back(0.0f);
+	width.push_back(region.rect.w);
+	height.push_back(region.rect.h);
+	sources.push_back(region.rect);
+	slots.push_back(textureSlot(region.texture));
+	layers.push_back(storedLayer(layer));
+	ids.push_back(id);
+
+	return id;
+}
+
+void SpriteStore::destroy(SpriteId id) {
+	if (!alive(id)) {
+		return;
+	}
+
+	// Move the last sprite into the hole, so the arrays stay dense
+	const auto index = indices[id];
+	const auto last = ids.size() - 1;
+
+	positionX[index] = positionX[last];
+	positionY[index] = positionY[last];
+	previousX[index] = previousX[last];
+	previousY[index] = previousY[last];
+	speedX[index] = speedX[last];
+	speedY[index] = speedY[last];
+	width[index] = width[last];
+	height[index] = height[last];
+	sources[index] = sources[last];
+	slots[index] = slots[last];
+	layers[index] = layers[last];
+	ids[index] = ids[last];
+
+	indices[ids[index]] = index;
+	indices[id] = INVALID_INDEX;
+	freeIds.push_back(id);
+
+	positionX.pop_back();
+	positionY.pop_back();
+	previousX.pop_back();
+	previousY.pop_back();
+	speedX.pop_back();
+	speedY.pop_back();
+	width.pop_back();
+	height.pop_back();
+	sources.pop_back();
+	slots.pop_back();
+	layers.pop_back();
+	ids.pop_back();
+}
+
+void SpriteStore::clear() {
+	positionX.clear();
+	positionY.clear();
+	previousX.clear();
+	previousY.clear();
+	speedX.clear();
+	speedY.clear();
+	width.clear();
+	height.clear();
+	sources.clear();
+	slots.clear();
+	layers.clear();
+	ids.clear();
+	indices.clear();
+	freeIds.clear();
+	textures.clear();
+}
+
+Uint16 SpriteStore::textureSlot(SDL_Texture *texture) {
+	const auto found = std::find(textures.begin(), textures.end(), texture);
+
+	if (found != textures.end()) {
+		return static_cast<Uint16>(found - textures.begin());
+	}
+
+	textures.push_back(texture);
+	return static_cast<Uint16>(textures.size() - 1);
+}
+
+void SpriteStore::setPosition(SpriteId id, float x, float y) {
+	const auto index = indices[id];
+
+	// A teleport, so there's nothing to interpolate from
+	positionX[index] = previousX[index] = x;
+	positionY[index] = previousY[index] = y;
+}
+
+void SpriteStore::setVelocity(SpriteId id, float x, float y) {
+	speedX[indices[id]] = x;
+	speedY[indices[id]] = y;
+}
+
+void SpriteStore::setRegion(SpriteId id, const AtlasRegion& region) {
+	setSource(id, region.rect, textureSlot(region.texture));
+}
+
+void SpriteStore::setSource(SpriteId id, const SDL_Rect& source, Uint16 slot) {
+	const auto index = indices[id];
+
+	width[index] = source.w;
+	height[index] = source.h;
+	sources[index] = source;
+	slots[index] = slot;
+}
+
+void SpriteStore::setLayer(SpriteId id, int layer) {
+	layers[indices[id]] = storedLayer(layer);
+}
+
+SDL_Rect SpriteStore::bounds(SpriteId id) const {
+	const auto index = indices[id];
+
+	return SDL_Rect {
+		static_cast<int>(std::floor(positionX[index])),
+		static_cast<int>(std::floor(positionY[index])),
+		width[index],
+		height[index]
+	};
+}
+
+void SpriteStore::beginStep() {
+	beginStep(0, size());
+}
+
+void SpriteStore::beginStep(std::size_t first, std::size_t last) {
+	std::copy(positionX.begin() + first, positionX.begin() + last, previousX.begin() + first);
+	std::copy(positionY.begin() + first, positionY.begin() + last, previousY.begin() + first);
+}
+
+void SpriteStore::integrate(float dt) {
+	integrate(dt, 0, size());
+}
+
+void SpriteStore::integrate(float dt, std::size_t first, std::size_t last) {
+	auto *x = positionX.data();
+	auto *y = positionY.data();
+	const auto *vx = speedX.data();
+	const auto *vy = speedY.data();
+
+	// Separate loops over plain arrays with no branches; both vectorize
+	for (auto i = first; i < last; ++i) {
+		x[i] += vx[i] * dt;
+	}
+
+	for (auto i = first; i < last; ++i) {
+		y[i] += vy[i] * dt;
+	}
+}
+
+void SpriteStore::bounce(const SDL_Rect& area) {
+	bounce(area, 0, size());
+}
+
+void SpriteStore::bounce(const SDL_Rect& area, std::size_t first, std::size_t last) {
+	auto *x = positionX.data();
+	auto *y = positionY.data();
+	auto *vx = speedX.data();
+	auto *vy = speedY.data();
+
+	const auto left = static_cast<float>(area.x);
+	const auto top = static_cast<float>(area.y);
+	const auto right = static_cast<float>(area.x + area.w);
+	const auto bottom = static_cast<float>(area.y + area.h);
+
+	// Written as selects rather than ifs, so these vectorize as well
+	for (auto i = first; i < last; ++i) {
+		const auto limit = right - static_cast<float>(width[i]);
+
+		vx[i] = (x[i] < left) ? std::abs(vx[i]) : ((x[i] > limit) ? -std::abs(vx[i]) : vx[i]);
+		x[i] = std::min(std::max(x[i], left), std::max(limit, left));
+	}
+
+	for (auto i = first; i < last; ++i) {
+		const auto limit = bottom - static_cast<float>(height[i]);
+
+		vy[i] = (y[i] < top) ? std::abs(vy[i]) : ((y[i] > limit) ? -std::abs(vy[i]) : vy[i]);
+		y[i] = std::min(std::max(y[i], top), std::max(limit, top));
+	}
+}
+
+void SpriteStore::syncGrid(SpatialGrid& grid) const {
+	PROFILE_SCOPE("SpriteStore::syncGrid");
+
+	for (std::size_t i = 0; i < ids.size(); ++i) {
+		grid.update(ids[i], bounds(ids[i]));
+	}
+}
+
+void SpriteStore::push(std::size_t index, const SDL_Rect& camera, float alpha) {
+	const auto x = previousX[index] + (positionX[index] - previousX[index]) * alpha;
+	const auto y = previousY[index] + (positionY[index] - previousY[index]) * alpha;
+
+	const SDL_Point screen { static_cast<int>(std::floor(x)) - camera.x, static_cast<int>(std::floor(y)) - camera.y };
+
+	if ((screen.x >= camera.w) || (screen.y >= camera.h) || (screen.x + width[index] <= 0) || (screen.y + height[index] <= 0)) {
+		return;
+	}
+
+	screenPositions[index] = screen;
+	order.push_back((static_cast<Uint64>(layers[index]) << LAYER_SHIFT) | (static_cast<Uint64>(slots[index]) << SLOT_SHIFT) | index);
+}
+
+void SpriteStore::drawSorted(SpriteBatch& batch) {
+	std::sort(order.begin(), order.end());
+
+	for (const auto word : order) {
+		const auto index = static_cast<std::size_t>(word & INDEX_MASK);
+		const auto& position = screenPositions[index];
+
+		batch.draw(textures[slots[index]], &sources[index], SDL_Rect { position.x, position.y, width[index], height[index] }, layers[index] + SPRITE_LAYER_MIN);
+	}
+}
+
+void SpriteStore::submit(SpriteBatch& batch, const SDL_Rect& camera, float alpha) {
+	PROFILE_SCOPE("SpriteStore::submit");
+
+	order.clear();
+	screenPositions.resize(size());
+
+	for (std::size_t i = 0; i < size(); ++i) {
+		push(i, camera, alpha);
+	}
+
+	drawSorted(batch);
+}
+
+void SpriteStore::submit(SpriteBatch& batch, const SDL_Rect& camera, float alpha, const std::vector<SpriteId>& visible) {
+	PROFILE_SCOPE("SpriteStore::submit");
+
+	order.clear();
+	screenPositions.resize(size());
+
+	for (const auto id : visible) {
+		if (alive(id)) {
+			push(indices[id], camera, alpha);
+		}
+	}
+
+	drawSorted(batch);
+}
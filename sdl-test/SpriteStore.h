@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+#include "TextureAtlas.h"
+
+class SpatialGrid;
+class SpriteBatch;
+
+// Stable name for a sprite; stays valid while the sprite exists, however the arrays are reordered
+using SpriteId = Uint32;
+
+const auto INVALID_SPRITE = SpriteId { 0xFFFFFFFF };
+
+/** Class: SpriteStore
+ *
+ *  Description:
+ *  Holds every sprite's state as parallel arrays (struct of arrays) rather than an array of
+ *  sprite objects: all x positions together, all y positions together, and so on. The bulk
+ *  updates below walk one or two of those arrays from start to finish, which keeps them in cache
+ *  and lets the compiler turn the loops into SIMD code.
+ *
+ *  Sprites are numbered densely from 0 to size() - 1 in the arrays. Destroying a sprite moves the
+ *  last sprite into its place, so array order isn't stable; SpriteIds are, and are what should be
+ *  kept anywhere outside the store (including a SpatialGrid).
+ *
+ *  Positions are floats, in world pixels, and each sprite keeps its position from before the last
+ *  simulation step so submit() can draw it part way between the two.
+ *
+ *  submit() builds one 64-bit sort word per visible sprite, layer and texture in the high half and
+ *  the sprite's index in the low half, sorts those plain integers, and hands the sprites to the
+ *  batch in that order, which is the order the batch would have sorted them into anyway.
+ *
+ *  The range versions of the bulk updates exist so the work can be split across threads; ranges
+ *  that don't overlap can be updated at the same time.
+ *
+ */
+
+class SpriteStore {
+public:
+	SpriteStore() = default;
+	SpriteStore(const SpriteStore&) = delete;
+	SpriteStore& operator=(const SpriteStore&) = delete;
+
+	SpriteId create(const AtlasRegion& region, float x, float y, int layer = 0);
+	void destroy(SpriteId id);
+	void clear();
+
+	bool alive(SpriteId id) const { return (id < indices.size()) && (indices[id] != INVALID_INDEX); }
+	std::size_t size() const { return ids.size(); }
+
+	std::size_t indexOf(SpriteId id) const { return indices[id]; }
+	SpriteId idAt(std::size_t index) const { return ids[index]; }
+
+	void setPosition(SpriteId id, float x, float y);
+	void setVelocity(SpriteId id, float x, float y);
+	void setRegion(SpriteId id, const AtlasRegion& region);
+	void setLayer(SpriteId id, int layer);
+
+	// The slot a texture is drawn from, adding it if it's new; not safe to call alongside anything else
+	Uint16 textureSlot(SDL_Texture *texture);
+
+	// Like setRegion with the texture already turned into a slot, so different sprites can be set from different threads
+	void setSource(SpriteId id, const SDL_Rect& source, Uint16 slot);
+
+	float x(SpriteId id) const { return positionX[indices[id]]; }
+	float y(SpriteId id) const { return positionY[indices[id]]; }
+	float velocityX(SpriteId id) const { return speedX[indices[id]]; }
+	float velocityY(SpriteId id) const { return speedY[indices[id]]; }
+
+	// Where the sprite currently covers, rounded to whole pixels
+	SDL_Rect bounds(SpriteId id) const;
+
+	// Call before each simulation step, so submit() can interpolate from here
+	void beginStep();
+	void beginStep(std::size_t first, std::size_t last);
+
+	// Moves every sprite by its velocity over dt seconds
+	void integrate(float dt);
+	void integrate(float dt, std::size_t first, std::size_t last);
+
+	// Reflects the velocity of every sprite that left the area, and puts it back inside
+	void bounce(const SDL_Rect& area);
+	void bounce(const SDL_Rect& area, std::size_t first, std::size_t last);
+
+	// Brings the grid up to date with every sprite's current bounds, keyed by SpriteId
+	void syncGrid(SpatialGrid& grid) const;
+
+	// Draws every sprite overlapping the camera, interpolated by alpha
+	void submit(SpriteBatch& batch, const SDL_Rect& camera, float alpha);
+
+	// Draws only the given sprites, e.g. the result of a SpatialGrid query of the camera
+	void submit(SpriteBatch& batch, const SDL_Rect& camera, float alpha, const std::vector<SpriteId>& visible);
+
+private:
+	static const std::size_t INVALID_INDEX = static_cast<std::size_t>(-1);
+
+	void push(std::size_t index, const SDL_Rect& camera, float alpha);
+	void drawSorted(SpriteBatch& batch);
+
+	// Per sprite, all indexed the same way
+	std::vector<float> positionX;
+	std::vector<float> positionY;
+	std::vector<float> previousX;
+	std::vector<float> previousY;
+	std::vector<float> speedX;
+	std::vector<float> speedY;
+	std::vector<int> width;
+	std::vector<int> height;
+	std::vector<SDL_Rect> sources;
+	std::vector<Uint16> slots;
+	std::vector<Uint16> layers;
+	std::vector<SpriteId> ids;
+
+	// SpriteId -> index, and ids free for reuse
+	std::vector<std::size_t> indices;
+	std::vector<SpriteId> freeIds;
+
+	// Every texture any sprite has used, so sprites only need a 16-bit slot each
+	std::vector<SDL_Texture*> textures;
+
+	// Rebuilt by every submit(): sort words, and interpolated screen positions by sprite index
+	std::vector<Uint64> order;
+	std::vector<SDL_Point> screenPositions;
+};
@@ -0,0 +1,180 @@
+#include "StreamingTexture.h"
+
+#include <cstring>
+#include <utility>
+
+#include "Profiler.h"
+#include "RenderStats.h"
+
+StreamingTexture::StreamingTexture(StreamingTexturePool *pool, TexturePtr texture, int width, int height, Uint32 format)
+	: pool(pool), texture(std::move(texture)), textureWidth(width), textureHeight(height), pixelFormat(format) {
+}
+
+StreamingTexture::StreamingTexture(StreamingTexture&& other) noexcept
+	: pool(other.pool), texture(std::move(other.texture)), textureWidth(other.textureWidth),
+	textureHeight(other.textureHeight), pixelFormat(other.pixelFormat), locked(other.locked) {
+	other.locked = false;
+}
+
+StreamingTexture& StreamingTexture::operator=(StreamingTexture&& other) noexcept {
+	if (this != &other) {
+		release();
+
+		pool = other.pool;
+		texture = std::move(other.texture);
+		textureWidth = other.textureWidth;
+		textureHeight = other.textureHeight;
+		pixelFormat = other.pixelFormat;
+		locked = other.locked;
+
+		other.locked = false;
+	}
+
+	return *this;
+}
+
+StreamingTexture::~StreamingTexture() {
+	release();
+}
+
+bool StreamingTexture::update(const void *pixels, int pitch) {
+	return update(SDL_Rect { 0, 0, textureWidth, textureHeight }, pixels, pitch);
+}
+
+bool StreamingTexture::update(const SDL_Rect& area, const void *pixels, int pitch) {
+	PROFILE_SCOPE("StreamingTexture::update");
+
+	if (SDL_ISPIXELFORMAT_FOURCC(pixelFormat)) {
+		SDL_SetError("streaming texture update needs a packed pixel format");
+		return false;
+	}
+
+	void *destination = nullptr;
+	auto destinationPitch = 0;
+
+	if (!lock(&area, &destination, &destinationPitch)) {
+		return false;
+	}
+
+	const auto rowBytes = static_cast<std::size_t>(area.w) * SDL_BYTESPERPIXEL(pixelFormat);
+	const auto *source = static_cast<const unsigned char*>(pixels);
+	auto *target = static_cast<unsigned char*>(destination);
+
+	// When both sides are tightly packed the whole area is one copy
+	if ((pitch == destinationPitch) && (rowBytes == static_cast<std::size_t>(pitch))) {
+		std::memcpy(target, source, rowBytes * area.h);
+	} else {
+		for (auto row = 0; row < area.h; ++row) {
+			std::memcpy(target + row * destinationPitch, source + row * pitch, rowBytes);
+		}
+	}
+
+	unlock();
+	return true;
+}
+
+bool StreamingTexture::lock(const SDL_Rect *area, void **pixels, int *pitch) {
+	if (!texture || locked) {
+		SDL_SetError(texture ? "streaming texture is already locked" : "streaming texture is empty");
+		return false;
+	}
+
+	if (SDL_LockTexture(texture.get(), area, pixels, pitch)) {
+		return false;
+	}
+
+	// Whatever is locked is sent to the renderer on unlock, whether it was all written or not
+	RenderStats::instance().countUpload(static_cast<std::size_t>(area ? area->h : textureHeight) * *pitch);
+
+	locked = true;
+	return true;
+}
+
+void StreamingTexture::unlock() {
+	if (locked) {
+		SDL_UnlockTexture(texture.get());
+		locked = false;
+	}
+}
+
+void StreamingTexture::release() {
+	unlock();
+
+	if (texture && pool) {
+		pool->recycle(std::move(texture), textureWidth, textureHeight, pixelFormat);
+	}
+
+	texture.reset();
+}
+
+TexturePtr StreamingTexture::detach() {
+	unlock();
+	pool = nullptr;
+
+	return std::move(texture);
+}
+
+StreamingTexturePool::StreamingTexturePool(SDL_Renderer *renderer, std::size_t idleBudgetBytes)
+	: targetRenderer(renderer), idleBudget(idleBudgetBytes) {
+}
+
+StreamingTexture StreamingTexturePool::acquire(int width, int height, Uint32 format) {
+	auto bucket = idle.find(bucketKey(width, height, format));
+
+	if ((bucket != idle.end()) && !bucket->second.empty()) {
+		auto texture = std::move(bucket->second.back());
+		bucket->second.pop_back();
+
+		--poolStats.idleTextures;
+		poolStats.idleBytes -= textureBytes(width, height, format);
+		++poolStats.reused;
+
+		// Whoever had it last may have changed how it's drawn; SDL blends new textures with alpha
+		SDL_SetTextureBlendMode(texture.get(), SDL_ISPIXELFORMAT_ALPHA(format) ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_NONE);
+		SDL_SetTextureColorMod(texture.get(), 255, 255, 255);
+		SDL_SetTextureAlphaMod(texture.get(), 255);
+
+		return StreamingTexture(this, std::move(texture), width, height, format);
+	}
+
+	TexturePtr texture(SDL_CreateTexture(targetRenderer, format, SDL_TEXTUREACCESS_STREAMING, width, height));
+
+	if (!texture) {
+		return StreamingTexture();
+	}
+
+	++poolStats.created;
+	return StreamingTexture(this, std::move(texture), width, height, format);
+}
+
+void StreamingTexturePool::trim() {
+	idle.clear();
+
+	poolStats.idleTextures = 0;
+	poolStats.idleBytes = 0;
+}
+
+void StreamingTexturePool::recycle(TexturePtr texture, int width, int height, Uint32 format) {
+	const auto bytes = textureBytes(width, height, format);
+
+	// Over budget, so let this one be destroyed on the way out
+	if (poolStats.idleBytes + bytes > idleBudget) {
+		return;
+	}
+
+	idle[bucketKey(width, height, format)].push_back(std::move(texture));
+
+	++poolStats.idleTextures;
+	poolStats.idleBytes += bytes;
+}
+
+Uint64 StreamingTexturePool::bucketKey(int width, int height, Uint32 format) {
+	// No renderer allows textures anywhere near 65536 pixels across, so 16 bits per side is plenty
+	return (static_cast<Uint64>(format) << 32) | (static_cast<Uint64>(width & 0xFFFF) << 16) | static_cast<Uint64>(height & 0xFFFF);
+}
+
+std::size_t StreamingTexturePool::textureBytes(int width, int height, Uint32 format) {
+	// Compressed (FOURCC) formats don't report a per-pixel size; assume 32 bits
+	const auto bytesPerPixel = SDL_ISPIXELFORMAT_FOURCC(format) ? 4 : SDL_BYTESPERPIXEL(format);
+	return static_cast<std::size_t>(width) * height * bytesPerPixel;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+#include "SDLHandles.h"
+
+class StreamingTexturePool;
+
+/** Class: StreamingTexture
+ *
+ *  Description:
+ *  A texture created with SDL_TEXTUREACCESS_STREAMING, for content that changes after it's been
+ *  uploaded (video frames, generated images, anything drawn on the CPU). Rather than creating a
+ *  new texture for every change, update() locks the existing one and copies the new pixels
+ *  straight into it, so an update costs one memcpy per row. lock()/unlock() hand out the texture's
+ *  memory directly for code that would rather write its pixels in place.
+ *
+ *  Locking throws away the old contents of the locked area, so every pixel in it has to be
+ *  written before unlocking. update() only copies packed formats (not planar YUV).
+ *
+ *  Streaming textures come from a StreamingTexturePool and go back to it when they're destroyed
+ *  or released, so the pool has to outlive them; a detached texture is the caller's own. Like every texture, they may only be used on the
+ *  thread that owns the renderer.
+ *
+ */
+
+class StreamingTexture {
+public:
+	StreamingTexture() = default;
+	StreamingTexture(StreamingTexture&& other) noexcept;
+	StreamingTexture& operator=(StreamingTexture&& other) noexcept;
+	StreamingTexture(const StreamingTexture&) = delete;
+	StreamingTexture& operator=(const StreamingTexture&) = delete;
+	~StreamingTexture();
+
+	// Copies a whole image (or one area of it), pitch bytes apart per row
+	bool update(const void *pixels, int pitch);
+	bool update(const SDL_Rect& area, const void *pixels, int pitch);
+
+	bool lock(const SDL_Rect *area, void **pixels, int *pitch);
+	void unlock();
+
+	// Hands the texture back to its pool early, leaving this one empty
+	void release();
+
+	// Takes the texture out of the pool's hands for good (to keep in a cache, say), leaving this one empty
+	TexturePtr detach();
+
+	SDL_Texture* get() const { return texture.get(); }
+	int width() const { return textureWidth; }
+	int height() const { return textureHeight; }
+	Uint32 format() const { return pixelFormat; }
+
+	explicit operator bool() const { return static_cast<bool>(texture); }
+
+private:
+	friend class StreamingTexturePool;
+
+	StreamingTexture(StreamingTexturePool *pool, TexturePtr texture, int width, int height, Uint32 format);
+
+	StreamingTexturePool *pool = nullptr;
+	TexturePtr texture;
+	int textureWidth = 0;
+	int textureHeight = 0;
+	Uint32 pixelFormat = SDL_PIXELFORMAT_UNKNOWN;
+	bool locked = false;
+};
+
+struct StreamingPoolStats {
+	std::size_t created = 0;
+	std::size_t reused = 0;
+	std::size_t idleTextures = 0;
+	std::size_t idleBytes = 0;
+};
+
+/** Class: StreamingTexturePool
+ *
+ *  Description:
+ *  Keeps streaming textures that nobody is using anymore so the next request for the same size and
+ *  format gets one of them instead of a freshly created texture; creating and destroying textures
+ *  every frame is slow in most drivers and fragments video memory. Idle textures are kept in
+ *  buckets keyed by width, height and format. Once the idle textures add up to the budget, any
+ *  more that come back are destroyed instead of kept.
+ *
+ *  A reused texture gets the same blend mode and color/alpha modulation a new one would have, but
+ *  its pixels are whatever was last written to it.
+ *
+ */
+
+class StreamingTexturePool {
+public:
+	StreamingTexturePool(SDL_Renderer *renderer, std::size_t idleBudgetBytes);
+	StreamingTexturePool(const StreamingTexturePool&) = delete;
+	StreamingTexturePool& operator=(const StreamingTexturePool&) = delete;
+
+	// Returns an empty texture (with the SDL error set) if a new one was needed and couldn't be created
+	StreamingTexture acquire(int width, int height, Uint32 format = SDL_PIXELFORMAT_ARGB8888);
+
+	// Destroys every idle texture
+	void trim();
+
+	const StreamingPoolStats& stats() const { return poolStats; }
+	SDL_Renderer* renderer() const { return targetRenderer; }
+
+private:
+	friend class StreamingTexture;
+
+	void recycle(TexturePtr texture, int width, int height, Uint32 format);
+
+	static Uint64 bucketKey(int width, int height, Uint32 format);
+	static std::size_t textureBytes(int width, int height, Uint32 format);
+
+	SDL_Renderer *targetRenderer;
+	std::size_t idleBudget;
+	std::unordered_map<Uint64, std::vector<TexturePtr>> idle;
+	StreamingPoolStats poolStats;
+};
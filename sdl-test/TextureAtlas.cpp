@@ -0,0 +1,260 @@
+#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "Log.h"
+#include "PixelKernels.h"
+#include "RenderStats.h"
+#include "TextureCache.h"
+
+SkylinePacker::SkylinePacker(int width, int height) : pageWidth(width), pageHeight(height) {
+	reset();
+}
+
+void SkylinePacker::reset() {
+	skyline.clear();
+	skyline.push_back(Segment { 0, 0, pageWidth });
+}
+
+bool SkylinePacker::fits(std::size_t index, int width, int height, int& y) const {
+	const auto x = skyline[index].x;
+
+	if (x + width > pageWidth) {
+		return false;
+	}
+
+	// The rectangle has to rest on the highest segment it spans
+	auto remaining = width;
+	y = skyline[index].y;
+
+	for (auto i = index; remaining > 0; ++i) {
+		if (i == skyline.size()) {
+			return false;
+		}
+
+		y = std::max(y, skyline[i].y);
+
+		if (y + height > pageHeight) {
+			return false;
+		}
+
+		remaining -= skyline[i].width;
+	}
+
+	return true;
+}
+
+bool SkylinePacker::insert(int width, int height, SDL_Rect& placed) {
+	auto bestIndex = skyline.size();
+	auto bestY = std::numeric_limits<int>::max();
+	auto bestWidth = std::numeric_limits<int>::max();
+
+	for (std::size_t i = 0; i < skyline.size(); ++i) {
+		int y = 0;
+
+		// Lowest position wins; ties go to the narrower segment to keep gaps small
+		if (fits(i, width, height, y) && ((y < bestY) || ((y == bestY) && (skyline[i].width < bestWidth)))) {
+			bestIndex = i;
+			bestY = y;
+			bestWidth = skyline[i].width;
+		}
+	}
+
+	if (bestIndex == skyline.size()) {
+		return false;
+	}
+
+	placed = SDL_Rect { skyline[bestIndex].x, bestY, width, height };
+
+	// Raise the skyline under the new rectangle, trimming or removing the segments it covers
+	skyline.insert(skyline.begin() + bestIndex, Segment { placed.x, bestY + height, width });
+
+	const auto right = placed.x + width;
+
+	for (auto i = bestIndex + 1; i < skyline.size();) {
+		auto& segment = skyline[i];
+
+		if (segment.x >= right) {
+			break;
+		}
+
+		const auto overlap = right - segment.x;
+
+		if (overlap >= segment.width) {
+			skyline.erase(skyline.begin() + i);
+			continue;
+		}
+
+		segment.x += overlap;
+		segment.width -= overlap;
+		break;
+	}
+
+	// Neighbouring segments at the same height are one segment
+	for (std::size_t i = 0; i + 1 < skyline.size();) {
+		if (skyline[i].y == skyline[i + 1].y) {
+			skyline[i].width += skyline[i + 1].width;
+			skyline.erase(skyline.begin() + i + 1);
+		} else {
+			++i;
+		}
+	}
+
+	return true;
+}
+
+AtlasBuilder::AtlasBuilder(int pageSize, int padding) : pageSize(pageSize), padding(padding) {
+}
+
+void AtlasBuilder::clear() {
+	images.clear();
+	pages.clear();
+}
+
+bool AtlasBuilder::add(const std::string& name, SurfacePtr image) {
+	// Pages are ARGB8888, so images are brought to the same format up front and copied row by row
+	if (image && image->format->format != SDL_PIXELFORMAT_ARGB8888) {
+		image = convertToARGB8888(image.get());
+	}
+
+	if (!image) {
+		return false;
+	}
+
+	images.push_back(Image { name, std::move(image), -1, SDL_Rect {} });
+	return true;
+}
+
+bool AtlasBuilder::pack() {
+	// Tallest first gives the skyline heuristic its best results
+	std::vector<std::size_t> order(images.size());
+
+	for (std::size_t i = 0; i < order.size(); ++i) {
+		order[i] = i;
+	}
+
+	std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) {
+		return images[a].surface->h > images[b].surface->h;
+	});
+
+	std::vector<SkylinePacker> packers;
+
+	for (auto index : order) {
+		auto& image = images[index];
+
+		const auto paddedWidth = image.surface->w + padding;
+		const auto paddedHeight = image.surface->h + padding;
+
+		if ((paddedWidth > pageSize) || (paddedHeight > pageSize)) {
+			std::cerr << "AtlasBuilder error: " << image.name << " does not fit in a " << pageSize << " pixel page\n";
+			return false;
+		}
+
+		for (std::size_t page = 0; page <= packers.size(); ++page) {
+			if (page == packers.size()) {
+				packers.emplace_back(pageSize, pageSize);
+			}
+
+			SDL_Rect placed;
+
+			if (packers[page].insert(paddedWidth, paddedHeight, placed)) {
+				image.page = static_cast<int>(page);
+				image.rect = SDL_Rect { placed.x, placed.y, image.surface->w, image.surface->h };
+				break;
+			}
+		}
+	}
+
+	// Pages only need to reach as far as their images, which mostly matters for the last one;
+	// sizes are rounded up to a multiple of 4 pixels, never past the page size
+	std::vector<SDL_Point> extents(packers.size(), SDL_Point { 0, 0 });
+
+	for (const auto& image : images) {
+		auto& extent = extents[image.page];
+
+		extent.x = std::max(extent.x, image.rect.x + image.rect.w + padding);
+		extent.y = std::max(extent.y, image.rect.y + image.rect.h + padding);
+	}
+
+	for (std::size_t page = 0; page < packers.size(); ++page) {
+		const auto width = std::min((extents[page].x + 3) & ~3, pageSize);
+		const auto height = std::min((extents[page].y + 3) & ~3, pageSize);
+
+		SurfacePtr surface(SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888));
+
+		if (!surface) {
+			LogSDLError(std::cerr, "CreateRGBSurfaceWithFormat");
+			return false;
+		}
+
+		// Unused space stays fully transparent
+		SDL_FillRect(surface.get(), NULL, 0);
+		pages.push_back(std::move(surface));
+	}
+
+	for (const auto& image : images) {
+		// Same format on both sides, so copying rows is all a blit would do, without the blend setup
+		const auto *source = image.surface.get();
+		auto *page = pages[image.page].get();
+
+		SDL_LockSurface(const_cast<SDL_Surface*>(source));
+
+		const auto rowBytes = static_cast<std::size_t>(image.rect.w) * sizeof(Uint32);
+		const auto *sourceRow = static_cast<const Uint8*>(source->pixels);
+		auto *pageRow = static_cast<Uint8*>(page->pixels) + image.rect.y * page->pitch + image.rect.x * sizeof(Uint32);
+
+		for (auto y = 0; y < image.rect.h; ++y, sourceRow += source->pitch, pageRow += page->pitch) {
+			std::memcpy(pageRow, sourceRow, rowBytes);
+		}
+
+		SDL_UnlockSurface(const_cast<SDL_Surface*>(source));
+	}
+
+	return true;
+}
+
+std::unique_ptr<TextureAtlas> TextureAtlas::create(SDL_Renderer *renderer, const AtlasBuilder& builder) {
+	std::unique_ptr<TextureAtlas> atlas(new TextureAtlas());
+
+	for (const auto& page : builder.pages) {
+		TexturePtr texture(SDL_CreateTextureFromSurface(renderer, page.get()));
+
+		if (!texture) {
+			LogSDLError(std::cerr, "CreateTextureFromSurface");
+			return nullptr;
+		}
+
+		RenderStats::instance().countUpload(page.get());
+
+		SDL_SetTextureBlendMode(texture.get(), SDL_BLENDMODE_BLEND);
+		atlas->pages.push_back(std::move(texture));
+	}
+
+	for (const auto& image : builder.images) {
+		AtlasRegion region;
+		region.texture = atlas->pages[image.page].get();
+		region.rect = image.rect;
+
+		atlas->regions.emplace(image.name, region);
+	}
+
+	return atlas;
+}
+
+const AtlasRegion* TextureAtlas::find(const std::string& name) const {
+	auto found = regions.find(name);
+	return (found != regions.end()) ? &found->second : nullptr;
+}
+
+bool TextureAtlas::update(const std::string& name, SDL_Surface *image) {
+	auto found = regions.find(name);
+
+	if (found == regions.end()) {
+		SDL_SetError("%s is not in the atlas", name.c_str());
+		return false;
+	}
+
+	return updateTextureFromSurface(found->second.texture, &found->second.rect, image);
+}
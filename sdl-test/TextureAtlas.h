@@ -0,0 +1,122 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+#include "SDLHandles.h"
+
+/** Struct: AtlasRegion
+ *
+ *  Description:
+ *  Where an image ended up inside an atlas: the page texture it lives on and its rectangle on
+ *  that page. Draw calls take a region in place of a whole texture.
+ *
+ */
+
+struct AtlasRegion {
+	SDL_Texture *texture = nullptr;
+	SDL_Rect rect {};
+};
+
+/** Class: SkylinePacker
+ *
+ *  Description:
+ *  Packs rectangles into a fixed-size page using the skyline bottom-left heuristic. The packer
+ *  tracks the top edge of everything placed so far as a list of horizontal segments and puts each
+ *  new rectangle wherever it would sit lowest, which wastes little space when rectangles are
+ *  inserted tallest first.
+ *
+ */
+
+class SkylinePacker {
+public:
+	SkylinePacker(int width, int height);
+
+	bool insert(int width, int height, SDL_Rect& placed);
+	void reset();
+
+private:
+	struct Segment {
+		int x;
+		int y;
+		int width;
+	};
+
+	bool fits(std::size_t index, int width, int height, int& y) const;
+
+	int pageWidth;
+	int pageHeight;
+	std::vector<Segment> skyline;
+};
+
+/** Class: AtlasBuilder
+ *
+ *  Description:
+ *  The CPU half of building an atlas. Images are added one at a time, and pack() sorts them by
+ *  height, places them on as many pages as needed and copies their pixels into ARGB8888 page
+ *  surfaces. The page size is the most a page can be; each page is cut down to what its images
+ *  cover, so a few small images don't cost a whole page. Nothing here touches the renderer, so a builder can run on any thread; the pages are
+ *  uploaded afterwards by TextureAtlas::create on the render thread.
+ *
+ */
+
+class AtlasBuilder {
+public:
+	explicit AtlasBuilder(int pageSize, int padding = 1);
+	AtlasBuilder(const AtlasBuilder&) = delete;
+	AtlasBuilder& operator=(const AtlasBuilder&) = delete;
+
+	// Fails only if the image cannot be converted to ARGB8888
+	bool add(const std::string& name, SurfacePtr image);
+
+	bool pack();
+	void clear();
+
+private:
+	friend class TextureAtlas;
+
+	struct Image {
+		std::string name;
+		SurfacePtr surface;
+		int page;
+		SDL_Rect rect;
+	};
+
+	int pageSize;
+	int padding;
+	std::vector<Image> images;
+	std::vector<SurfacePtr> pages;
+};
+
+/** Class: TextureAtlas
+ *
+ *  Description:
+ *  A set of page textures together with the region of every image packed into them. The atlas
+ *  owns its page textures; regions only borrow them. Updating an image rewrites its rectangle on
+ *  the page, so regions already handed out stay valid.
+ *
+ */
+
+class TextureAtlas {
+public:
+	static std::unique_ptr<TextureAtlas> create(SDL_Renderer *renderer, const AtlasBuilder& builder);
+
+	TextureAtlas(const TextureAtlas&) = delete;
+	TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+	const AtlasRegion* find(const std::string& name) const;
+
+	// Overwrites an image's pixels on its page; the new image has to be the same size as the old one
+	bool update(const std::string& name, SDL_Surface *image);
+	std::size_t pageCount() const { return pages.size(); }
+
+private:
+	TextureAtlas() = default;
+
+	std::vector<TexturePtr> pages;
+	std::unordered_map<std::string, AtlasRegion> regions;
+};
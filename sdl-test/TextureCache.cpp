@@ -0,0 +1,237 @@
+#include "TextureCache.h"
+
+#include "ImageCodec.h"
+#include "Log.h"
+#include "PixelKernels.h"
+#include "Profiler.h"
+#include "RenderStats.h"
+
+TextureCache::TextureCache(SDL_Renderer *renderer, std::size_t budgetBytes)
+	: targetRenderer(renderer), budget(budgetBytes) {
+}
+
+TextureHandle TextureCache::load(const std::string& path) {
+	auto cached = find(path);
+
+	if (cached) {
+		return cached;
+	}
+
+	auto texture = createTextureFromBMP(path, targetRenderer);
+
+	if (!texture) {
+		return nullptr;
+	}
+
+	return insert(path, std::move(texture));
+}
+
+TextureHandle TextureCache::find(const std::string& path) {
+	auto found = slots.find(path);
+
+	if (found == slots.end()) {
+		++cacheStats.misses;
+		RenderStats::instance().countCacheMiss();
+		return nullptr;
+	}
+
+	++cacheStats.hits;
+	RenderStats::instance().countCacheHit();
+
+	// Move the entry to the front of the list, it's now the most recently used
+	lru.splice(lru.begin(), lru, found->second.lruPosition);
+	return found->second.handle;
+}
+
+TextureHandle TextureCache::insert(const std::string& path, TexturePtr texture) {
+	auto entry = std::make_shared<TextureEntry>();
+	entry->path = path;
+	entry->texture = std::move(texture);
+
+	Uint32 format = 0;
+	SDL_QueryTexture(entry->texture.get(), &format, NULL, &entry->width, &entry->height);
+
+	// Compressed (FOURCC) formats don't report a per-pixel size; assume 32 bits
+	const auto bytesPerPixel = SDL_ISPIXELFORMAT_FOURCC(format) ? 4 : SDL_BYTESPERPIXEL(format);
+	entry->bytes = static_cast<std::size_t>(entry->width) * entry->height * bytesPerPixel;
+
+	// Replacing an existing entry leaves the old texture alive for whoever still holds it
+	auto existing = slots.find(path);
+
+	if (existing != slots.end()) {
+		cacheStats.residentBytes -= existing->second.handle->bytes;
+		lru.erase(existing->second.lruPosition);
+		slots.erase(existing);
+	}
+
+	lru.push_front(path);
+	slots.emplace(path, Slot { entry, lru.begin() });
+	cacheStats.residentBytes += entry->bytes;
+
+	collect();
+
+	return entry;
+}
+
+bool TextureCache::reload(const std::string& path, SDL_Surface *image) {
+	auto found = slots.find(path);
+
+	if (found == slots.end()) {
+		SDL_SetError("%s is not in the texture cache", path.c_str());
+		return false;
+	}
+
+	auto& entry = *found->second.handle;
+
+	if ((entry.width == image->w) && (entry.height == image->h)) {
+		return updateTextureFromSurface(entry.texture.get(), NULL, image);
+	}
+
+	TexturePtr texture(SDL_CreateTextureFromSurface(targetRenderer, image));
+
+	if (!texture) {
+		return false;
+	}
+
+	RenderStats::instance().countUpload(image);
+
+	SDL_BlendMode blendMode = SDL_BLENDMODE_NONE;
+	SDL_GetTextureBlendMode(entry.texture.get(), &blendMode);
+	SDL_SetTextureBlendMode(texture.get(), blendMode);
+
+	Uint32 format = 0;
+	SDL_QueryTexture(texture.get(), &format, NULL, &entry.width, &entry.height);
+
+	const auto bytesPerPixel = SDL_ISPIXELFORMAT_FOURCC(format) ? 4 : SDL_BYTESPERPIXEL(format);
+
+	cacheStats.residentBytes -= entry.bytes;
+	entry.bytes = static_cast<std::size_t>(entry.width) * entry.height * bytesPerPixel;
+	cacheStats.residentBytes += entry.bytes;
+
+	entry.texture = std::move(texture);
+
+	collect();
+	return true;
+}
+
+void TextureCache::setBudget(std::size_t budgetBytes) {
+	budget = budgetBytes;
+	collect();
+}
+
+void TextureCache::collect() {
+	// Walk from the least recently used end, skipping anything still referenced elsewhere
+	auto position = lru.end();
+
+	while ((cacheStats.residentBytes > budget) && (position != lru.begin())) {
+		--position;
+
+		auto slot = slots.find(*position);
+
+		if (slot->second.handle.use_count() > 1) {
+			continue;
+		}
+
+		cacheStats.residentBytes -= slot->second.handle->bytes;
+		++cacheStats.evictions;
+
+		slots.erase(slot);
+		position = lru.erase(position);
+	}
+}
+
+bool TextureCache::evict(const std::string& path) {
+	auto slot = slots.find(path);
+
+	if ((slot == slots.end()) || (slot->second.handle.use_count() > 1)) {
+		return false;
+	}
+
+	cacheStats.residentBytes -= slot->second.handle->bytes;
+	++cacheStats.evictions;
+
+	lru.erase(slot->second.lruPosition);
+	slots.erase(slot);
+
+	return true;
+}
+
+void TextureCache::clear() {
+	slots.clear();
+	lru.clear();
+	cacheStats.residentBytes = 0;
+}
+
+TexturePtr createTextureFromBMP(const std::string& filename, SDL_Renderer *renderer) {
+	PROFILE_SCOPE("createTextureFromBMP");
+
+	TexturePtr texture;
+
+	// Load the image
+	auto loadedImage = loadImage(filename);
+
+	if ((loadedImage != nullptr) && (loadedImage->format->format != SDL_PIXELFORMAT_ARGB8888)) {
+		loadedImage = convertToARGB8888(loadedImage.get());
+	}
+
+	// If the loading went ok, convert to texture and return the texture; the surface frees itself
+	if (loadedImage != nullptr) {
+		texture.reset(SDL_CreateTextureFromSurface(renderer, loadedImage.get()));
+
+		// Make sure everything went ok, too
+		if (texture == nullptr) {
+			LogSDLError(std::cerr, "CreateTextureFromSurface");
+		} else {
+			RenderStats::instance().countUpload(loadedImage.get());
+		}
+	} else {
+		LogSDLError(std::cerr, "LoadBMP");
+	}
+
+	return texture;
+}
+
+TextureHandle loadTexture(const std::string& filename, TextureCache& cache) {
+	return cache.load(filename);
+}
+
+bool updateTextureFromSurface(SDL_Texture *texture, const SDL_Rect *area, SDL_Surface *image) {
+	PROFILE_SCOPE("updateTextureFromSurface");
+
+	Uint32 format = 0;
+	auto width = 0;
+	auto height = 0;
+
+	if (SDL_QueryTexture(texture, &format, NULL, &width, &height)) {
+		return false;
+	}
+
+	if (area) {
+		width = area->w;
+		height = area->h;
+	}
+
+	if ((image->w != width) || (image->h != height)) {
+		SDL_SetError("image is %dx%d but the texture area is %dx%d", image->w, image->h, width, height);
+		return false;
+	}
+
+	SurfacePtr converted;
+
+	if (image->format->format != format) {
+		converted.reset(SDL_ConvertSurfaceFormat(image, format, 0));
+
+		if (!converted) {
+			return false;
+		}
+
+		image = converted.get();
+	}
+
+	if (SDL_UpdateTexture(texture, area, image->pixels, image->pitch)) {
+		return false;
+	}
+
+	RenderStats::instance().countUpload(image);
+	return true;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <SDL/SDL.h>
+
+#include "SDLHandles.h"
+
+/** Struct: TextureEntry
+ *
+ *  Description:
+ *  A texture owned by the cache, along with the information the cache needs to account for it.
+ *  The rest of the program holds entries through a TextureHandle, so the entry (and the
+ *  SDL_Texture inside it) lives as long as anyone is still using it.
+ *
+ */
+
+struct TextureEntry {
+	std::string path;
+	TexturePtr texture;
+	int width = 0;
+	int height = 0;
+	std::size_t bytes = 0;
+};
+
+using TextureHandle = std::shared_ptr<TextureEntry>;
+
+struct TextureCacheStats {
+	std::size_t hits = 0;
+	std::size_t misses = 0;
+	std::size_t evictions = 0;
+	std::size_t residentBytes = 0;
+};
+
+/** Class: TextureCache
+ *
+ *  Description:
+ *  Maps file paths to uploaded textures so that each image is decoded and uploaded once no matter
+ *  how often it is requested. Entries are kept in least-recently-used order; whenever the resident
+ *  size goes over the budget, the oldest entries that nobody outside the cache still references
+ *  are destroyed. Textures that are still referenced are never evicted, so the budget is a soft
+ *  limit while everything on screen is in use.
+ *
+ *  Reloading an entry writes the new image into the existing texture when it's the same size, so
+ *  even raw SDL_Texture pointers taken from it stay good. An image of a different size needs a new
+ *  texture, which handles pick up the next time they read the entry.
+ *
+ */
+
+class TextureCache {
+public:
+	TextureCache(SDL_Renderer *renderer, std::size_t budgetBytes);
+	TextureCache(const TextureCache&) = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+
+	TextureHandle load(const std::string& path);
+	TextureHandle find(const std::string& path);
+	TextureHandle insert(const std::string& path, TexturePtr texture);
+
+	// Puts new pixels into a cached texture; every handle to it sees them, and none is invalidated
+	bool reload(const std::string& path, SDL_Surface *image);
+	bool contains(const std::string& path) const { return slots.count(path) != 0; }
+
+	void setBudget(std::size_t budgetBytes);
+	void collect();
+
+	// Drops the entry now, whatever the budget, unless a handle outside the cache still holds it
+	bool evict(const std::string& path);
+	void clear();
+
+	const TextureCacheStats& stats() const { return cacheStats; }
+	SDL_Renderer* renderer() const { return targetRenderer; }
+
+private:
+	using LruList = std::list<std::string>;
+
+	struct Slot {
+		TextureHandle handle;
+		LruList::iterator lruPosition;
+	};
+
+	SDL_Renderer *targetRenderer;
+	std::size_t budget;
+	LruList lru;
+	std::unordered_map<std::string, Slot> slots;
+	TextureCacheStats cacheStats;
+};
+
+/** Function: createTextureFromBMP
+ *
+ *  Description:
+ *  Decodes a BMP from disk (or the QOI that replaces it, see loadImage) and uploads it to the
+ *  renderer, bypassing any cache. Returns an empty handle (after logging) if either step fails.
+ *
+ */
+
+TexturePtr createTextureFromBMP(const std::string& filename, SDL_Renderer *renderer);
+
+/** Function: updateTextureFromSurface
+ *
+ *  Description:
+ *  Copies a surface into an area of an existing texture (the whole texture if area is null), which
+ *  has to be the same size as the surface. The surface is converted first if it isn't already in
+ *  the texture's format. Returns false, with the SDL error set, if the copy can't be made.
+ *
+ */
+
+bool updateTextureFromSurface(SDL_Texture *texture, const SDL_Rect *area, SDL_Surface *image);
+
+/** Function: loadTexture
+ *
+ *  Description:
+ *  Returns the cached texture for the given file, loading it on first use. The returned handle
+ *  is empty if the file could not be loaded.
+ *
+ */
+
+TextureHandle loadTexture(const std::string& filename, TextureCache& cache);
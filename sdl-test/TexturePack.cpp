@@ -0,0 +1,283 @@
+#include "TexturePack.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "ImageCodec.h"
+#include "Log.h"
+#include "PixelKernels.h"
+#include "RenderStats.h"
+
+#ifdef _WIN32
+
+std::unique_ptr<MappedFile> MappedFile::open(const std::string& path) {
+	std::unique_ptr<MappedFile> mapped(new MappedFile());
+
+	mapped->fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	if (mapped->fileHandle == INVALID_HANDLE_VALUE) {
+		mapped->fileHandle = nullptr;
+		return nullptr;
+	}
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(mapped->fileHandle, &fileSize) || (fileSize.QuadPart == 0)) {
+		return nullptr;
+	}
+
+	mapped->mappingHandle = CreateFileMappingA(mapped->fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+	if (!mapped->mappingHandle) {
+		return nullptr;
+	}
+
+	mapped->bytes = static_cast<const unsigned char*>(MapViewOfFile(mapped->mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	mapped->length = static_cast<std::size_t>(fileSize.QuadPart);
+
+	if (!mapped->bytes) {
+		return nullptr;
+	}
+
+	return mapped;
+}
+
+MappedFile::~MappedFile() {
+	if (bytes) {
+		UnmapViewOfFile(bytes);
+	}
+
+	if (mappingHandle) {
+		CloseHandle(mappingHandle);
+	}
+
+	if (fileHandle) {
+		CloseHandle(fileHandle);
+	}
+}
+
+#else
+
+std::unique_ptr<MappedFile> MappedFile::open(const std::string& path) {
+	const int descriptor = ::open(path.c_str(), O_RDONLY);
+
+	if (descriptor < 0) {
+		return nullptr;
+	}
+
+	struct stat status;
+
+	if ((fstat(descriptor, &status) != 0) || (status.st_size == 0)) {
+		close(descriptor);
+		return nullptr;
+	}
+
+	void *address = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+	close(descriptor);
+
+	if (address == MAP_FAILED) {
+		return nullptr;
+	}
+
+	std::unique_ptr<MappedFile> mapped(new MappedFile());
+	mapped->bytes = static_cast<const unsigned char*>(address);
+	mapped->length = static_cast<std::size_t>(status.st_size);
+
+	return mapped;
+}
+
+MappedFile::~MappedFile() {
+	if (bytes) {
+		munmap(const_cast<unsigned char*>(bytes), length);
+	}
+}
+
+#endif
+
+std::unique_ptr<TexturePack> TexturePack::open(const std::string& path) {
+	std::unique_ptr<TexturePack> pack(new TexturePack());
+	pack->file = MappedFile::open(path);
+
+	if (!pack->file) {
+		return nullptr;
+	}
+
+	const auto *data = pack->file->data();
+	const auto size = pack->file->size();
+
+	if (size < sizeof(TexturePackHeader)) {
+		std::cerr << "TexturePack " << path << " error: truncated header\n";
+		return nullptr;
+	}
+
+	std::memcpy(&pack->header, data, sizeof(TexturePackHeader));
+
+	if ((pack->header.magic != PACK_MAGIC) || (pack->header.version != PACK_VERSION)) {
+		std::cerr << "TexturePack " << path << " error: not a version " << PACK_VERSION << " texture pack\n";
+		return nullptr;
+	}
+
+	const auto indexSize = static_cast<Uint64>(pack->header.entryCount) * sizeof(TexturePackEntry);
+
+	if (sizeof(TexturePackHeader) + indexSize > size) {
+		std::cerr << "TexturePack " << path << " error: truncated index\n";
+		return nullptr;
+	}
+
+	// The header is 16 bytes, so the index that follows it is suitably aligned inside the mapping
+	pack->entries = reinterpret_cast<const TexturePackEntry*>(data + sizeof(TexturePackHeader));
+
+	const auto bytesPerPixel = SDL_BYTESPERPIXEL(pack->header.pixelFormat);
+
+	// Everything createTexture() hands SDL_UpdateTexture has to lie inside the file, rows of at
+	// least width pixels, starting on the alignment the writer gave it
+	for (Uint32 i = 0; i < pack->header.entryCount; ++i) {
+		const auto& entry = pack->entries[i];
+
+		if ((entry.offset > size) || (entry.size > size - entry.offset)
+			|| (entry.offset % PACK_ALIGNMENT != 0)
+			|| (entry.pitch < static_cast<Uint64>(entry.width) * bytesPerPixel)
+			|| (static_cast<Uint64>(entry.pitch) * entry.height > entry.size)
+			|| (entry.name[PACK_NAME_LENGTH - 1] != '\0')) {
+			std::cerr << "TexturePack " << path << " error: entry " << i << " is corrupt\n";
+			return nullptr;
+		}
+	}
+
+	return pack;
+}
+
+const TexturePackEntry* TexturePack::find(const std::string& name) const {
+	for (Uint32 i = 0; i < header.entryCount; ++i) {
+		if (name == entries[i].name) {
+			return &entries[i];
+		}
+	}
+
+	return nullptr;
+}
+
+TexturePtr TexturePack::createTexture(SDL_Renderer *renderer, const TexturePackEntry& entry) const {
+	TexturePtr texture(SDL_CreateTexture(renderer, header.pixelFormat, SDL_TEXTUREACCESS_STATIC,
+		static_cast<int>(entry.width), static_cast<int>(entry.height)));
+
+	if (!texture) {
+		LogSDLError(std::cerr, "CreateTexture");
+		return nullptr;
+	}
+
+	if (SDL_UpdateTexture(texture.get(), NULL, pixels(entry), static_cast<int>(entry.pitch))) {
+		LogSDLError(std::cerr, "UpdateTexture");
+		return nullptr;
+	}
+
+	RenderStats::instance().countUpload(static_cast<std::size_t>(entry.height) * entry.pitch);
+
+	// Packed images carry an alpha channel, so let it take effect by default
+	SDL_SetTextureBlendMode(texture.get(), SDL_BLENDMODE_BLEND);
+
+	return texture;
+}
+
+std::string packEntryName(const std::string& path) {
+	const auto separator = path.find_last_of("/\\");
+	return (separator == std::string::npos) ? path : path.substr(separator + 1);
+}
+
+bool writeTexturePack(const std::string& outputPath, const std::vector<std::string>& inputPaths, Uint32 pixelFormat) {
+	std::vector<TexturePackEntry> entries(inputPaths.size());
+	std::vector<SurfacePtr> surfaces;
+
+	// Pixel data starts after the header and index, rounded up to the alignment
+	auto align = [](Uint64 offset) { return (offset + PACK_ALIGNMENT - 1) & ~static_cast<Uint64>(PACK_ALIGNMENT - 1); };
+	auto offset = align(sizeof(TexturePackHeader) + entries.size() * sizeof(TexturePackEntry));
+
+	for (std::size_t i = 0; i < inputPaths.size(); ++i) {
+		auto loaded = loadImage(inputPaths[i]);
+
+		if (!loaded) {
+			LogSDLError(std::cerr, "loadImage");
+			return false;
+		}
+
+		SurfacePtr converted(pixelFormat == SDL_PIXELFORMAT_ARGB8888
+			? convertToARGB8888(loaded.get())
+			: SurfacePtr(SDL_ConvertSurfaceFormat(loaded.get(), pixelFormat, 0)));
+
+		if (!converted) {
+			LogSDLError(std::cerr, "ConvertSurfaceFormat");
+			return false;
+		}
+
+		const auto name = packEntryName(inputPaths[i]);
+
+		if (name.size() >= PACK_NAME_LENGTH) {
+			std::cerr << "TexturePack error: name " << name << " is longer than " << PACK_NAME_LENGTH - 1 << " characters\n";
+			return false;
+		}
+
+		auto& entry = entries[i];
+		std::memset(&entry, 0, sizeof(entry));
+		std::memcpy(entry.name, name.c_str(), name.size());
+
+		entry.width = static_cast<Uint32>(converted->w);
+		entry.height = static_cast<Uint32>(converted->h);
+		entry.pitch = static_cast<Uint32>(converted->w * converted->format->BytesPerPixel);
+		entry.offset = offset;
+		entry.size = static_cast<Uint64>(entry.pitch) * entry.height;
+
+		surfaces.push_back(std::move(converted));
+
+		offset = align(offset + entry.size);
+	}
+
+	std::FILE *output = std::fopen(outputPath.c_str(), "wb");
+
+	if (!output) {
+		std::cerr << "TexturePack error: could not open " << outputPath << " for writing\n";
+		return false;
+	}
+
+	const TexturePackHeader header { PACK_MAGIC, PACK_VERSION, pixelFormat, static_cast<Uint32>(entries.size()) };
+
+	auto ok = std::fwrite(&header, sizeof(header), 1, output) == 1;
+	ok = ok && (entries.empty() || (std::fwrite(entries.data(), sizeof(TexturePackEntry), entries.size(), output) == entries.size()));
+
+	auto written = static_cast<Uint64>(sizeof(header) + entries.size() * sizeof(TexturePackEntry));
+	const char padding[PACK_ALIGNMENT] = {};
+
+	for (std::size_t i = 0; ok && (i < entries.size()); ++i) {
+		const auto& entry = entries[i];
+		const auto *surface = surfaces[i].get();
+
+		ok = std::fwrite(padding, 1, static_cast<std::size_t>(entry.offset - written), output) == entry.offset - written;
+
+		// Surfaces may pad their rows; the pack stores them tightly
+		const auto *row = static_cast<const unsigned char*>(surface->pixels);
+
+		for (Uint32 y = 0; ok && (y < entry.height); ++y, row += surface->pitch) {
+			ok = std::fwrite(row, 1, entry.pitch, output) == entry.pitch;
+		}
+
+		written = entry.offset + entry.size;
+	}
+
+	ok = (std::fclose(output) == 0) && ok;
+
+	if (!ok) {
+		std::cerr << "TexturePack error: failed writing " << outputPath << '\n';
+	}
+
+	return ok;
+}
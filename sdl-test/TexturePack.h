@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+#include "SDLHandles.h"
+
+/** Texture pack file layout
+ *
+ *  Description:
+ *  A pack is a header, followed by an index with one entry per image, followed by the pixel data
+ *  of every image. Pixels are stored already converted to the pack's pixel format with rows packed
+ *  tightly, and each image starts on a PACK_ALIGNMENT boundary, so at runtime the mapped bytes can
+ *  be handed to SDL_UpdateTexture as they are. All fields are little-endian.
+ *
+ */
+
+const Uint32 PACK_MAGIC = 0x4B415054; // "TPAK"
+const Uint32 PACK_VERSION = 1;
+const std::size_t PACK_ALIGNMENT = 64;
+const std::size_t PACK_NAME_LENGTH = 64;
+
+struct TexturePackHeader {
+	Uint32 magic;
+	Uint32 version;
+	Uint32 pixelFormat;
+	Uint32 entryCount;
+};
+
+struct TexturePackEntry {
+	char name[PACK_NAME_LENGTH];
+	Uint32 width;
+	Uint32 height;
+	Uint32 pitch;
+	Uint32 reserved;
+	Uint64 offset;
+	Uint64 size;
+};
+
+/** Class: MappedFile
+ *
+ *  Description:
+ *  A read-only memory mapping of a whole file. The mapping is released when the object goes away.
+ *
+ */
+
+class MappedFile {
+public:
+	static std::unique_ptr<MappedFile> open(const std::string& path);
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	const unsigned char* data() const { return bytes; }
+	std::size_t size() const { return length; }
+
+private:
+	MappedFile() = default;
+
+	const unsigned char *bytes = nullptr;
+	std::size_t length = 0;
+
+#ifdef _WIN32
+	void *fileHandle = nullptr;
+	void *mappingHandle = nullptr;
+#endif
+};
+
+/** Class: TexturePack
+ *
+ *  Description:
+ *  A texture pack mapped into memory. Looking up an image returns its index entry, and
+ *  createTexture() uploads the image straight out of the mapping without decoding it or copying it
+ *  into an intermediate surface first.
+ *
+ */
+
+class TexturePack {
+public:
+	static std::unique_ptr<TexturePack> open(const std::string& path);
+
+	const TexturePackEntry* find(const std::string& name) const;
+	const void* pixels(const TexturePackEntry& entry) const { return file->data() + entry.offset; }
+	Uint32 pixelFormat() const { return header.pixelFormat; }
+
+	TexturePtr createTexture(SDL_Renderer *renderer, const TexturePackEntry& entry) const;
+
+private:
+	TexturePack() = default;
+
+	std::unique_ptr<MappedFile> file;
+	TexturePackHeader header;
+	const TexturePackEntry *entries = nullptr;
+};
+
+/** Function: writeTexturePack
+ *
+ *  Description:
+ *  The offline half of the pack format: loads each BMP, converts it to the given pixel format and
+ *  writes them all into a single pack file. Images are indexed by file name without directories.
+ *
+ */
+
+bool writeTexturePack(const std::string& outputPath, const std::vector<std::string>& inputPaths, Uint32 pixelFormat);
+
+std::string packEntryName(const std::string& path);
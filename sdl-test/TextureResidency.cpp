@@ -0,0 +1,110 @@
+#include "TextureResidency.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "Profiler.h"
+
+TextureResidency::TextureResidency(TextureCache& cache, AsyncLoader *loader, std::size_t budgetBytes)
+	: cache(cache), loader(loader), budget(budgetBytes) {
+}
+
+LazyTextureHandle TextureResidency::declare(const std::string& path) {
+	auto& texture = textures[path];
+
+	if (!texture) {
+		texture = std::make_shared<LazyTexture>();
+		texture->path = path;
+
+		++residencyStats.declared;
+	}
+
+	return texture;
+}
+
+const TextureEntry* TextureResidency::use(LazyTexture& texture) {
+	texture.lastUsed = frame;
+
+	if (texture.resident) {
+		return texture.resident.get();
+	}
+
+	if (texture.failed) {
+		return nullptr;
+	}
+
+	if (!loader) {
+		auto handle = cache.load(texture.path);
+
+		if (!handle) {
+			texture.failed = true;
+			return nullptr;
+		}
+
+		makeResident(texture, std::move(handle));
+		return texture.resident.get();
+	}
+
+	if (!texture.loading) {
+		texture.loading = loader->request(texture.path);
+	}
+
+	if (texture.loading->isReady()) {
+		auto handle = texture.loading->texture();
+		texture.loading.reset();
+
+		makeResident(texture, std::move(handle));
+		return texture.resident.get();
+	}
+
+	if (texture.loading->isFailed()) {
+		// The loader has already said why; don't keep asking for a file that isn't there
+		texture.loading.reset();
+		texture.failed = true;
+	}
+
+	++residencyStats.misses;
+	return nullptr;
+}
+
+void TextureResidency::makeResident(LazyTexture& texture, TextureHandle handle) {
+	residencyStats.residentBytes += handle->bytes;
+	++residencyStats.resident;
+	++residencyStats.uploads;
+
+	texture.resident = std::move(handle);
+	residentTextures.push_back(&texture);
+}
+
+void TextureResidency::evict(LazyTexture& texture) {
+	residencyStats.residentBytes -= texture.resident->bytes;
+	--residencyStats.resident;
+	++residencyStats.evictions;
+
+	texture.resident.reset();
+
+	// Only goes if nobody else holds it; either way we've stopped counting it
+	cache.evict(texture.path);
+}
+
+void TextureResidency::endFrame() {
+	PROFILE_SCOPE("TextureResidency::endFrame");
+
+	if (residencyStats.residentBytes > budget) {
+		// Least recently drawn first; sorting only happens on frames that went over budget
+		std::sort(residentTextures.begin(), residentTextures.end(), [](const LazyTexture *a, const LazyTexture *b) {
+			return a->lastUsed < b->lastUsed;
+		});
+
+		std::size_t evicted = 0;
+
+		while ((residencyStats.residentBytes > budget) && (evicted < residentTextures.size()) && (residentTextures[evicted]->lastUsed != frame)) {
+			evict(*residentTextures[evicted]);
+			++evicted;
+		}
+
+		residentTextures.erase(residentTextures.begin(), residentTextures.begin() + evicted);
+	}
+
+	++frame;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+#include "AsyncLoader.h"
+#include "TextureCache.h"
+
+/** Struct: LazyTexture
+ *
+ *  Description:
+ *  A texture by name only: declaring one costs a path and a few counters, and nothing is read or
+ *  uploaded until it's first drawn. Whether it's resident at any moment is up to the
+ *  TextureResidency that declared it; holding a LazyTextureHandle doesn't keep the pixels around.
+ *
+ */
+
+struct LazyTexture {
+	std::string path;
+	TextureHandle resident;
+	AsyncTextureHandle loading;
+	Uint64 lastUsed = 0;
+	bool failed = false;
+};
+
+using LazyTextureHandle = std::shared_ptr<LazyTexture>;
+
+struct ResidencyStats {
+	std::size_t declared = 0;
+	std::size_t resident = 0;
+	std::size_t residentBytes = 0;
+	std::size_t uploads = 0;
+	std::size_t evictions = 0;
+
+	// Draws skipped because the texture wasn't resident yet
+	std::size_t misses = 0;
+};
+
+/** Class: TextureResidency
+ *
+ *  Description:
+ *  Keeps the textures that are actually being drawn on the GPU, within a memory budget. Drawing
+ *  code calls use() on a LazyTexture every time it's about to draw it; the first use starts
+ *  loading it, through the AsyncLoader if there is one (use() returns nullptr until the upload has
+ *  happened, so the draw is skipped for a frame or two, the same as anything else still loading)
+ *  or right away through the texture cache if not.
+ *
+ *  At endFrame(), if the resident textures add up to more than the budget, the ones drawn least
+ *  recently are let go until they fit again, and evicted from the texture cache as well unless
+ *  something else still holds them. Drawing one again later reloads it. Textures used during the
+ *  current frame are never evicted, so a frame that needs more than the budget goes over it
+ *  rather than reloading textures it's drawing.
+ *
+ *  Like the AsyncLoader, everything here runs on the thread that owns the renderer.
+ *
+ */
+
+class TextureResidency {
+public:
+	TextureResidency(TextureCache& cache, AsyncLoader *loader, std::size_t budgetBytes);
+	TextureResidency(const TextureResidency&) = delete;
+	TextureResidency& operator=(const TextureResidency&) = delete;
+
+	// Declaring a path twice returns the same texture
+	LazyTextureHandle declare(const std::string& path);
+
+	// The texture to draw with, or nullptr if it isn't resident (yet, or because it failed to load)
+	const TextureEntry* use(LazyTexture& texture);
+
+	void endFrame();
+
+	void setBudget(std::size_t budgetBytes) { budget = budgetBytes; }
+	const ResidencyStats& stats() const { return residencyStats; }
+
+private:
+	void makeResident(LazyTexture& texture, TextureHandle handle);
+	void evict(LazyTexture& texture);
+
+	TextureCache& cache;
+	AsyncLoader *loader;
+	std::size_t budget;
+	Uint64 frame = 1;
+
+	std::unordered_map<std::string, LazyTextureHandle> textures;
+	std::vector<LazyTexture*> residentTextures;
+	ResidencyStats residencyStats;
+};
@@ -0,0 +1,462 @@
+#include "TileRasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "JobSystem.h"
+#include "Log.h"
+#include "PixelKernels.h"
+#include "Profiler.h"
+#include "RenderStats.h"
+#include "SDLHandles.h"
+
+namespace {
+	// Tiles per job; a tile is a few microseconds of blending, so a handful keeps scheduling cheap
+	const std::size_t TILE_JOB_GRAIN = 4;
+
+	bool intersect(const SDL_Rect& a, const SDL_Rect& b, SDL_Rect& result) {
+		const auto left = std::max(a.x, b.x);
+		const auto top = std::max(a.y, b.y);
+		const auto right = std::min(a.x + a.w, b.x + b.w);
+		const auto bottom = std::min(a.y + a.h, b.y + b.h);
+
+		result = SDL_Rect { left, top, right - left, bottom - top };
+		return (right > left) && (bottom > top);
+	}
+
+	/** Blit options
+	 *
+	 *  Description:
+	 *  Tags for what a blit can be asked to do, one pair per choice: how the sprite is written
+	 *  (Opaque for SDL_BLENDMODE_NONE, Blended for SDL_BLENDMODE_BLEND), whether a row has to be
+	 *  resampled because the sprite is drawn at a different width (Scaled) or can be read straight
+	 *  from the texture (Unscaled), and whether the texture's color and alpha modulation have to be
+	 *  applied. Each step of a row is overloaded on its tag, so every instantiation of blitSprite()
+	 *  is a straight loop with the choice already made.
+	 *
+	 */
+
+	struct Opaque {};
+	struct Blended {};
+	struct Unscaled {};
+	struct Scaled {};
+	struct Unmodulated {};
+	struct Modulated {};
+
+	// Both take the span count pixels long starting offset pixels into the sprite's row
+	const Uint32* sampleRow(Unscaled, const Uint32 *sourceRow, int offset, Sint64, int, Uint32*) {
+		return sourceRow + offset;
+	}
+
+	// Rows are sampled at each destination pixel's center, stepping through the source in 16.16 fixed point
+	const Uint32* sampleRow(Scaled, const Uint32 *sourceRow, int offset, Sint64 stepX, int count, Uint32 *scratch) {
+		auto sourceX = offset * stepX + stepX / 2;
+
+		for (auto x = 0; x < count; ++x, sourceX += stepX) {
+			scratch[x] = sourceRow[sourceX >> 16];
+		}
+
+		return scratch;
+	}
+
+	const Uint32* modulateRow(Unmodulated, const Uint32 *span, Uint32, int, Uint32*) {
+		return span;
+	}
+
+	// The same rounding SDL's own blitters use, so modulated sprites come out as the renderer would draw them
+	const Uint32* modulateRow(Modulated, const Uint32 *span, Uint32 modulation, int count, Uint32 *scratch) {
+		const auto a = modulation >> 24;
+		const auto r = (modulation >> 16) & 0xFF;
+		const auto g = (modulation >> 8) & 0xFF;
+		const auto b = modulation & 0xFF;
+
+		for (auto x = 0; x < count; ++x) {
+			const auto pixel = span[x];
+
+			scratch[x] = ((((pixel >> 24) * a) / 255) << 24)
+				| (((((pixel >> 16) & 0xFF) * r) / 255) << 16)
+				| (((((pixel >> 8) & 0xFF) * g) / 255) << 8)
+				| (((pixel & 0xFF) * b) / 255);
+		}
+
+		return scratch;
+	}
+
+	// SDL_BLENDMODE_NONE ignores alpha when drawn, and the layer is composited with it
+	void writeRow(Opaque, const Uint32 *span, Uint32 *out, int count) {
+		for (auto x = 0; x < count; ++x) {
+			out[x] = span[x] | 0xFF000000;
+		}
+	}
+
+	void writeRow(Blended, const Uint32 *span, Uint32 *out, int count) {
+		pixelKernels().blendOver(span, out, static_cast<std::size_t>(count));
+	}
+}
+
+TileRasterizer::TileRasterizer(StreamingTexturePool& pool, JobSystem *jobs, int width, int height)
+	: pool(pool), renderer(pool.renderer()), jobs(jobs), width(width), height(height),
+	tilesAcross((width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE),
+	tilesDown((height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE),
+	framebuffer(static_cast<std::size_t>(width) * height, 0),
+	binStart(static_cast<std::size_t>(tilesAcross) * tilesDown + 1, 0),
+	firstTileX(tilesAcross), firstTileY(tilesDown) {
+}
+
+void TileRasterizer::forgetTextures() {
+	// Queued sprites point into the copies, so they go out first
+	flush();
+	textures.clear();
+}
+
+const TileRasterizer::TexturePixels* TileRasterizer::pixelsOf(SDL_Texture *texture) {
+	auto found = textures.find(texture);
+
+	if (found == textures.end()) {
+		found = textures.emplace(texture, TexturePixels()).first;
+
+		if (!readBack(texture, found->second)) {
+			LogSDLError(std::cerr, "TileRasterizer read back");
+			found->second.pixels.clear();
+		}
+	}
+
+	return found->second.pixels.empty() ? nullptr : &found->second;
+}
+
+bool TileRasterizer::readBack(SDL_Texture *texture, TexturePixels& result) {
+	PROFILE_SCOPE("TileRasterizer::readBack");
+
+	if (SDL_QueryTexture(texture, NULL, NULL, &result.width, &result.height) != 0) {
+		return false;
+	}
+
+	// The only way to get at a texture's pixels is to draw it into a target and read that
+	TexturePtr target(SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, result.width, result.height));
+
+	if (!target) {
+		return false;
+	}
+
+	// Switching targets resets the scale, viewport and clipping, so they're put back by hand
+	SDL_Texture *previousTarget = SDL_GetRenderTarget(renderer);
+	SDL_Rect viewport;
+	SDL_Rect clip;
+	float scaleX;
+	float scaleY;
+	SDL_BlendMode blendMode;
+	Uint8 r, g, b, a;
+
+	SDL_RenderGetViewport(renderer, &viewport);
+	SDL_RenderGetClipRect(renderer, &clip);
+	SDL_RenderGetScale(renderer, &scaleX, &scaleY);
+	SDL_GetTextureBlendMode(texture, &blendMode);
+	SDL_GetTextureColorMod(texture, &r, &g, &b);
+	SDL_GetTextureAlphaMod(texture, &a);
+
+	const auto clipped = SDL_RenderIsClipEnabled(renderer);
+
+	// The pixels are wanted as they are; modulation is applied when they're drawn, as it is then
+	SDL_SetRenderTarget(renderer, target.get());
+	SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
+	SDL_SetTextureColorMod(texture, 255, 255, 255);
+	SDL_SetTextureAlphaMod(texture, 255);
+
+	result.pixels.resize(static_cast<std::size_t>(result.width) * result.height);
+
+	const auto read = (SDL_RenderCopy(renderer, texture, NULL, NULL) == 0)
+		&& (SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_ARGB8888, result.pixels.data(), result.width * static_cast<int>(sizeof(Uint32))) == 0);
+
+	SDL_SetTextureBlendMode(texture, blendMode);
+	SDL_SetTextureColorMod(texture, r, g, b);
+	SDL_SetTextureAlphaMod(texture, a);
+	SDL_SetRenderTarget(renderer, previousTarget);
+	SDL_RenderSetScale(renderer, scaleX, scaleY);
+	SDL_RenderSetViewport(renderer, &viewport);
+	SDL_RenderSetClipRect(renderer, clipped ? &clip : NULL);
+
+	return read;
+}
+
+bool TileRasterizer::resolve(SDL_Texture *texture, SpriteTexture& result) {
+	SDL_BlendMode blendMode = SDL_BLENDMODE_NONE;
+	Uint8 r = 255, g = 255, b = 255, a = 255;
+
+	const auto supported = texture && (SDL_GetTextureBlendMode(texture, &blendMode) == 0)
+		&& ((blendMode == SDL_BLENDMODE_NONE) || (blendMode == SDL_BLENDMODE_BLEND))
+		&& (SDL_GetTextureColorMod(texture, &r, &g, &b) == 0) && (SDL_GetTextureAlphaMod(texture, &a) == 0);
+
+	result.pixels = supported ? pixelsOf(texture) : nullptr;
+
+	if (!result.pixels) {
+		flush();
+		++rasterStats.declined;
+		return false;
+	}
+
+	result.blend = (blendMode == SDL_BLENDMODE_BLEND);
+	result.modulation = (static_cast<Uint32>(a) << 24) | (static_cast<Uint32>(r) << 16) | (static_cast<Uint32>(g) << 8) | b;
+
+	return true;
+}
+
+void TileRasterizer::queue(const SpriteTexture& texture, const SDL_Rect *sourceArea, SDL_Rect destination) {
+	const auto *pixels = texture.pixels;
+	auto source = sourceArea ? *sourceArea : SDL_Rect { 0, 0, pixels->width, pixels->height };
+
+	// Like SDL_RenderCopy, a source reaching outside the texture is clipped and the destination scaled along with it
+	SDL_Rect inside;
+
+	if (!intersect(source, SDL_Rect { 0, 0, pixels->width, pixels->height }, inside) || (destination.w <= 0) || (destination.h <= 0)) {
+		return;
+	}
+
+	if ((inside.x != source.x) || (inside.y != source.y) || (inside.w != source.w) || (inside.h != source.h)) {
+		const auto scaleX = static_cast<double>(destination.w) / source.w;
+		const auto scaleY = static_cast<double>(destination.h) / source.h;
+
+		destination = SDL_Rect {
+			destination.x + static_cast<int>(std::lround((inside.x - source.x) * scaleX)),
+			destination.y + static_cast<int>(std::lround((inside.y - source.y) * scaleY)),
+			static_cast<int>(std::lround(inside.w * scaleX)),
+			static_cast<int>(std::lround(inside.h * scaleY))
+		};
+
+		source = inside;
+	}
+
+	SDL_Rect visible;
+
+	if (!intersect(destination, SDL_Rect { 0, 0, width, height }, visible)) {
+		return;
+	}
+
+	// Alpha modulation under SDL_BLENDMODE_NONE changes nothing that ends up on the target
+	const auto modulation = texture.blend ? texture.modulation : (texture.modulation | 0xFF000000);
+	const auto blit = selectBlit(texture.blend, source.w != destination.w, modulation != 0xFFFFFFFF);
+
+	sprites.push_back(Sprite { pixels, source, destination, blit, modulation });
+
+	firstTileX = std::min(firstTileX, visible.x / RASTER_TILE_SIZE);
+	firstTileY = std::min(firstTileY, visible.y / RASTER_TILE_SIZE);
+	lastTileX = std::max(lastTileX, (visible.x + visible.w - 1) / RASTER_TILE_SIZE);
+	lastTileY = std::max(lastTileY, (visible.y + visible.h - 1) / RASTER_TILE_SIZE);
+}
+
+bool TileRasterizer::copy(SDL_Texture *texture, const SDL_Rect *source, const SDL_Rect *destination) {
+	SpriteTexture resolved;
+
+	if (!resolve(texture, resolved)) {
+		return false;
+	}
+
+	queue(resolved, source, destination ? *destination : SDL_Rect { 0, 0, width, height });
+	return true;
+}
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+
+bool TileRasterizer::drawQuads(SDL_Texture *texture, const SDL_Vertex *quadVertices, std::size_t vertexCount) {
+	// The whole run shares a texture, so it's only looked at once
+	SpriteTexture resolved;
+
+	if (!resolve(texture, resolved)) {
+		return false;
+	}
+
+	const auto textureWidth = resolved.pixels->width;
+	const auto textureHeight = resolved.pixels->height;
+
+	for (std::size_t i = 0; i + 4 <= vertexCount; i += 4) {
+		// SpriteBatch quads go top left, top right, bottom right, bottom left
+		const auto& topLeft = quadVertices[i];
+		const auto& bottomRight = quadVertices[i + 2];
+
+		const auto x = static_cast<int>(std::lround(topLeft.position.x));
+		const auto y = static_cast<int>(std::lround(topLeft.position.y));
+		const auto u = static_cast<int>(std::lround(topLeft.tex_coord.x * textureWidth));
+		const auto v = static_cast<int>(std::lround(topLeft.tex_coord.y * textureHeight));
+
+		const SDL_Rect destination { x, y, static_cast<int>(std::lround(bottomRight.position.x)) - x, static_cast<int>(std::lround(bottomRight.position.y)) - y };
+		const SDL_Rect source { u, v,
+			static_cast<int>(std::lround(bottomRight.tex_coord.x * textureWidth)) - u,
+			static_cast<int>(std::lround(bottomRight.tex_coord.y * textureHeight)) - v };
+
+		queue(resolved, &source, destination);
+	}
+
+	return true;
+}
+
+#endif
+
+template <typename Blend, typename Scale, typename Modulation>
+void TileRasterizer::blitSprite(const Sprite& sprite, const SDL_Rect& area, Uint32 *framebuffer, int width) {
+	const auto& texture = *sprite.texture;
+	const auto& source = sprite.source;
+	const auto& destination = sprite.destination;
+
+	// 16.16 fixed point steps through the source, sampling each destination pixel's center
+	const auto stepX = (static_cast<Sint64>(source.w) << 16) / destination.w;
+	const auto stepY = (static_cast<Sint64>(source.h) << 16) / destination.h;
+	const auto offset = area.x - destination.x;
+
+	Uint32 sampled[RASTER_TILE_SIZE];
+	Uint32 modulated[RASTER_TILE_SIZE];
+
+	for (auto y = area.y; y < area.y + area.h; ++y) {
+		const auto sourceY = source.y + static_cast<int>(((y - destination.y) * stepY + stepY / 2) >> 16);
+		const auto *sourceRow = texture.pixels.data() + static_cast<std::size_t>(sourceY) * texture.width + source.x;
+
+		const auto *span = sampleRow(Scale(), sourceRow, offset, stepX, area.w, sampled);
+		span = modulateRow(Modulation(), span, sprite.modulation, area.w, modulated);
+
+		writeRow(Blend(), span, framebuffer + static_cast<std::size_t>(y) * width + area.x, area.w);
+	}
+}
+
+TileRasterizer::BlitFunction TileRasterizer::selectBlit(bool blend, bool scaled, bool modulated) {
+	static const BlitFunction blits[] = {
+		&blitSprite<Opaque, Unscaled, Unmodulated>,
+		&blitSprite<Opaque, Unscaled, Modulated>,
+		&blitSprite<Opaque, Scaled, Unmodulated>,
+		&blitSprite<Opaque, Scaled, Modulated>,
+		&blitSprite<Blended, Unscaled, Unmodulated>,
+		&blitSprite<Blended, Unscaled, Modulated>,
+		&blitSprite<Blended, Scaled, Unmodulated>,
+		&blitSprite<Blended, Scaled, Modulated>
+	};
+
+	return blits[(blend ? 4 : 0) + (scaled ? 2 : 0) + (modulated ? 1 : 0)];
+}
+
+void TileRasterizer::rasterizeTile(int tileX, int tileY) {
+	const SDL_Rect tile {
+		tileX * RASTER_TILE_SIZE,
+		tileY * RASTER_TILE_SIZE,
+		std::min(RASTER_TILE_SIZE, width - tileX * RASTER_TILE_SIZE),
+		std::min(RASTER_TILE_SIZE, height - tileY * RASTER_TILE_SIZE)
+	};
+
+	// Whatever the last flush left here would be uploaded again otherwise
+	for (auto y = tile.y; y < tile.y + tile.h; ++y) {
+		std::memset(framebuffer.data() + static_cast<std::size_t>(y) * width + tile.x, 0, tile.w * sizeof(Uint32));
+	}
+
+	const auto index = static_cast<std::size_t>(tileY) * tilesAcross + tileX;
+
+	for (auto i = binStart[index]; i < binStart[index + 1]; ++i) {
+		const auto& sprite = sprites[binned[i]];
+		SDL_Rect area;
+
+		if (intersect(sprite.destination, tile, area)) {
+			sprite.blit(sprite, area, framebuffer.data(), width);
+		}
+	}
+}
+
+void TileRasterizer::flush() {
+	if (sprites.empty()) {
+		return;
+	}
+
+	PROFILE_SCOPE("TileRasterizer::flush");
+
+	const auto tileRange = [](int first, int size) {
+		return std::make_pair(std::max(first, 0) / RASTER_TILE_SIZE, (first + size - 1) / RASTER_TILE_SIZE);
+	};
+
+	// Binning is a counting sort: count each tile's sprites, turn the counts into offsets, then fill
+	// the bins in drawing order, so every tile sees its sprites in the order they were drawn
+	std::fill(binStart.begin(), binStart.end(), 0);
+
+	for (const auto& sprite : sprites) {
+		const auto columns = tileRange(sprite.destination.x, sprite.destination.w);
+		const auto rows = tileRange(sprite.destination.y, sprite.destination.h);
+
+		for (auto row = rows.first; row <= std::min(rows.second, tilesDown - 1); ++row) {
+			for (auto column = columns.first; column <= std::min(columns.second, tilesAcross - 1); ++column) {
+				++binStart[static_cast<std::size_t>(row) * tilesAcross + column + 1];
+			}
+		}
+	}
+
+	for (std::size_t i = 1; i < binStart.size(); ++i) {
+		binStart[i] += binStart[i - 1];
+	}
+
+	binned.resize(binStart.back());
+
+	// binStart[i] is used as the fill position while filling; afterwards it has moved on to where
+	// tile i + 1 starts, so shifting everything back one place restores the offsets
+	for (Uint32 i = 0; i < sprites.size(); ++i) {
+		const auto& sprite = sprites[i];
+		const auto columns = tileRange(sprite.destination.x, sprite.destination.w);
+		const auto rows = tileRange(sprite.destination.y, sprite.destination.h);
+
+		for (auto row = rows.first; row <= std::min(rows.second, tilesDown - 1); ++row) {
+			for (auto column = columns.first; column <= std::min(columns.second, tilesAcross - 1); ++column) {
+				binned[binStart[static_cast<std::size_t>(row) * tilesAcross + column]++] = i;
+			}
+		}
+	}
+
+	for (auto i = binStart.size() - 1; i > 0; --i) {
+		binStart[i] = binStart[i - 1];
+	}
+
+	binStart[0] = 0;
+
+	// Only the tiles inside the area that was drawn to are rasterized and uploaded
+	const auto columns = lastTileX - firstTileX + 1;
+	const auto rows = lastTileY - firstTileY + 1;
+	const auto tileCount = static_cast<std::size_t>(columns) * rows;
+
+	const auto rasterize = [&](std::size_t first, std::size_t last) {
+		for (auto i = first; i < last; ++i) {
+			rasterizeTile(firstTileX + static_cast<int>(i % columns), firstTileY + static_cast<int>(i / columns));
+		}
+	};
+
+	if (jobs) {
+		jobs->parallelFor(tileCount, TILE_JOB_GRAIN, rasterize);
+	} else {
+		rasterize(0, tileCount);
+	}
+
+	const SDL_Rect area {
+		firstTileX * RASTER_TILE_SIZE,
+		firstTileY * RASTER_TILE_SIZE,
+		std::min(columns * RASTER_TILE_SIZE, width - firstTileX * RASTER_TILE_SIZE),
+		std::min(rows * RASTER_TILE_SIZE, height - firstTileY * RASTER_TILE_SIZE)
+	};
+
+	if (!layer) {
+		layer = pool.acquire(width, height);
+
+		if (layer) {
+			SDL_SetTextureBlendMode(layer.get(), SDL_BLENDMODE_BLEND);
+		} else {
+			LogSDLError(std::cerr, "TileRasterizer CreateTexture");
+		}
+	}
+
+	const auto *pixels = framebuffer.data() + static_cast<std::size_t>(area.y) * width + area.x;
+
+	if (layer && layer.update(area, pixels, width * static_cast<int>(sizeof(Uint32)))) {
+		SDL_RenderCopy(renderer, layer.get(), &area, &area);
+		RenderStats::instance().countDraw(layer.get(), 4);
+	}
+
+	rasterStats.sprites += sprites.size();
+	rasterStats.tiles += tileCount;
+	++rasterStats.flushes;
+
+	sprites.clear();
+	firstTileX = tilesAcross;
+	firstTileY = tilesDown;
+	lastTileX = -1;
+	lastTileY = -1;
+}
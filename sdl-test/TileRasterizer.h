@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+#include "StreamingTexture.h"
+
+class JobSystem;
+
+// Tiles are square; 64 pixels of ARGB8888 is 16 KB a tile, which sits comfortably in L1/L2
+const int RASTER_TILE_SIZE = 64;
+
+struct RasterStats {
+	std::size_t sprites = 0;
+	std::size_t tiles = 0;
+	std::size_t flushes = 0;
+
+	// Draws handed back to the renderer because they use something the rasterizer doesn't do
+	std::size_t declined = 0;
+};
+
+/** Class: TileRasterizer
+ *
+ *  Description:
+ *  Draws sprites on the CPU, for when the renderer is SDL's software renderer and every copy it
+ *  makes would be a single-threaded blit. It takes the same draws a SpriteBatch makes (copies, and
+ *  quads as SpriteBatch builds them: axis aligned, white, four vertices apiece) and queues them.
+ *  flush() then splits the frame into RASTER_TILE_SIZE tiles, bins every queued sprite into the
+ *  tiles it covers in the order it was drawn, and blits the tiles in parallel on the JobSystem with
+ *  the SIMD blend kernel. The tiles that were drawn to are uploaded into a streaming texture and
+ *  copied onto the renderer's current target with a single SDL_RenderCopy, so everything drawn
+ *  through the renderer before and after stays in order with the sprites.
+ *
+ *  Every combination of blend mode, color modulation and scaling has its own blit loop,
+ *  instantiated from a template, so the loops over pixels never branch on any of them. The loop
+ *  is picked per sprite when it's queued, not once per batch: a batch shares a texture, and with
+ *  it the blend mode, but each sprite has its own scale and takes the texture's modulation as it
+ *  was when the sprite was drawn. Picking one is a table lookup, next to the pixels it then blits.
+ *
+ *  The rasterizer draws into a transparent layer the size of the target (in the renderer's logical
+ *  coordinates, so render scale still applies). Opaque and fully transparent pixels, which is what
+ *  color keyed sprites and the bitmap font are made of, come out exactly as the renderer would
+ *  draw them; where translucent pixels overlap they come out a little darker. Only sprites with
+ *  SDL_BLENDMODE_NONE or SDL_BLENDMODE_BLEND are taken, with any color and alpha modulation;
+ *  copy() and drawQuads() return false for anything else, after flushing what's queued, so the
+ *  caller can draw it through the renderer. The renderer's clip rectangle isn't applied.
+ *
+ *  The pixels of a texture are read back from the renderer the first time it's drawn and kept
+ *  until forgetTextures(), which has to be called whenever textures may have been replaced or
+ *  changed. Like the renderer it draws onto, the rasterizer may only be used on the thread that
+ *  owns the renderer; the tile jobs themselves only ever touch its own memory.
+ *
+ */
+
+class TileRasterizer {
+public:
+	TileRasterizer(StreamingTexturePool& pool, JobSystem *jobs, int width, int height);
+	TileRasterizer(const TileRasterizer&) = delete;
+	TileRasterizer& operator=(const TileRasterizer&) = delete;
+
+	bool copy(SDL_Texture *texture, const SDL_Rect *source, const SDL_Rect *destination);
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	bool drawQuads(SDL_Texture *texture, const SDL_Vertex *quadVertices, std::size_t vertexCount);
+#endif
+
+	void flush();
+	void forgetTextures();
+
+	const RasterStats& stats() const { return rasterStats; }
+
+private:
+	struct TexturePixels {
+		int width = 0;
+		int height = 0;
+
+		// Empty if the texture couldn't be read back, in which case it's never drawn
+		std::vector<Uint32> pixels;
+	};
+
+	struct Sprite;
+
+	// Draws the part of a sprite inside area into the framebuffer, which is width pixels across
+	using BlitFunction = void (*)(const Sprite& sprite, const SDL_Rect& area, Uint32 *framebuffer, int width);
+
+	struct Sprite {
+		const TexturePixels *texture;
+		SDL_Rect source;
+		SDL_Rect destination;
+		BlitFunction blit;
+
+		// The texture's color and alpha modulation, as ARGB8888
+		Uint32 modulation;
+	};
+
+	// What sprites drawn with a texture need from it, looked up once per copy or run of quads
+	struct SpriteTexture {
+		const TexturePixels *pixels;
+		bool blend;
+		Uint32 modulation;
+	};
+
+	template <typename Blend, typename Scale, typename Modulation>
+	static void blitSprite(const Sprite& sprite, const SDL_Rect& area, Uint32 *framebuffer, int width);
+	static BlitFunction selectBlit(bool blend, bool scaled, bool modulated);
+
+	const TexturePixels* pixelsOf(SDL_Texture *texture);
+	bool readBack(SDL_Texture *texture, TexturePixels& result);
+	bool resolve(SDL_Texture *texture, SpriteTexture& result);
+	void queue(const SpriteTexture& texture, const SDL_Rect *sourceArea, SDL_Rect destination);
+	void rasterizeTile(int tileX, int tileY);
+
+	StreamingTexturePool& pool;
+	SDL_Renderer *renderer;
+	JobSystem *jobs;
+	int width;
+	int height;
+	int tilesAcross;
+	int tilesDown;
+
+	std::vector<Uint32> framebuffer;
+	StreamingTexture layer;
+
+	std::unordered_map<SDL_Texture*, TexturePixels> textures;
+	std::vector<Sprite> sprites;
+
+	// Sprites per tile, as a counting sort: tile i's sprites are binned[binStart[i]..binStart[i + 1])
+	std::vector<Uint32> binStart;
+	std::vector<Uint32> binned;
+
+	// Tiles covered by anything queued since the last flush, inclusive
+	int firstTileX;
+	int firstTileY;
+	int lastTileX = -1;
+	int lastTileY = -1;
+
+	RasterStats rasterStats;
+};
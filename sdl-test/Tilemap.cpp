@@ -0,0 +1,149 @@
+#include "Tilemap.h"
+
+#include <algorithm>
+
+#include "Profiler.h"
+#include "SpriteBatch.h"
+
+namespace {
+	int divideRoundingUp(int value, int divisor) {
+		return (value + divisor - 1) / divisor;
+	}
+
+	// Floor division, so tiles left of or above the map come out negative rather than as tile 0
+	int divideRoundingDown(int value, int divisor) {
+		return (value >= 0) ? value / divisor : -((-value + divisor - 1) / divisor);
+	}
+}
+
+Tilemap::Tilemap(int columns, int rows, int tileWidth, int tileHeight)
+	: mapColumns(std::max(columns, 0)), mapRows(std::max(rows, 0)),
+	  tileW(std::max(tileWidth, 1)), tileH(std::max(tileHeight, 1)),
+	  chunkColumns(divideRoundingUp(mapColumns, TILEMAP_CHUNK_SIZE)),
+	  chunkRows(divideRoundingUp(mapRows, TILEMAP_CHUNK_SIZE)),
+	  chunks(static_cast<std::size_t>(chunkColumns) * chunkRows) {
+}
+
+void Tilemap::setTileset(std::vector<AtlasRegion> regions) {
+	tileset = std::move(regions);
+}
+
+void Tilemap::set(int column, int row, TileId tile) {
+	if ((column < 0) || (row < 0) || (column >= mapColumns) || (row >= mapRows)) {
+		return;
+	}
+
+	auto& chunk = chunks[static_cast<std::size_t>(row / TILEMAP_CHUNK_SIZE) * chunkColumns + column / TILEMAP_CHUNK_SIZE];
+
+	if (!chunk) {
+		if (tile == TILEMAP_EMPTY_TILE) {
+			return;
+		}
+
+		chunk.reset(new Chunk());
+	}
+
+	auto& slot = chunk->tiles[(row % TILEMAP_CHUNK_SIZE) * TILEMAP_CHUNK_SIZE + column % TILEMAP_CHUNK_SIZE];
+
+	if ((slot == TILEMAP_EMPTY_TILE) && (tile != TILEMAP_EMPTY_TILE)) {
+		++chunk->occupied;
+	} else if ((slot != TILEMAP_EMPTY_TILE) && (tile == TILEMAP_EMPTY_TILE)) {
+		--chunk->occupied;
+	}
+
+	slot = tile;
+
+	// Chunks that empty out again go back to costing nothing
+	if (chunk->occupied == 0) {
+		chunk.reset();
+	}
+}
+
+TileId Tilemap::at(int column, int row) const {
+	if ((column < 0) || (row < 0) || (column >= mapColumns) || (row >= mapRows)) {
+		return TILEMAP_EMPTY_TILE;
+	}
+
+	const auto& chunk = chunks[static_cast<std::size_t>(row / TILEMAP_CHUNK_SIZE) * chunkColumns + column / TILEMAP_CHUNK_SIZE];
+
+	return chunk ? chunk->tiles[(row % TILEMAP_CHUNK_SIZE) * TILEMAP_CHUNK_SIZE + column % TILEMAP_CHUNK_SIZE] : TILEMAP_EMPTY_TILE;
+}
+
+void Tilemap::fill(const SDL_Rect& area, TileId tile) {
+	const auto left = std::max(area.x, 0);
+	const auto top = std::max(area.y, 0);
+	const auto right = std::min(area.x + area.w, mapColumns);
+	const auto bottom = std::min(area.y + area.h, mapRows);
+
+	for (auto row = top; row < bottom; ++row) {
+		for (auto column = left; column < right; ++column) {
+			set(column, row, tile);
+		}
+	}
+}
+
+void Tilemap::draw(SpriteBatch& batch, const SDL_Rect& camera, int layer) {
+	draw(batch, camera, SDL_Rect { 0, 0, camera.w, camera.h }, layer);
+}
+
+void Tilemap::draw(SpriteBatch& batch, const SDL_Rect& camera, const SDL_Rect& screenRegion, int layer) {
+	PROFILE_SCOPE("Tilemap::draw");
+
+	drawStats = TilemapStats {};
+
+	// The part of the map actually wanted, in map pixels, turned into a range of tiles
+	SDL_Rect visible;
+	const SDL_Rect region { camera.x + screenRegion.x, camera.y + screenRegion.y, screenRegion.w, screenRegion.h };
+
+	if (!SDL_IntersectRect(&camera, &region, &visible)) {
+		return;
+	}
+
+	const auto firstColumn = std::max(divideRoundingDown(visible.x, tileW), 0);
+	const auto firstRow = std::max(divideRoundingDown(visible.y, tileH), 0);
+	const auto lastColumn = std::min(divideRoundingDown(visible.x + visible.w - 1, tileW), mapColumns - 1);
+	const auto lastRow = std::min(divideRoundingDown(visible.y + visible.h - 1, tileH), mapRows - 1);
+
+	if ((firstColumn > lastColumn) || (firstRow > lastRow)) {
+		return;
+	}
+
+	for (auto chunkRow = firstRow / TILEMAP_CHUNK_SIZE; chunkRow <= lastRow / TILEMAP_CHUNK_SIZE; ++chunkRow) {
+		for (auto chunkColumn = firstColumn / TILEMAP_CHUNK_SIZE; chunkColumn <= lastColumn / TILEMAP_CHUNK_SIZE; ++chunkColumn) {
+			const auto *chunk = chunks[static_cast<std::size_t>(chunkRow) * chunkColumns + chunkColumn].get();
+
+			if (!chunk) {
+				continue;
+			}
+
+			++drawStats.visibleChunks;
+
+			// The visible tiles of this chunk, relative to the chunk
+			const auto chunkLeft = chunkColumn * TILEMAP_CHUNK_SIZE;
+			const auto chunkTop = chunkRow * TILEMAP_CHUNK_SIZE;
+
+			const auto left = std::max(firstColumn, chunkLeft) - chunkLeft;
+			const auto top = std::max(firstRow, chunkTop) - chunkTop;
+			const auto right = std::min(lastColumn, chunkLeft + TILEMAP_CHUNK_SIZE - 1) - chunkLeft;
+			const auto bottom = std::min(lastRow, chunkTop + TILEMAP_CHUNK_SIZE - 1) - chunkTop;
+
+			for (auto row = top; row <= bottom; ++row) {
+				const auto *tiles = chunk->tiles + row * TILEMAP_CHUNK_SIZE;
+				const auto y = (chunkTop + row) * tileH - camera.y;
+
+				for (auto column = left; column <= right; ++column) {
+					const auto tile = tiles[column];
+
+					if ((tile == TILEMAP_EMPTY_TILE) || (tile > tileset.size())) {
+						continue;
+					}
+
+					const SDL_Rect destination { (chunkLeft + column) * tileW - camera.x, y, tileW, tileH };
+
+					batch.draw(tileset[tile - 1], destination, layer);
+					++drawStats.drawnTiles;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <SDL/SDL.h>
+
+#include "TextureAtlas.h"
+
+class SpriteBatch;
+
+// Tile 0 is always empty; tile n draws the n-th region of the tileset
+using TileId = Uint16;
+
+const auto TILEMAP_EMPTY_TILE = TileId { 0 };
+
+// Tiles per side of a chunk; a chunk of 16-bit ids is 2 KB, which keeps a whole chunk in L1
+const auto TILEMAP_CHUNK_SIZE = 32;
+
+struct TilemapStats {
+	std::size_t visibleChunks = 0;
+	std::size_t drawnTiles = 0;
+};
+
+/** Class: Tilemap
+ *
+ *  Description:
+ *  A grid of fixed-size tiles, each an index into a tileset of atlas regions. The map is stored as
+ *  square chunks of TILEMAP_CHUNK_SIZE tiles a side, and a chunk is only allocated once something
+ *  is placed in it, so large maps that are mostly empty take little memory.
+ *
+ *  draw() works out which tiles the camera can see straight from its rectangle and walks only
+ *  those, skipping chunks that were never allocated and tiles that are empty. A frame costs the
+ *  same whether the map is a screen's worth of tiles or hundreds of thousands of them.
+ *
+ *  The camera is a rectangle in map pixels; its top-left corner is drawn at the top-left of the
+ *  current render target.
+ *
+ */
+
+class Tilemap {
+public:
+	Tilemap(int columns, int rows, int tileWidth, int tileHeight);
+	Tilemap(const Tilemap&) = delete;
+	Tilemap& operator=(const Tilemap&) = delete;
+
+	// Regions are drawn stretched to the tile size when they're not already that size
+	void setTileset(std::vector<AtlasRegion> regions);
+
+	void set(int column, int row, TileId tile);
+	TileId at(int column, int row) const;
+
+	void fill(const SDL_Rect& area, TileId tile);
+
+	void draw(SpriteBatch& batch, const SDL_Rect& camera, int layer = 0);
+
+	// As above, but only tiles overlapping screenRegion (in render target pixels) are drawn
+	void draw(SpriteBatch& batch, const SDL_Rect& camera, const SDL_Rect& screenRegion, int layer = 0);
+
+	int columns() const { return mapColumns; }
+	int rows() const { return mapRows; }
+	int tileWidth() const { return tileW; }
+	int tileHeight() const { return tileH; }
+
+	// Size of the whole map in pixels
+	int pixelWidth() const { return mapColumns * tileW; }
+	int pixelHeight() const { return mapRows * tileH; }
+
+	// Counts for the most recent draw()
+	const TilemapStats& stats() const { return drawStats; }
+
+private:
+	struct Chunk {
+		TileId tiles[TILEMAP_CHUNK_SIZE * TILEMAP_CHUNK_SIZE] {};
+		std::size_t occupied = 0;
+	};
+
+	int mapColumns;
+	int mapRows;
+	int tileW;
+	int tileH;
+	int chunkColumns;
+	int chunkRows;
+	std::vector<std::unique_ptr<Chunk>> chunks;
+	std::vector<AtlasRegion> tileset;
+	TilemapStats drawStats;
+};
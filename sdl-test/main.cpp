@@ -1,54 +1,212 @@
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <SDL/SDL.h>
 
+#include "Animation.h"
+#include "AssetPaths.h"
+#include "AsyncLoader.h"
+#include "BitmapFont.h"
+#include "FileWatcher.h"
+#include "FrameCapture.h"
+#include "FrameLoop.h"
+#include "ImageCodec.h"
+#include "Input.h"
+#include "JobSystem.h"
+#include "Log.h"
+#include "MetricsSocket.h"
+#include "Profiler.h"
+#include "RenderStats.h"
+#include "RenderTargetChain.h"
+#include "RendererCaps.h"
+#include "RenderThread.h"
+#include "RetainedLayer.h"
+#include "SDLHandles.h"
+#include "SpatialGrid.h"
+#include "SpriteBatch.h"
+#include "SpriteStore.h"
+#include "StreamingTexture.h"
+#include "TextureCache.h"
+#include "TexturePack.h"
+#include "Tilemap.h"
+#include "TileRasterizer.h"
+
 const auto SCREEN_WIDTH = 640;
 const auto SCREEN_HEIGHT = 480;
 
-void LogSDLError(std::ostream& os, const std::string& errorMessage) {
-	os << errorMessage << " error: " << SDL_GetError() << '\n';
+// Upper bound on texture memory the cache keeps around for textures nobody is using
+const auto TEXTURE_BUDGET_BYTES = std::size_t { 256 } * 1024 * 1024;
+
+// Time per frame the render thread may spend turning decoded images into textures
+const auto UPLOAD_BUDGET_MS = 2.0;
+
+// Pixel format texture packs are converted to; this is what the Direct3D and OpenGL renderers use natively
+const auto PACK_PIXEL_FORMAT = SDL_PIXELFORMAT_ARGB8888;
+
+// Size of each square atlas page, shrunk to fit if the renderer's texture size limit is lower
+const auto ATLAS_PAGE_SIZE = 1024;
+
+// Cell size of the scene's spatial grid, roughly the size of a sprite
+const auto SCENE_CELL_SIZE = 128;
+
+// Sprites per job when sprite updates are split across cores
+const auto SPRITE_JOB_GRAIN = std::size_t { 4096 };
+
+// How fast and how far either side of center the foreground drifts, in pixels
+const auto DRIFT_SPEED = 60.0f;
+const auto DRIFT_RANGE = 100;
+
+// Playback rate when the foreground is an animation strip, and animations per job when they're split across cores
+const auto FOREGROUND_FPS = 8.0f;
+const auto ANIMATION_JOB_GRAIN = std::size_t { 8192 };
+
+// Streaming textures kept around for reuse once nobody is using them
+const auto STREAMING_POOL_IDLE_BYTES = std::size_t { 16 } * 1024 * 1024;
+
+// Where the HUD's text starts, how much it's magnified, and the column its values line up in
+const auto HUD_MARGIN = 8;
+const auto HUD_SCALE = 2;
+const auto HUD_VALUE_COLUMN = 13;
+
+// Colors in the HUD font's palette
+const std::size_t HUD_TEXT = 0;
+const std::size_t HUD_SHADOW = 1;
+const std::size_t HUD_WARNING = 2;
+
+// Side of the square indicator shown while the scene loads, and the width of its stripes
+const auto LOADING_SIZE = 64;
+const auto LOADING_STRIPE = 8;
+
+int packTextures(int argc, char *argv[]) {
+	if (argc < 4) {
+		std::cerr << "usage: " << argv[0] << " --pack <output.tpak> <image.bmp>...\n";
+		return EXIT_FAILURE;
+	}
+
+	if (SDL_Init(0)) {
+		LogSDLError(std::cerr, "SDL_Init");
+		return EXIT_FAILURE;
+	}
+
+	const std::vector<std::string> inputs(argv + 3, argv + argc);
+	const auto packed = writeTexturePack(argv[2], inputs, PACK_PIXEL_FORMAT);
+
+	SDL_Quit();
+	return packed ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-SDL_Texture* loadTexture(const std::string& filename, SDL_Renderer *renderer) {
-	// Initialize to nullptr to avoid dangling pointer issues
-	SDL_Texture *texture = nullptr;
+int compressImages(int argc, char *argv[]) {
+	if (argc < 3) {
+		std::cerr << "usage: " << argv[0] << " --qoi <image.bmp>...\n";
+		return EXIT_FAILURE;
+	}
+
+	if (SDL_Init(0)) {
+		LogSDLError(std::cerr, "SDL_Init");
+		return EXIT_FAILURE;
+	}
 
-	// Load the image
-	SDL_Surface *loadedImage = SDL_LoadBMP(filename.c_str());
+	auto exitCode = EXIT_SUCCESS;
 
-	// If the loading went ok, convert to texture and return the texture
-	if (loadedImage != nullptr) {
-		texture = SDL_CreateTextureFromSurface(renderer, loadedImage);
-		SDL_FreeSurface(loadedImage);
+	for (auto i = 2; i < argc; ++i) {
+		const std::string input = argv[i];
+		const auto output = compressedImagePath(input);
 
-		// Make sure everything went ok, too
-		if (texture == nullptr) {
-			LogSDLError(std::cerr, "LoadBMP");
+		// Read the BMP itself; loadImage would hand back the old .qoi if there already is one
+		auto image = loadImageFile(input);
+
+		if (output.empty() || !image || !writeQOI(output, image.get())) {
+			std::cerr << "Could not convert " << input << ": " << (output.empty() ? "not a .bmp" : SDL_GetError()) << '\n';
+			exitCode = EXIT_FAILURE;
 		}
-	} else {
-		LogSDLError(std::cerr, "LoadBMP");
 	}
 
-	return texture;
+	SDL_Quit();
+	return exitCode;
 }
 
-void RenderTexture(SDL_Texture *texture, SDL_Renderer *renderer, int x, int y) {
-	// Setup the destination rectangle to be at the position we want
-	SDL_Rect destination;
-	destination.x = x;
-	destination.y = y;
+bool hasArgument(int argc, char *argv[], const std::string& flag) {
+	return std::find(argv + 1, argv + argc, flag) != argv + argc;
+}
+
+std::string argumentValue(int argc, char *argv[], const std::string& prefix) {
+	for (auto i = 1; i < argc; ++i) {
+		const std::string argument = argv[i];
+
+		if (argument.compare(0, prefix.size(), prefix) == 0) {
+			return argument.substr(prefix.size());
+		}
+	}
+
+	return std::string();
+}
 
-	// Query the texture to get its width and height to use
-	SDL_QueryTexture(texture, NULL, NULL, &destination.w, &destination.x);
-	SDL_RenderCopy(renderer, texture, NULL, &destination);
+// Diagonal stripes that move along by a pixel every frame
+void drawLoadingPattern(Uint32 *pixels, int size, int frame) {
+	for (auto y = 0; y < size; ++y) {
+		for (auto x = 0; x < size; ++x) {
+			const auto light = ((x + y + frame) / LOADING_STRIPE) % 2 != 0;
+			pixels[y * size + x] = light ? 0xFFE0E0E0 : 0xFF404040;
+		}
+	}
 }
 
+FrameLoopConfig parseFrameLoopConfig(int argc, char *argv[]) {
+	FrameLoopConfig config;
 
+	for (auto i = 1; i < argc; ++i) {
+		const std::string argument = argv[i];
+
+		if (argument == "--vsync") {
+			config.mode = PacingMode::VSync;
+		} else if (argument == "--uncapped") {
+			config.mode = PacingMode::Uncapped;
+		} else if (argument.compare(0, 6, "--fps=") == 0) {
+			config.mode = PacingMode::TargetFps;
+			config.targetFps = std::max(std::atof(argument.c_str() + 6), 1.0);
+		}
+	}
+
+	return config;
+}
 
 int main(int argc, char *argv[])
 {
+	/** Offline texture packing
+	 *
+	 *  Description:
+	 *  Running "sdl-test --pack <output.tpak> <image.bmp>..." converts the given images to the
+	 *  renderer's pixel format ahead of time and writes them into a single texture pack, then exits
+	 *  without ever opening a window. At startup the pack is memory-mapped and its images are
+	 *  uploaded directly from the mapping.
+	 *
+	 */
+
+	if ((argc > 1) && (std::string(argv[1]) == "--pack")) {
+		return packTextures(argc, argv);
+	}
+
+	// "sdl-test --qoi <image.bmp>..." writes a QOI copy next to each image, which is loaded in its place from then on
+	if ((argc > 1) && (std::string(argv[1]) == "--qoi")) {
+		return compressImages(argc, argv);
+	}
+
+	// "sdl-test --list-renderers" shows which render drivers this SDL has, for use with --renderer=<name>
+	if (hasArgument(argc, argv, "--list-renderers")) {
+		for (const auto& driver : renderDrivers()) {
+			printRendererCaps(std::cout, driver);
+		}
+
+		return EXIT_SUCCESS;
+	}
+
 	/** Function: SDL_Init
 	 *
 	 *  Description:
@@ -58,11 +216,14 @@ int main(int argc, char *argv[])
 	 *  initialized automatically when the video system is if not explicitly requested by
 	 *  itself while the file I/O and threading systems are initialized by default. If
 	 *  everything goes ok, SDL_Init will return 0; if not, we'll want to print out the
-	 *  error and exit.
+	 *  error and exit. SDLContext makes the call for us and calls SDL_Quit when main returns,
+	 *  whichever way it returns.
 	 *
 	 */
 
-	if (SDL_Init(SDL_INIT_VIDEO)) {
+	SDLContext sdl(SDL_INIT_VIDEO);
+
+	if (!sdl) {
 		LogSDLError(std::cerr, "SDL_Init");
 
 		return EXIT_FAILURE;
@@ -75,7 +236,8 @@ int main(int argc, char *argv[])
 	 *  which takes a title for the window, the x and y position to create it at, the window width
 	 *  and height, and some flags to set properties of the window, and then returns an
 	 *  SDL_Window pointer (*). This pointer will be NULL if anything went wrong when creating the
-	 *  window. If an error does occur, we need to clean up SDL before exiting the program.
+	 *  window. We hold on to it through a WindowPtr, which destroys the window when it goes out of
+	 *  scope, so there's nothing to clean up by hand if something goes wrong later on.
 	 *
 	 *  Parameters: 
 	 *              Window Title
@@ -89,12 +251,11 @@ int main(int argc, char *argv[])
 	 *
 	 */
 
-	SDL_Window *mainWindow = SDL_CreateWindow("Hello, World!", 100, 100, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+	WindowPtr mainWindow(SDL_CreateWindow("Hello, World!", 100, 100, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN));
 
 	if (!mainWindow) {
 		LogSDLError(std::cerr, "CreateWindow");
-		
-		SDL_Quit();
+
 		return EXIT_FAILURE;
 	}
 
@@ -104,10 +265,14 @@ int main(int argc, char *argv[])
 	 *  Now we can create a renderer to draw to the window using SDL_CreateRenderer. This function 
 	 *  takes the window to associate the renderer with, the index of the redendering driver to be
 	 *  used (or -1 to select the first that meets our requirements), and various flags used to 
-	 *  specify what sort of renderer we want. Here we're requesting a hardware accelerated renderer
-	 *  with vsync enabled. We'll get back an SDL_Renderer pointer (*) which will be NULL if something
-	 *  went wrong. If an error does occur, we need to clean up anything we've previously created and
-	 *  quit SDL before exiting the program.
+	 *  specify what sort of renderer we want. Rather than take whichever driver SDL lists first, we
+	 *  pick the one that's usually fastest on this platform, unless --renderer=<name> or the
+	 *  SDL_RENDER_DRIVER hint asks for a particular one. Here we're requesting a hardware accelerated renderer
+	 *  that can render to textures, with vsync enabled unless the frame loop was asked to pace itself
+	 *  (--fps=N) or run uncapped. We'll get back an SDL_Renderer pointer (*) which will be NULL if
+	 *  something went wrong. Like the window, it's owned by a handle that destroys it for us. If no
+	 *  hardware renderer can be had at all (a VM, or a headless machine running with
+	 *  SDL_VIDEODRIVER=dummy), we settle for SDL's software renderer rather than give up.
 	 *
 	 *  Parameters: 
 	 *              window to associate renderer with
@@ -118,24 +283,67 @@ int main(int argc, char *argv[])
 	 *
 	 */
 
-	SDL_Renderer *renderer = SDL_CreateRenderer(mainWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+	const auto frameLoopConfig = parseFrameLoopConfig(argc, argv);
+
+	const auto rendererFlags = SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE | FrameLoop::rendererFlags(frameLoopConfig);
+
+	auto requestedDriver = argumentValue(argc, argv, "--renderer=");
 
-	if (!renderer) {
-		SDL_DestroyWindow(mainWindow);
-		
+	if (requestedDriver.empty() && SDL_GetHint(SDL_HINT_RENDER_DRIVER)) {
+		requestedDriver = SDL_GetHint(SDL_HINT_RENDER_DRIVER);
+	}
+
+	const auto driverIndex = chooseRenderDriver(renderDrivers(), requestedDriver);
+
+	RendererPtr rendererHandle(SDL_CreateRenderer(mainWindow.get(), driverIndex, rendererFlags));
+
+	if (!rendererHandle && (driverIndex != -1)) {
+		LogSDLError(std::cerr, "CreateRenderer");
+
+		// The chosen driver exists but couldn't start (no device, say); let SDL find one that can
+		rendererHandle.reset(SDL_CreateRenderer(mainWindow.get(), -1, rendererFlags));
+	}
+
+	if (!rendererHandle) {
+		LogSDLError(std::cerr, "CreateRenderer");
+
+		// Vsync isn't asked for: the software renderer has no say over when the window is updated
+		rendererHandle.reset(SDL_CreateRenderer(mainWindow.get(), -1, SDL_RENDERER_SOFTWARE | SDL_RENDERER_TARGETTEXTURE));
+	}
+
+	if (!rendererHandle) {
 		LogSDLError(std::cerr, "CreateRenderer");
 
-		SDL_Quit();
 		return EXIT_FAILURE;
 	}
 
+	SDL_Renderer *renderer = rendererHandle.get();
+
+	/** Struct: RendererCaps
+	 *
+	 *  Description:
+	 *  What the renderer we ended up with can do caps how big atlas pages may get, and decides
+	 *  whether the texture pack's pixels can be uploaded as they are.
+	 *
+	 */
+
+	RendererCaps capabilities;
+	const auto probed = probeRenderer(renderer, capabilities);
+
+	if (probed) {
+		std::cout << "Renderer: ";
+		printRendererCaps(std::cout, capabilities);
+	}
+
+	const auto atlasPageSize = capabilities.fitTextureSize(ATLAS_PAGE_SIZE);
+
 	/** Function: SDL_CreateTextureFromSurface
 	 *
 	 *  Description:
 	 *  With the image loaded into an SDL_Surface, we can now upload it to the renderer using
 	 *  SDL_CreateTextureFromSurface. We pass in the rendering context to upload to, as well as the
 	 *  image in memory (the SDL_Surface), and get back the loaded texture. We're done with the original
-	 *  surface at this point so we'll free it now.
+	 *  surface at this point, so its SurfacePtr frees it.
 	 *
 	 *  Parameters:
 	 *    1. Renderer
@@ -145,60 +353,718 @@ int main(int argc, char *argv[])
 	 *
 	 */
 
-	SDL_Texture *background = loadTexture("C:\\Users\\jflop\\source\\repos\\sdl-test\\sdl-test\\img\\background.bmp", renderer);
-	SDL_Texture *foreground = loadTexture("C:\\Users\\jflop\\source\\repos\\sdl-test\\sdl-test\\img\\foreground.bmp", renderer);
+	/** Class: TextureCache
+	 *
+	 *  Description:
+	 *  Textures are loaded through a cache keyed by path, so requesting the same image again hands
+	 *  back the texture that was already uploaded instead of decoding the file a second time. The
+	 *  handles it returns keep the texture alive; once nothing references a texture anymore the
+	 *  cache is free to evict it when it goes over its memory budget.
+	 *
+	 */
 
-	if ((!background) || (!foreground)) {
-		SDL_DestroyRenderer(renderer);
-		SDL_DestroyWindow(mainWindow);
+	TextureCache textureCache(renderer, TEXTURE_BUDGET_BYTES);
 
-		LogSDLError(std::cerr, "LoadTexture");
+	/** Class: StreamingTexturePool
+	 *
+	 *  Description:
+	 *  Textures whose pixels are written after they've been created come from a pool that hands out
+	 *  idle streaming textures of the same size before it creates any: the loader copies decoded
+	 *  images into them, and the loading pattern and the tile rasterizer below stream into them
+	 *  every frame.
+	 *
+	 */
+
+	StreamingTexturePool streamingPool(renderer, STREAMING_POOL_IDLE_BYTES);
+
+	/** Class: AsyncLoader
+	 *
+	 *  Description:
+	 *  Reading and decoding the images happens on a pool of worker threads, so we don't have to wait
+	 *  for them before showing the first frame. Each frame the loader gets a small slice of time to
+	 *  upload whatever has finished decoding, and anything not ready yet is simply skipped when
+	 *  drawing. The texture only becomes usable once its request reports ready.
+	 *
+	 */
+
+	AsyncLoader assetLoader(textureCache, AsyncLoader::defaultWorkerCount(), &streamingPool);
 
-		SDL_Quit();
+	/** Function: findAssetRoot
+	 *
+	 *  Description:
+	 *  Images are loaded from an asset root rather than from fixed paths: --assets=<dir> or the
+	 *  SDLTEST_ASSETS environment variable choose it, and otherwise we look for img/ next to the
+	 *  executable, next to the project, and in the working directory. A --assets directory without
+	 *  the scene's images in it is an error rather than a reason to look elsewhere.
+	 *
+	 */
+
+	const auto assetRoot = findAssetRoot(argumentValue(argc, argv, "--assets="), "background.bmp");
+
+	if (assetRoot.empty()) {
 		return EXIT_FAILURE;
 	}
 
-	for (auto i = 0; i < 3; i++) {
-		SDL_RenderClear(renderer);
+	// Prefer the pre-converted pack when one has been built; anything not in it is decoded from BMP
+	auto texturePack = TexturePack::open(assetPath(assetRoot, "textures.tpak"));
 
-		int bW = 0;
-		int bH = 0;
+	// A pack in a format the renderer doesn't have natively would be converted on every upload; decoding the BMPs is no slower
+	if (texturePack && probed && !capabilities.supportsFormat(texturePack->pixelFormat())) {
+		std::cerr << "Texture pack is " << SDL_GetPixelFormatName(texturePack->pixelFormat()) << ", which the renderer does not support natively; not using it\n";
+		texturePack.reset();
+	}
 
-		SDL_QueryTexture(background, NULL, NULL, &bW, &bW);
+	if (texturePack) {
+		assetLoader.mount(*texturePack);
+	}
 
-		RenderTexture(background, renderer, 0, 0);
-		RenderTexture(background, renderer, bW, 0);
-		RenderTexture(background, renderer, 0, bH);
-		RenderTexture(background, renderer, bW, bH);
+	/** Class: TextureAtlas
+	 *
+	 *  Description:
+	 *  The background and foreground are packed into a single atlas texture instead of being two
+	 *  separate textures, so the whole scene is drawn from one texture and the batch never has to
+	 *  switch between them. Sprites are drawn from the atlas by region, looked up by file name.
+	 *
+	 */
+
+	const std::vector<std::string> scenePaths {
+		assetPath(assetRoot, "background.bmp"),
+		assetPath(assetRoot, "foreground.bmp")
+	};
 
-		int iW = 0;
-		int iH = 0;
+	AsyncAtlasHandle sceneRequest = assetLoader.requestAtlas(scenePaths, atlasPageSize);
 
-		SDL_QueryTexture(foreground, NULL, NULL, &iW, &iH);
+	/** Class: FileWatcher
+	 *
+	 *  Description:
+	 *  The scene's images are watched while the program runs. When one is saved, it's decoded again
+	 *  and written over its region of the atlas, so the change shows up a moment later without a
+	 *  restart; nothing that refers to the atlas has to be rebuilt. An image that changed size can't
+	 *  be fitted back into its region, so that still needs a restart. --no-watch turns this off.
+	 *
+	 */
 
-		int x = SCREEN_WIDTH / 2 - iW / 2;
-		int y = SCREEN_HEIGHT / 2 - iH / 2;
+	std::unique_ptr<FileWatcher> assetWatcher;
+	std::vector<std::string> changedAssets;
 
-		RenderTexture(foreground, renderer, x, y);
+	if (!hasArgument(argc, argv, "--no-watch")) {
+		assetWatcher.reset(new FileWatcher());
 
-		SDL_RenderPresent(renderer);
-		SDL_Delay(1000);
+		for (const auto& path : scenePaths) {
+			assetWatcher->watch(path);
+		}
 	}
 
-	/** Before we exit, we've got to destroy all the objects we created through the various SDL_DestroyX
-	 *  functions, and quit SDL. Error Handling Note: previously in the program we may have encountered
-	 *  an error and exited early, in which case we'd have to destroy any SDL objects we had created and
-	 *  quit SDL to properly clean up before exiting. This part of the error handling is omitted from the
-	 *  lessons since they're such small examples and it helps keep the code a bit shorter, but in a real
-	 *  world program, proper error handling and clean up is absolutely required.
+	/** Class: SpriteBatch
+	 *
+	 *  Description:
+	 *  Rather than copying each sprite to the renderer as soon as it's drawn, draws are collected
+	 *  into a batch for the frame. Flushing the batch sorts the sprites by texture and submits each
+	 *  texture's sprites together; since everything here comes from the one atlas page, the whole
+	 *  scene goes out as a single draw call. The foreground is drawn on a higher layer so it always
+	 *  ends up on top of the background.
 	 *
 	 */
 
-	SDL_DestroyTexture(background);
-	SDL_DestroyTexture(foreground);
-	SDL_DestroyRenderer(renderer);
-	SDL_DestroyWindow(mainWindow);
+	SpriteBatch spriteBatch(renderer);
 
-	SDL_Quit();
-	return EXIT_SUCCESS;
+	// The background layer is redrawn on the render thread, so it gets a batch of its own
+	SpriteBatch layerBatch(renderer);
+
+	/** Class: RetainedLayer
+	 *
+	 *  Description:
+	 *  The background tiles never change, so rather than redrawing them every frame they're drawn
+	 *  once into a screen-sized texture, and each frame just copies that texture to the screen. The
+	 *  tiles are only redrawn when part of the layer is marked dirty, or when the renderer loses the
+	 *  contents of its render targets. If render targets aren't available at all, the tiles are drawn
+	 *  every frame like before.
+	 *
+	 */
+
+	RetainedLayer backgroundLayer(renderer, SCREEN_WIDTH, SCREEN_HEIGHT, true);
+
+	// Upload count the layer was last drawn with; a reloaded image means drawing it again
+	auto layerUploads = std::size_t { 0 };
+
+	/** Class: Tilemap
+	 *
+	 *  Description:
+	 *  The background image is tiled across the screen by a tilemap, which only hands the batch the
+	 *  tiles inside the camera (and inside the region being redrawn). Its tiles are the size of the
+	 *  background image, so the map can only be built once the atlas has loaded.
+	 *
+	 */
+
+	std::unique_ptr<Tilemap> backgroundMap;
+	const SDL_Rect camera { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+
+	auto buildBackgroundMap = [&]() {
+		const auto& background = *sceneRequest->atlas().find("background.bmp");
+
+		const auto bW = background.rect.w;
+		const auto bH = background.rect.h;
+
+		backgroundMap.reset(new Tilemap((SCREEN_WIDTH + bW - 1) / bW, (SCREEN_HEIGHT + bH - 1) / bH, bW, bH));
+		backgroundMap->setTileset({ background });
+		backgroundMap->fill(SDL_Rect { 0, 0, backgroundMap->columns(), backgroundMap->rows() }, 1);
+	};
+
+	auto drawBackground = [&](const SDL_Rect& region) {
+		layerBatch.begin();
+		backgroundMap->draw(layerBatch, camera, region);
+		layerBatch.flush();
+	};
+
+	/** Class: FrameLoop
+	 *
+	 *  Description:
+	 *  The main loop runs until the window is closed (or Escape is pressed). Simulation advances in
+	 *  fixed steps no matter how fast we're rendering, and each rendered frame blends the last two
+	 *  simulation states by how far we are into the next step, so motion stays smooth at any frame
+	 *  rate. Between frames the loop waits for the next deadline according to the pacing mode.
+	 *
+	 */
+
+	FrameLoop frameLoop(frameLoopConfig);
+
+	/** Class: Input
+	 *
+	 *  Description:
+	 *  Events are drained once at the top of each frame into a snapshot of the keyboard and mouse,
+	 *  so everything in the frame sees the same input. How long the oldest input of a frame takes to
+	 *  be presented is measured on the render thread and shown on the HUD.
+	 *
+	 */
+
+	Input input;
+	InputLatency inputLatency;
+
+	/** Class: ProfilerOverlay
+	 *
+	 *  Description:
+	 *  With --profile-overlay, a graph of recent frame times is drawn over the scene. The samples come
+	 *  from the PROFILE_SCOPE markers throughout the program, which only exist in builds with
+	 *  SDLTEST_PROFILING defined. --profile-dump=<prefix> writes the recorded history to <prefix>.csv
+	 *  and <prefix>.json (a Chrome trace) on exit.
+	 *
+	 */
+
+	const auto showProfiler = hasArgument(argc, argv, "--profile-overlay");
+	const auto profileDump = argumentValue(argc, argv, "--profile-dump=");
+
+	const auto targetFrameMs = 1000.0 / ((frameLoopConfig.mode == PacingMode::TargetFps) ? frameLoopConfig.targetFps : 60.0);
+	ProfilerOverlay profilerOverlay(SCREEN_WIDTH, SCREEN_HEIGHT, targetFrameMs);
+
+	/** Class: RenderTargetChain
+	 *
+	 *  Description:
+	 *  The scene isn't drawn straight to the window. It goes into an offscreen pass that can run at
+	 *  a lower resolution, which is then upscaled to the window, and the overlays are drawn on top
+	 *  at full resolution. The scene's scale follows the measured frame time: it drops when frames
+	 *  run over budget and creeps back up while they fit. --render-scale=<0.25..1> fixes it instead.
+	 *
+	 */
+
+	/** Class: TextRenderer
+	 *
+	 *  Description:
+	 *  With --hud, a few numbers about the last frame are printed in the corner, at full resolution
+	 *  on top of the scene. The text comes from the built-in bitmap font, so the whole HUD is one
+	 *  texture and goes out as a single batched draw; the labels never change, so they're laid out
+	 *  once and reused, while the values are laid out fresh every frame.
+	 *
+	 */
+
+	const auto showHud = hasArgument(argc, argv, "--hud");
+
+	std::unique_ptr<BitmapFont> hudFont;
+	std::unique_ptr<TextRenderer> hudText;
+	SpriteBatch hudBatch(renderer);
+
+	if (showHud) {
+		hudFont = BitmapFont::create(renderer, {
+			SDL_Color { 255, 255, 255, 255 },
+			SDL_Color { 0, 0, 0, 160 },
+			SDL_Color { 255, 200, 64, 255 }
+		});
+
+		if (hudFont) {
+			hudText.reset(new TextRenderer(*hudFont));
+		}
+	}
+
+	const std::string hudLabels[] = { "frame ms", "scene scale", "sprites", "draw calls", "switches", "vertices", "upload KB", "cache misses", "allocations", "input ms" };
+	auto lastAllocations = Profiler::allocationCount();
+
+	auto drawHudLine = [&](int line, const char *value, std::size_t color) {
+		const auto x = HUD_MARGIN;
+		const auto y = HUD_MARGIN + line * FONT_LINE_HEIGHT * HUD_SCALE;
+		const auto valueX = x + HUD_VALUE_COLUMN * FONT_ADVANCE * HUD_SCALE;
+
+		hudText->draw(hudBatch, hudLabels[line], x + HUD_SCALE, y + HUD_SCALE, HUD_SHADOW, HUD_SCALE, 0);
+		hudText->draw(hudBatch, hudLabels[line], x, y, HUD_TEXT, HUD_SCALE, 1);
+
+		hudText->drawUncached(hudBatch, value, valueX + HUD_SCALE, y + HUD_SCALE, HUD_SHADOW, HUD_SCALE, 0);
+		hudText->drawUncached(hudBatch, value, valueX, y, color, HUD_SCALE, 1);
+	};
+
+	RenderTargetChain renderChain(renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
+	const auto scenePass = renderChain.addPass();
+
+	DynamicResolutionConfig resolutionConfig;
+	resolutionConfig.targetMilliseconds = targetFrameMs;
+
+	DynamicResolution dynamicResolution(resolutionConfig);
+	const auto fixedSceneScale = static_cast<float>(std::atof(argumentValue(argc, argv, "--render-scale=").c_str()));
+
+	/** Class: SpriteStore
+	 *
+	 *  Description:
+	 *  Sprite state lives in a SpriteStore, which moves every sprite by its velocity each simulation
+	 *  step and bounces it off the edges of its area, all in bulk. When drawing, it interpolates each
+	 *  sprite between its last two positions and submits them to the batch already in sorted order.
+	 *  The foreground is its only sprite for now, drifting side to side so there's something to
+	 *  interpolate.
+	 *
+	 */
+
+	SpriteStore sprites;
+	SDL_Rect driftArea {};
+
+	// Sprite updates are spread across the spare cores; the renderer stays on this thread
+	JobSystem jobs;
+	auto foregroundSprite = INVALID_SPRITE;
+
+	/** Class: AnimationPlayer
+	 *
+	 *  Description:
+	 *  Animations are sampled once per simulation step, so clip tables are built at the simulation
+	 *  rate. With --foreground-frames=<n>, foreground.bmp is treated as a strip of n frames side by
+	 *  side, and the foreground sprite loops through them.
+	 *
+	 */
+
+	AnimationLibrary animations(1.0 / frameLoop.timestep());
+	AnimationPlayer animationPlayer(animations);
+	const auto foregroundFrames = std::max(std::atoi(argumentValue(argc, argv, "--foreground-frames=").c_str()), 1);
+
+	/** Class: SpatialGrid
+	 *
+	 *  Description:
+	 *  Sprites are kept in a spatial grid as they move, so each frame only the ones overlapping the
+	 *  camera are drawn, and a mouse click only has to test the sprites under the cursor. Clicking
+	 *  the foreground stops it drifting, and clicking it again starts it moving again.
+	 *
+	 */
+
+	SpatialGrid sceneGrid(SCENE_CELL_SIZE);
+	std::vector<SpatialId> visibleSprites;
+	std::vector<SpatialId> pickedSprites;
+
+	auto buildForeground = [&]() {
+		const auto& sheet = *sceneRequest->atlas().find("foreground.bmp");
+		const auto frames = AnimationLibrary::sliceSheet(sheet, std::max(sheet.rect.w / foregroundFrames, 1), sheet.rect.h, foregroundFrames);
+		const auto& foreground = frames.empty() ? sheet : frames.front();
+
+		const auto x = SCREEN_WIDTH / 2 - foreground.rect.w / 2;
+		const auto y = SCREEN_HEIGHT / 2 - foreground.rect.h / 2;
+
+		driftArea = SDL_Rect { x - DRIFT_RANGE, y, foreground.rect.w + 2 * DRIFT_RANGE, foreground.rect.h };
+
+		foregroundSprite = sprites.create(foreground, static_cast<float>(x), static_cast<float>(y), 1);
+		sprites.setVelocity(foregroundSprite, DRIFT_SPEED, 0.0f);
+
+		if (frames.size() > 1) {
+			animationPlayer.play(foregroundSprite, animations.addClip("foreground", frames, FOREGROUND_FPS));
+			animationPlayer.prepare(sprites);
+		}
+	};
+
+	/** Class: StreamingTexture
+	 *
+	 *  Description:
+	 *  Until the scene has loaded, a moving stripe pattern is drawn in the middle of the screen. Its
+	 *  pixels change every frame, so rather than uploading a new texture each time it's a streaming
+	 *  texture from the pool, and each frame's pixels are copied straight into it. The pixels are
+	 *  generated into the command buffer's arena, so they last exactly until the render thread has
+	 *  copied them. The texture goes back to the pool once the scene is showing.
+	 *
+	 */
+
+	// Only ever touched by the render thread
+	StreamingTexture loadingTexture;
+	auto loadingFailed = false;
+
+	auto loadingFrame = 0;
+
+	/** Class: TileRasterizer
+	 *
+	 *  Description:
+	 *  Without a hardware renderer every sprite would be a single-threaded blit, so in that case (or
+	 *  with --cpu-raster) the render thread hands the sprites to a tile rasterizer instead, which
+	 *  blends them on every core and puts each batch on the target with a single copy. Anything the
+	 *  loader uploads may replace a texture the rasterizer has a copy of, so its copies are dropped
+	 *  whenever that happens.
+	 *
+	 */
+
+	std::unique_ptr<TileRasterizer> tileRasterizer;
+	auto rasterizerUploads = assetLoader.uploadCount();
+
+	if (!capabilities.accelerated() || hasArgument(argc, argv, "--cpu-raster")) {
+		tileRasterizer.reset(new TileRasterizer(streamingPool, &jobs, SCREEN_WIDTH, SCREEN_HEIGHT));
+	}
+
+	/** Class: FrameCapture
+	 *
+	 *  Description:
+	 *  --capture=<file> writes every command buffer to a capture file as the render thread executes
+	 *  it, so a frame that ran slow can be replayed and timed later with sdl-bench --replay=<file>,
+	 *  here or on another machine, against any renderer.
+	 *
+	 */
+
+	const auto capturePath = argumentValue(argc, argv, "--capture=");
+	std::unique_ptr<FrameCapture> frameCapture;
+
+	if (!capturePath.empty()) {
+		frameCapture = FrameCapture::create(capturePath, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+		if (!frameCapture) {
+			return EXIT_FAILURE;
+		}
+	}
+
+	/** Class: RenderStats
+	 *
+	 *  Description:
+	 *  Every frame's draw calls, texture switches, vertices, uploads and texture cache lookups are
+	 *  counted as the render thread makes them and shown on the HUD. --frame-budget=<list> (say
+	 *  draws=200,switches=40,vertices=20000,upload=1048576) sets what a frame may cost: the HUD shows
+	 *  anything over it as a warning, and how many frames went over is printed on exit.
+	 *  --metrics=<host:port> also sends every frame's counts to a StatsD collector, which can alert
+	 *  on them.
+	 *
+	 */
+
+	auto& renderStats = RenderStats::instance();
+	const auto budgetArgument = argumentValue(argc, argv, "--frame-budget=");
+
+	if (!budgetArgument.empty()) {
+		FrameBudget budget;
+
+		if (!parseFrameBudget(budgetArgument, budget)) {
+			std::cerr << "FrameBudget error: could not read " << budgetArgument << '\n';
+			return EXIT_FAILURE;
+		}
+
+		renderStats.setBudget(budget);
+	}
+
+	const auto frameBudget = renderStats.budget();
+	const auto metricsAddress = argumentValue(argc, argv, "--metrics=");
+	std::unique_ptr<MetricsSocket> metricsSocket;
+
+	if (!metricsAddress.empty()) {
+		metricsSocket = MetricsSocket::open(metricsAddress, "sdl_test");
+
+		if (!metricsSocket) {
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Everything loaded so far would otherwise count against the first frame
+	renderStats.endFrame();
+	renderStats.reset();
+
+	/** Class: RenderThread
+	 *
+	 *  Description:
+	 *  The loop below never calls the renderer itself. Each frame it records what to draw into a
+	 *  command buffer and hands that to a render thread, which owns the renderer from here on, and
+	 *  gets going on the next frame while the render thread draws and presents this one. Work that
+	 *  needs the renderer for more than a plain draw (texture uploads, redrawing the background
+	 *  layer, the profiler overlay) is recorded as callbacks that run on the render thread in order.
+	 *  --single-thread executes each buffer on this thread instead, right when it's submitted.
+	 *
+	 *  It's declared last so it's destroyed first: the callbacks refer to most of what's above, so
+	 *  the thread has to have finished with them before any of it goes away.
+	 *
+	 */
+
+	RenderThread renderThread(renderer, !hasArgument(argc, argv, "--single-thread"));
+	renderThread.setCapture(frameCapture.get());
+	renderThread.setRasterizer(tileRasterizer.get());
+
+	auto exitCode = EXIT_SUCCESS;
+
+	while (frameLoop.running()) {
+		PROFILE_FRAME_BEGIN();
+
+		const auto& frameInput = input.poll();
+		frameLoop.beginFrame(frameInput);
+
+		auto& commands = renderThread.record();
+
+		if (assetWatcher) {
+			changedAssets.clear();
+			assetWatcher->takeChanges(changedAssets);
+
+			for (const auto& path : changedAssets) {
+				commands.call([&, path](SDL_Renderer*) { assetLoader.reload(path); });
+			}
+		}
+
+		commands.call([&](SDL_Renderer*) { assetLoader.pumpUploads(UPLOAD_BUDGET_MS); });
+
+		if (tileRasterizer) {
+			commands.call([&](SDL_Renderer*) {
+				if (assetLoader.uploadCount() != rasterizerUploads) {
+					tileRasterizer->forgetTextures();
+					rasterizerUploads = assetLoader.uploadCount();
+				}
+			});
+		}
+
+		if (sceneRequest->isFailed()) {
+			std::cerr << "LoadTexture error: " << sceneRequest->error() << '\n';
+
+			exitCode = EXIT_FAILURE;
+			break;
+		}
+
+		if (frameInput.buttonPressed(SDL_BUTTON_LEFT)) {
+			pickedSprites.clear();
+			sceneGrid.queryPoint(camera.x + frameInput.pressX, camera.y + frameInput.pressY, pickedSprites);
+
+			if (std::find(pickedSprites.begin(), pickedSprites.end(), foregroundSprite) != pickedSprites.end()) {
+				const auto stopped = sprites.velocityX(foregroundSprite) == 0.0f;
+				sprites.setVelocity(foregroundSprite, stopped ? DRIFT_SPEED : 0.0f, 0.0f);
+			}
+		}
+
+		while (frameLoop.step()) {
+			PROFILE_SCOPE("simulate");
+
+			const auto dt = static_cast<float>(frameLoop.timestep());
+
+			jobs.parallelFor(sprites.size(), SPRITE_JOB_GRAIN, [&](std::size_t first, std::size_t last) {
+				sprites.beginStep(first, last);
+				sprites.integrate(dt, first, last);
+				sprites.bounce(driftArea, first, last);
+			});
+
+			// A separate pass, since animation changes sprite sizes that bouncing reads
+			jobs.parallelFor(animationPlayer.size(), ANIMATION_JOB_GRAIN, [&](std::size_t first, std::size_t last) {
+				animationPlayer.step(sprites, first, last);
+			});
+		}
+
+		if (sceneRequest->isReady() && !backgroundMap) {
+			buildBackgroundMap();
+			buildForeground();
+		}
+
+		if (sceneRequest->isReady() && backgroundLayer.valid()) {
+			const auto targetsLost = frameLoop.renderTargetsLost();
+
+			commands.call([&, targetsLost](SDL_Renderer*) {
+				if (targetsLost || (assetLoader.uploadCount() != layerUploads)) {
+					backgroundLayer.invalidate();
+					layerUploads = assetLoader.uploadCount();
+				}
+
+				backgroundLayer.update(drawBackground);
+			});
+		}
+
+		dynamicResolution.addFrame(frameLoop.frameMilliseconds());
+		const auto sceneScale = (fixedSceneScale > 0.0f) ? fixedSceneScale : dynamicResolution.scale();
+
+		commands.call([&, sceneScale](SDL_Renderer*) {
+			renderChain.setScale(scenePass, sceneScale);
+			renderChain.begin(scenePass);
+		});
+
+		commands.clear();
+
+		if (!sceneRequest->isReady()) {
+			const auto pitch = LOADING_SIZE * static_cast<int>(sizeof(Uint32));
+			auto *pixels = static_cast<Uint32*>(commands.arena().allocate(pitch * LOADING_SIZE, alignof(Uint32)));
+
+			drawLoadingPattern(pixels, LOADING_SIZE, loadingFrame++);
+
+			commands.call([&, pixels, pitch](SDL_Renderer *target) {
+				if (!loadingTexture && !loadingFailed) {
+					loadingTexture = streamingPool.acquire(LOADING_SIZE, LOADING_SIZE);
+
+					if (!loadingTexture) {
+						LogSDLError(std::cerr, "CreateTexture");
+						loadingFailed = true;
+					}
+				}
+
+				if (loadingTexture && loadingTexture.update(pixels, pitch)) {
+					const SDL_Rect destination { (SCREEN_WIDTH - LOADING_SIZE) / 2, (SCREEN_HEIGHT - LOADING_SIZE) / 2, LOADING_SIZE, LOADING_SIZE };
+					SDL_RenderCopy(target, loadingTexture.get(), nullptr, &destination);
+				}
+			});
+		} else if (loadingFrame > 0) {
+			commands.call([&](SDL_Renderer*) { loadingTexture.release(); });
+			loadingFrame = 0;
+		}
+
+		if (sceneRequest->isReady()) {
+			commands.call([&](SDL_Renderer*) {
+				if (backgroundLayer.valid()) {
+					backgroundLayer.composite();
+				} else {
+					drawBackground(SDL_Rect { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT });
+				}
+			});
+		}
+
+		spriteBatch.begin();
+
+		sprites.syncGrid(sceneGrid);
+
+		// Sprites are drawn part way back towards where they were, so look a little past the edges
+		const SDL_Rect cullArea { camera.x - SCENE_CELL_SIZE, camera.y - SCENE_CELL_SIZE, camera.w + 2 * SCENE_CELL_SIZE, camera.h + 2 * SCENE_CELL_SIZE };
+
+		visibleSprites.clear();
+		sceneGrid.query(cullArea, visibleSprites);
+
+		sprites.submit(spriteBatch, camera, static_cast<float>(frameLoop.alpha()), visibleSprites);
+
+		spriteBatch.flush(commands);
+
+		// Everything from here on is drawn at the window's own resolution
+		commands.call([&](SDL_Renderer*) { renderChain.finish(); });
+
+		const auto allocations = Profiler::allocationCount();
+
+		if (hudText) {
+			char value[32];
+
+			hudBatch.begin();
+
+			std::snprintf(value, sizeof(value), "%.2f", frameLoop.frameMilliseconds());
+			drawHudLine(0, value, (frameLoop.frameMilliseconds() > targetFrameMs * 1.05) ? HUD_WARNING : HUD_TEXT);
+
+			std::snprintf(value, sizeof(value), "%.3f", sceneScale);
+			drawHudLine(1, value, (sceneScale < 1.0f) ? HUD_WARNING : HUD_TEXT);
+
+			std::snprintf(value, sizeof(value), "%u", static_cast<unsigned>(sprites.size()));
+			drawHudLine(2, value, HUD_TEXT);
+
+			// The last frame the render thread finished, which is a frame or two behind this one
+			const auto frameStats = renderStats.latest();
+
+			std::snprintf(value, sizeof(value), "%u", static_cast<unsigned>(frameStats.drawCalls));
+			drawHudLine(3, value, overBudget(frameStats.drawCalls, frameBudget.drawCalls) ? HUD_WARNING : HUD_TEXT);
+
+			std::snprintf(value, sizeof(value), "%u", static_cast<unsigned>(frameStats.textureSwitches));
+			drawHudLine(4, value, overBudget(frameStats.textureSwitches, frameBudget.textureSwitches) ? HUD_WARNING : HUD_TEXT);
+
+			std::snprintf(value, sizeof(value), "%u", static_cast<unsigned>(frameStats.vertices));
+			drawHudLine(5, value, overBudget(frameStats.vertices, frameBudget.vertices) ? HUD_WARNING : HUD_TEXT);
+
+			std::snprintf(value, sizeof(value), "%.1f", frameStats.uploadBytes / 1024.0);
+			drawHudLine(6, value, overBudget(frameStats.uploadBytes, frameBudget.uploadBytes) ? HUD_WARNING : HUD_TEXT);
+
+			std::snprintf(value, sizeof(value), "%u", static_cast<unsigned>(frameStats.cacheMisses));
+			drawHudLine(7, value, HUD_TEXT);
+
+			if (Profiler::countingAllocations()) {
+				std::snprintf(value, sizeof(value), "%llu", static_cast<unsigned long long>(allocations - lastAllocations));
+				drawHudLine(8, value, (allocations != lastAllocations) ? HUD_WARNING : HUD_TEXT);
+			} else {
+				drawHudLine(8, "not counted", HUD_TEXT);
+			}
+
+			std::snprintf(value, sizeof(value), "%.2f", inputLatency.averageMilliseconds());
+			drawHudLine(9, value, (inputLatency.averageMilliseconds() > targetFrameMs * 2.0) ? HUD_WARNING : HUD_TEXT);
+
+			hudBatch.flush(commands);
+			hudText->endFrame();
+		}
+
+		lastAllocations = allocations;
+
+		if (showProfiler) {
+			profilerOverlay.record(commands);
+		}
+
+		commands.present();
+
+		commands.call([&](SDL_Renderer*) {
+			renderStats.endFrame();
+
+			if (metricsSocket) {
+				const auto frameStats = renderStats.latest();
+				metricsSocket->send(frameStats, overBudget(frameStats, frameBudget));
+			}
+		});
+
+		if (frameInput.oldestInput != 0) {
+			const auto inputTime = frameInput.oldestInput;
+			commands.call([&, inputTime](SDL_Renderer*) { inputLatency.presented(inputTime); });
+		}
+
+		renderThread.submit();
+
+		frameLoop.endFrame();
+
+		PROFILE_FRAME_END();
+	}
+
+	// Everything below reads state the render thread may still be updating
+	renderThread.finish();
+
+	const auto worstFrame = renderStats.worst();
+	std::cout << "Render stats: at most " << worstFrame.drawCalls << " draw calls, " << worstFrame.textureSwitches << " texture switches, "
+		<< worstFrame.vertices << " vertices and " << worstFrame.uploadBytes << " bytes uploaded in a frame";
+
+	if (overBudget(worstFrame, frameBudget)) {
+		std::cout << "; " << renderStats.framesOverBudget() << " frames over budget";
+	}
+
+	std::cout << '\n';
+
+	if (metricsSocket) {
+		std::cout << "Metrics: " << metricsSocket->sentCount() << " frames sent, " << metricsSocket->droppedCount() << " dropped\n";
+	}
+
+	if (tileRasterizer) {
+		const auto& rasterStats = tileRasterizer->stats();
+		std::cout << "Tile rasterizer: " << rasterStats.sprites << " sprites, " << rasterStats.tiles << " tiles in "
+			<< rasterStats.flushes << " flushes, " << rasterStats.declined << " draws left to the renderer\n";
+	}
+
+	if (frameCapture) {
+		std::cout << "Frame capture: " << frameCapture->frameCount() << " frames written to " << capturePath << '\n';
+	}
+
+	if (!profileDump.empty()) {
+		const auto& profiler = Profiler::instance();
+
+		if (!profiler.writeCsv(profileDump + ".csv") || !profiler.writeChromeTrace(profileDump + ".json")) {
+			std::cerr << "Profiler error: could not write " << profileDump << ".csv/.json\n";
+		}
+	}
+
+	/** Before we exit, everything we created has to be destroyed and SDL has to be shut down. Every
+	 *  SDL object here is owned by an RAII handle, and they're declared in the order they depend on
+	 *  each other (SDL itself, then the window, the renderer, and finally everything holding
+	 *  textures), so returning from main tears them down in exactly the reverse order. The same goes
+	 *  for the early returns above: whatever had been created by then is cleaned up on the way out.
+	 *
+	 */
+
+	const auto& cacheStats = textureCache.stats();
+	std::cout << "Texture cache: " << cacheStats.hits << " hits, " << cacheStats.misses << " misses, "
+		<< cacheStats.evictions << " evictions, " << cacheStats.residentBytes << " bytes resident\n";
+
+	return exitCode;
 }
\ No newline at end of file